@@ -0,0 +1,119 @@
+// Red-light violation end to end, without models: built instead of the ANSLIB library, whose
+// detectors are replaced below by scripted ones. A car drives up through the stop line while the
+// signal is red and must give exactly one violation, on the frame it crosses.
+#include <ANSCustomTrafficLight.h>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    std::mutex g_scriptMutex;
+    std::map<const ANSCENTER::ANSLIB *, std::string> g_modelNames; // By detector handle
+    cv::Rect g_carBox;                                             // Where the vehicle model sees the car
+}
+
+namespace ANSCENTER
+{
+    ANSLIB::ANSLIB() {}
+    ANSLIB::~ANSLIB()
+    {
+        std::lock_guard<std::mutex> lock(g_scriptMutex);
+        g_modelNames.erase(this);
+    }
+    int ANSLIB::LoadModelFromFolder(const char *, const char *modelName, const char *, float, float, float, int, int, int, const char *, std::string &labelMap)
+    {
+        std::lock_guard<std::mutex> lock(g_scriptMutex);
+        g_modelNames[this] = modelName;
+        labelMap = "";
+        return 1;
+    }
+    int ANSLIB::RunInference(cv::Mat cvImage, const char *, std::vector<Object> &detectionResult)
+    {
+        std::lock_guard<std::mutex> lock(g_scriptMutex);
+        detectionResult.clear();
+        Object stObject;
+        stObject.trackId = 1;
+        stObject.confidence = 0.9f;
+        if (g_modelNames[this] == "vehicle")
+        {
+            stObject.className = "car";
+            stObject.box = g_carBox;
+            detectionResult.push_back(stObject);
+        }
+        else if (g_modelNames[this] == "light")
+        {
+            stObject.className = "red";
+            stObject.classId = 9;
+            stObject.box = cv::Rect(0, 0, (std::min)(cvImage.cols, 10), (std::min)(cvImage.rows, 10));
+            detectionResult.push_back(stObject);
+        }
+        return 1;
+    }
+    int ANSLIB::DetectMovement(cv::Mat, const char *, std::vector<Object> &) { return 1; }
+    int ANSLIB::Optimize(bool) { return 1; }
+    int ANSLIB::OptimizeModel(const char *, const char *, int, int) { return 1; }
+    int ANSLIB::GetEngineType() { return 1; }
+}
+
+int main()
+{
+    ANSCustomTL customTL;
+    std::string labelMap;
+    if (!customTL.Initialize(".", 0.5f, labelMap))
+    {
+        std::cerr << "FAIL: initialize" << std::endl;
+        return -1;
+    }
+
+    // One lane driven upwards, stop line at y = 240, one signal head
+    CustomParams stVehicleParam;
+    stVehicleParam.handleId = 0;
+    stVehicleParam.handleName = "VehicleDetector";
+    stVehicleParam.handleParametersJson = {
+        {4, "stages", "lights,detect,roi,lightState,track,violation,check"}};
+    stVehicleParam.ROIs = {
+        {0, "DetectArea", {{0, 0}, {639, 0}, {639, 479}, {0, 479}}},
+        {1, "CrossingLine", {{0, 240}, {639, 240}}},
+        {2, "Direction", {{320, 400}, {320, 100}}}};
+    CustomParams stTrafficLightParam;
+    stTrafficLightParam.handleId = 1;
+    stTrafficLightParam.handleName = "TrafficLight";
+    stTrafficLightParam.ROIs = {
+        {1, "TrafficRoi", {{500, 10}, {600, 10}, {600, 60}, {500, 60}}}};
+
+    std::vector<int> vViolations;
+    customTL.RegisterStage("check", [&vViolations](ANSCustomTL::FrameContext &frame)
+                           {
+        for (size_t index : frame.violations)
+        {
+            vViolations.push_back(frame.vehicles[index].trackId);
+        } }, {"violation"});
+    customTL.SetParamaters({stVehicleParam, stTrafficLightParam});
+
+    // Centre before the line, on it, past it, and further on
+    const int centres[] = {320, 260, 230, 150};
+    const size_t expected[] = {0, 0, 1, 1};
+    cv::Mat image(480, 640, CV_8UC3, cv::Scalar(0, 0, 0));
+    for (size_t i = 0; i < sizeof(centres) / sizeof(centres[0]); ++i)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_scriptMutex);
+            g_carBox = cv::Rect(300, centres[i] - 20, 40, 40);
+        }
+        customTL.RunFrame(image, cv::Mat(), "cameraId");
+        if (vViolations.size() != expected[i])
+        {
+            std::cerr << "FAIL: frame " << i << " has " << vViolations.size() << " violations, expected " << expected[i] << std::endl;
+            return -1;
+        }
+    }
+    if (vViolations[0] != 1)
+    {
+        std::cerr << "FAIL: violation of track " << vViolations[0] << std::endl;
+        return -1;
+    }
+
+    std::cout << "PASS: one violation on the frame the car crossed on red" << std::endl;
+    return 0;
+}
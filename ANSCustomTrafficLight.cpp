@@ -1,23 +1,129 @@
 #include "ANSCustomTrafficLight.h"
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <sstream>
 // #define FNS_DEBUG
 ANSCustomTL::ANSCustomTL()
 {
 	// Initialize the model
+	m_bConditionalStages = false;
+	m_dLightIntervalMs = 0.0;
+	m_dLastLightMs = 0.0;
+	m_nFrameCounter = 0;
+	m_dGovernorPriority = 1.0;
+	m_dGovernorRedPriority = 4.0;
+	m_vStageNames = {"lights", "detect", "roi", "lightState", "track", "violation", "render", "export"};
+	BuildStageGraph();
 }
 bool ANSCustomTL::OptimizeModel(bool fp16)
 {
-	bool result = false;
-	bool vResult = vehicleDetector.Optimize(fp16);
-	bool tResult = trafficLightDetector.Optimize(fp16);
+	// Both detectors skip the build when the engine cache already has it for this precision
+	bool vResult = m_cVehicleDetector.Optimize(fp16);
+	bool tResult = m_cTrafficLightDetector.Optimize(fp16);
 	return vResult && tResult;
 }
 std::vector<CustomObject> ANSCustomTL::RunInference(const cv::Mat &input)
 {
 	return RunInference(input, "CustomCam");
 }
+std::vector<CustomObject> ANSCustomTL::RunInferenceNV12(const cv::Mat &yPlane, const cv::Mat &uvPlane, const std::string &camera_id,
+														cv::Mat *output)
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	try
+	{
+		if (output)
+		{
+			// The caller wants the picture with the overlays, so all of it is converted
+			CACNV12Frame::ConvertFull(yPlane, uvPlane, *output);
+			return RunFrame(*output, *output, camera_id);
+		}
+
+		// Convert only what the detectors read: the vehicle detector's input (the DetectArea bounds
+		// with crop margin when cropping or tiling, else the whole frame) and the TrafficRoi
+		cv::Size frameSize(yPlane.cols, yPlane.rows);
+		std::vector<cv::Rect> vRegions;
+		vRegions.push_back(m_cVehicleDetector.GetDetectorInputRect(frameSize));
+		CustomParams stTrafficParam = m_cTrafficLightDetector.GetParameters();
+		for (const auto &roi : stTrafficParam.ROIs)
+		{
+			std::string sBaseName;
+			int nLightId = 0;
+			CACLaneIndex::ParseRegionName(roi.regionName, sBaseName, nLightId);
+			if (sBaseName == "TrafficRoi" && !roi.polygon.empty())
+			{
+				// One extra pixel around the warp source for interpolation
+				cv::Rect trafficRect = cv::boundingRect(roi.polygon);
+				vRegions.push_back(cv::Rect(trafficRect.x - 1, trafficRect.y - 1, trafficRect.width + 2, trafficRect.height + 2));
+			}
+		}
+
+		// Nothing is drawn: the buffer is internal and only partly converted
+		const cv::Mat &bgr = m_cNV12Frame.Convert(yPlane, uvPlane, vRegions);
+		return RunFrame(bgr, cv::Mat(), camera_id);
+	}
+	catch (std::exception &e)
+	{
+		return std::vector<CustomObject>();
+	}
+}
+std::vector<CustomObject> ANSCustomTL::RunInferenceNV12(const unsigned char *y, size_t yStride, const unsigned char *uv, size_t uvStride,
+														int width, int height, const std::string &camera_id, cv::Mat *output)
+{
+	// Headers over the decoder's memory, nothing is copied
+	cv::Mat yPlane;
+	cv::Mat uvPlane;
+	CACNV12Frame::WrapPlanes(y, yStride, uv, uvStride, width, height, yPlane, uvPlane);
+	return RunInferenceNV12(yPlane, uvPlane, camera_id, output);
+}
+std::vector<CustomObject> ANSCustomTL::RunInferenceShared(CACSharedFrameRing &ring, const std::string &camera_id, int timeoutMs,
+														  cv::Mat *output)
+{
+	int nCamera = ring.FindCamera(camera_id);
+	if (nCamera < 0)
+	{
+		return std::vector<CustomObject>();
+	}
+
+	// The wait for a new frame does not hold the lock, other cameras keep running meanwhile
+	uint32_t nLastSequence = 0;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		nLastSequence = m_mSharedSequences[camera_id];
+	}
+
+	// The slot stays held, so the decoder writes elsewhere, until the results are built
+	CACSharedFrameRing::Frame stFrame;
+	if (!ring.Acquire(nCamera, nLastSequence, timeoutMs, stFrame))
+	{
+		return std::vector<CustomObject>();
+	}
+	std::vector<CustomObject> results;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		m_mSharedSequences[camera_id] = stFrame.sequence;
+		m_mSharedDropped[camera_id] += stFrame.dropped;
+		// The slot belongs to the ring and goes back to the decoder on Release: overlays only go to the caller's copy
+		if (output)
+		{
+			stFrame.image.copyTo(*output);
+			results = RunFrame(stFrame.image, *output, camera_id);
+		}
+		else
+		{
+			results = RunFrame(stFrame.image, cv::Mat(), camera_id);
+		}
+	}
+	ring.Release(nCamera);
+	return results;
+}
 bool ANSCustomTL::Destroy()
 {
 	// Both detectors are released here
+	m_cPlateReader.Stop();
+	m_pGovernorClient.reset();
+	m_pResultStream.reset();
 	return true;
 }
 bool ANSCustomTL::Initialize(const std::string &modelDirectory, float detectionScoreThreshold, std::string &labelMap)
@@ -27,9 +133,65 @@ bool ANSCustomTL::Initialize(const std::string &modelDirectory, float detectionS
 	stVehicleParam.handleId = 0; // Vehicle detector
 	stVehicleParam.handleName = "VehicleDetector";
 	stVehicleParam.handleParametersJson = {
-		{0, "modelType", "1"},			// int
-		{1, "threshold", "0.7"},		// double
-		{4, "objects", "car,truck,bus"} // list
+		{0, "modelType", "1"},					// int
+		{0, "detectorPoolSize", "1"},			// int (detector handles for this model, applied at Initialize)
+		{0, "sharedModel", "1"},				// int (1: share loaded weights with other cameras using the same model)
+		{4, "precision", "fp32"},				// string (fp32 or fp16, part of the shared model key)
+		{0, "optimizeOnLoad", "0"},				// int (1: optimise for precision at startup, cached on disk)
+		{0, "warmup", "0"},						// int (1: run one inference on a synthetic frame at startup)
+		{0, "warmupSize", "640"},				// int (warm-up frame side)
+		{1, "threshold", "0.7"},				// double
+		{4, "objects", "car,truck,bus"},		// list
+		{0, "cropToDetectArea", "0"},			// int (0: full frame, 1: DetectArea crop)
+		{0, "cropMargin", "32"},				// int (pixels around the DetectArea crop)
+		{0, "pyramidInput", "0"},				// int (1: detect on the shared pyramid level nearest the model input size)
+		{0, "resolutionTuning", "0"},			// int (1: pick the detector input side per camera from the vehicle sizes)
+		{4, "resolutionLadder", "320,480,640,960,1280"},	// list (input long sides to choose from, the lower ones need the engine vehicle_<side>)
+		{0, "minObjectPx", "16"},				// int (smallest vehicle side the detector must still see)
+		{1, "tuningPercentile", "0.05"},		// double (fraction of vehicles allowed below minObjectPx)
+		{0, "tuningWindow", "500"},				// int (vehicle boxes in the statistics)
+		{0, "tuningIntervalSec", "30"},			// int (time between decisions)
+		{1, "tuningMaxCountDrop", "0.2"},		// double (drop in vehicles per frame that reverts a step down)
+		{0, "tuningHoldDecisions", "5"},		// int (decisions without step down after a revert)
+		{0, "laneGridCell", "64"},				// int (cell side of the grid that assigns vehicles to lanes)
+		{0, "analyticsWindowSec", "60"},		// int (sliding window of the per-lane counts, flow and occupancy)
+		{0, "queueSpeedPx", "3"},				// int (vehicles moving less per frame count as queued on red)
+		{0, "alpr", "0"},						// int (1: read the plates of violating vehicles)
+		{4, "alprModelName", "alpr"},			// string
+		{4, "alprClassName", "alpr.names"},		// string
+		{0, "alprMaxQueue", "8"},				// int (pending plate crops, further requests are dropped)
+		{0, "alprMaxReadsPerTrack", "3"},		// int
+		{1, "alprMinConfidence", "0.8"},		// double (no more reads for a track once a plate reaches this)
+		{0, "alprCropMargin", "16"},			// int (pixels around the vehicle box)
+		{0, "tiling", "0"},						// int (1: split DetectArea into overlapping tiles)
+		{0, "tileSize", "640"},					// int (tile side, normally the model input size)
+		{1, "tileOverlap", "0.2"},				// double (fraction shared by neighbouring tiles)
+		{0, "maxTiles", "6"},					// int (tile budget per frame)
+		{1, "tileMergeIoU", "0.5"},				// double
+		{0, "tileFusion", "0"},					// int (0: NMS, 1: weighted box fusion)
+		{0, "motionGate", "0"},					// int (0: off, 1: frame difference, 2: ANSLIB DetectMovement)
+		{0, "motionDownscaleWidth", "160"},		// int
+		{0, "motionPixelThreshold", "25"},		// int
+		{1, "motionMinRatio", "0.002"},			// double (changed fraction of DetectArea counted as motion)
+		{0, "motionMaxSkip", "25"},				// int (force a detection after this many static frames)
+		{0, "flowPropagation", "0"},			// int (1: detect on keyframes, move boxes with optical flow in between)
+		{0, "flowMaxInterval", "4"},			// int (largest keyframe interval k)
+		{0, "flowPointsPerBox", "10"},			// int
+		{1, "flowMinQuality", "0.5"},			// double (tracked point fraction needed to skip the detector)
+		{0, "vehicleStrideUnknown", "1"},		// int (run the vehicle model every N frames per light state)
+		{0, "vehicleStrideGreen", "1"},			// int (raise to skip frames on green)
+		{0, "vehicleStrideYellow", "1"},		// int
+		{0, "vehicleStrideRed", "1"},			// int
+		{4, "stages", "lights,detect,roi,lightState,track,violation,render,export"},	// list (stages run per frame, drop render on headless nodes)
+		{0, "conditionalStages", "0"},			// int (1: skip the light model with no vehicle in a lane, and crossing checks without red)
+		{1, "governorBudgetMs", "0"},			// double (inference ms per second for all cameras of the node, 0: no limit)
+		{1, "governorIntervalMs", "1000"},		// double (time between quality level rebalances)
+		{1, "governorPriority", "1"},			// double (weight of this camera's coverage)
+		{1, "governorRedPriority", "4"},		// double (weight multiplier while a signal is red)
+		{4, "resultStream", ""},				// string (shared-memory ring name for binary results, empty: off)
+		{0, "resultStreamRecords", "65536"},	// int (ring capacity in 64-byte records)
+		{0, "frameHash", "0"},					// int (1: return cached results for byte-identical repeated frames)
+		{1, "streamFrozenMs", "5000"}			// double (byte-identical repeats this long raise stream_frozen)
 	};
 
 	/* ROI reactangle
@@ -37,6 +199,7 @@ bool ANSCustomTL::Initialize(const std::string &modelDirectory, float detectionS
 		|              |
 	(250, 35280) ---- (900, 280)     // pt3 ---- pt2
 	*/
+	// Further lanes use suffixed names: DetectArea_1, CrossingLine_1, Direction_1 (lane 1), ...
 	stVehicleParam.ROIs = {
 		{0, "DetectArea", {{250, 50}, {900, 50}, {900, 280}, {250, 280}}},
 		{1, "CrossingLine", {{900, 280}, {250, 280}}},
@@ -45,12 +208,30 @@ bool ANSCustomTL::Initialize(const std::string &modelDirectory, float detectionS
 	stTrafficLightParam.handleName = "TrafficLight";
 	stTrafficLightParam.handleId = 1;
 	stTrafficLightParam.handleParametersJson = {
-		{1, "thesHold", "0.5"}};
+		{1, "thesHold", "0.5"},					// double
+		{0, "detectorPoolSize", "1"},			// int (detector handles for this model, applied at Initialize)
+		{0, "sharedModel", "1"},				// int (1: share loaded weights with other cameras using the same model)
+		{4, "precision", "fp32"},				// string (fp32 or fp16, part of the shared model key)
+		{0, "optimizeOnLoad", "0"},				// int (1: optimise for precision at startup, cached on disk)
+		{0, "warmup", "0"},						// int (1: run one inference on a synthetic frame at startup)
+		{0, "warmupSize", "640"},				// int (warm-up frame side)
+		{0, "mosaicBatching", "0"},				// int (1: one light inference per tick for all cameras sharing the model)
+		{0, "mosaicWidth", "640"},				// int (atlas width, normally the model input size)
+		{0, "mosaicMaxHeight", "640"},			// int (a new atlas is started past this height)
+		{0, "mosaicPadding", "8"},				// int (grey gutter between crops)
+		{1, "mosaicMaxWaitMs", "5"},			// double (longest wait for the other cameras of the tick)
+		{0, "phasePrediction", "0"},			// int (1: learn the signal plan and skip light inference mid-phase)
+		{1, "lightDenseWindowMs", "1500"},		// double (detect every frame this close to a predicted transition)
+		{1, "lightSparseIntervalMs", "1000"},	// double (detection interval mid-phase)
+		{1, "phaseMinConfidence", "0.6"},		// double (below this the light is detected every frame)
+		{0, "phaseDebounceFrames", "2"}			// int (observations needed to accept a new state)
+	};
 	/* ROI reactangle
 	 (300, 50) ---- (900, 50)     // pt0 ---- pt1
 		 |              |
 	 (300, 100) ---- (900, 100)     // pt3 ---- pt2
 	 */
+	// TrafficRoi_N is the signal head of lane N; lanes without one follow TrafficRoi
 	stTrafficLightParam.ROIs = {
 		{1, "TrafficRoi", {{300, 50}, {900, 50}, {900, 100}, {300, 100}}}};
 	std::vector<CustomParams> parameters = {stVehicleParam, stTrafficLightParam};
@@ -60,8 +241,25 @@ bool ANSCustomTL::Initialize(const std::string &modelDirectory, float detectionS
 	_detectionScoreThreshold = detectionScoreThreshold;
 
 	// 2. User can start impelementing the initialization logic here
-	bool vehicleResult = m_cVehicleDetector.Initialize(_modelDirectory, _detectionScoreThreshold);
+	// The two models are independent, load them at the same time
+	auto startupStart = std::chrono::steady_clock::now();
+	std::future<bool> vehicleLoad = std::async(std::launch::async, [this]()
+											   { return m_cVehicleDetector.Initialize(_modelDirectory, _detectionScoreThreshold); });
 	bool lightResult = m_cTrafficLightDetector.Initialize(_modelDirectory, _detectionScoreThreshold);
+	bool vehicleResult = vehicleLoad.get();
+	// The plate reader loads in the background, violations queue their crops until it is ready
+	m_cPlateReader.Start(_modelDirectory, _detectionScoreThreshold);
+	// Quality level given by the process-wide budget governor
+	m_pGovernorClient = CACBudgetGovernor::Instance().Register();
+	double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+
+	StartupTimings vehicleTimings = m_cVehicleDetector.GetStartupTimings();
+	StartupTimings lightTimings = m_cTrafficLightDetector.GetStartupTimings();
+	std::cout << "Startup " << startupMs << " ms"
+			  << " | vehicle load " << vehicleTimings.loadMs << " ms, optimise " << vehicleTimings.optimiseMs << " ms"
+			  << (vehicleTimings.optimiseCached ? " (cached)" : "") << ", warm-up " << vehicleTimings.warmupMs << " ms"
+			  << " | light load " << lightTimings.loadMs << " ms, optimise " << lightTimings.optimiseMs << " ms"
+			  << (lightTimings.optimiseCached ? " (cached)" : "") << ", warm-up " << lightTimings.warmupMs << " ms" << std::endl;
 
 	// 3 Create label map
 	// Based on two class names, please form the label map (e.g. vehicle.names and light.names)
@@ -143,7 +341,8 @@ bool ANSCustomTL::ConfigureParamaters(std::vector<CustomParams> &param)
 	return true;
 }
 
-cv::Mat cropFromFourPoints(const cv::Mat &src, const std::vector<cv::Point> &pts)
+// Warps into cropped, whose buffer is reused while the crop size stays the same
+cv::Mat &cropFromFourPoints(const cv::Mat &src, const std::vector<cv::Point> &pts, cv::Mat &cropped)
 {
 	if (pts.size() != 4)
 		throw std::runtime_error("Need 4 points");
@@ -163,315 +362,746 @@ cv::Mat cropFromFourPoints(const cv::Mat &src, const std::vector<cv::Point> &pts
 		{0.0f, height - 1}};
 
 	cv::Mat M = cv::getPerspectiveTransform(ordered, dst);
-	cv::Mat cropped;
 	cv::warpPerspective(src, cropped, M, cv::Size(width, height));
 	return cropped;
 }
 
+int ANSCustomTL::FrameContext::LaneLightId(int laneId) const
+{
+	return (laneId > 0 && trafficAreas.count(laneId)) ? laneId : defaultLightId;
+}
+
+void ANSCustomTL::BuildStageGraph()
+{
+	// Every stage reads and writes m_stFrame; the "stages" parameter picks the ones that run.
+	// The light and vehicle detectors only depend on the frame, so the cheaper of the two runs first.
+	// When vehicles come first and no lane holds one, the light state cannot produce a violation;
+	// when lights come first and no signal is red, the crossing checks cannot find one.
+	CACStageGraph::StageDef stLights;
+	stLights.run = [this]()
+	{ RunLightStage(); };
+	stLights.needed = [this]()
+	{
+		// The budget governor may space the light checks out
+		if (m_dLightIntervalMs > 0.0 && m_stFrame.nowMs - m_dLastLightMs < m_dLightIntervalMs)
+		{
+			return false;
+		}
+		return !m_bConditionalStages || !m_stFrame.lanesAssigned || !m_stFrame.vehicles.empty();
+	};
+	stLights.fallback = [this]()
+	{ ReuseLights(); };
+	m_cStageGraph.Register("lights", stLights);
+
+	// Frames the scheduler skips keep the last detections
+	CACStageGraph::StageDef stDetect;
+	stDetect.run = [this]()
+	{ RunVehicleStage(); };
+	stDetect.needed = [this]()
+	{ return m_cScheduler.ShouldRunVehicles(GetJunctionState()); };
+	m_cStageGraph.Register("detect", stDetect);
+
+	CACStageGraph::StageDef stRoi;
+	stRoi.run = [this]()
+	{ FilterVehicles(); };
+	stRoi.after = {"detect"};
+	m_cStageGraph.Register("roi", stRoi);
+
+	CACStageGraph::StageDef stLightState;
+	stLightState.run = [this]()
+	{ AnalyseLights(); };
+	stLightState.after = {"lights"};
+	m_cStageGraph.Register("lightState", stLightState);
+
+	CACStageGraph::StageDef stTrack;
+	stTrack.run = [this]()
+	{ TrackCrossings(); };
+	stTrack.needed = [this]()
+	{ return !m_bConditionalStages || (m_stFrame.isRedLight && !m_stFrame.vehicles.empty()); };
+	stTrack.after = {"roi", "lightState"};
+	m_cStageGraph.Register("track", stTrack);
+
+	CACStageGraph::StageDef stViolation;
+	stViolation.run = [this]()
+	{ CheckViolations(); };
+	stViolation.needed = stTrack.needed;
+	stViolation.after = {"track"};
+	m_cStageGraph.Register("violation", stViolation);
+
+	CACStageGraph::StageDef stRender;
+	stRender.run = [this]()
+	{ RenderFrame(); };
+	stRender.needed = [this]()
+	{ return !m_stFrame.output.empty(); };
+	stRender.after = {"roi", "lightState", "violation"};
+	m_cStageGraph.Register("render", stRender);
+
+	CACStageGraph::StageDef stExport;
+	stExport.run = [this]()
+	{ ExportResults(); };
+	stExport.after = {"roi", "lights", "violation"};
+	m_cStageGraph.Register("export", stExport);
+
+	m_cStageGraph.Configure(m_vStageNames);
+}
+
+void ANSCustomTL::RegisterStage(const std::string &name, const std::function<void(FrameContext &)> &run, const std::vector<std::string> &after)
+{
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	CACStageGraph::StageDef stStage;
+	stStage.run = [this, run]()
+	{ run(m_stFrame); };
+	stStage.after = after;
+	m_cStageGraph.Register(name, stStage);
+	m_cStageGraph.Configure(m_vStageNames);
+}
+
 std::vector<CustomObject> ANSCustomTL::RunInference(const cv::Mat &input, const std::string &camera_id)
 {
+	// Drawn in place on the caller's frame
+	return RunFrame(input, input, camera_id);
+}
 
+std::vector<CustomObject> ANSCustomTL::RunFrame(const cv::Mat &input, const cv::Mat &output, const std::string &camera_id)
+{
 	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	std::vector<CustomObject> results;
 	try
 	{
-		std::vector<ANSCENTER::Object> outputVehicle;
-		std::vector<ANSCENTER::Object> outputTrafficLight;
-		CustomParams stVehicleParam = m_cVehicleDetector.GetParameters();
-		std::vector<cv::Point> vDetectArea{};
-		std::vector<cv::Point> vCrossLine{};
-		std::vector<cv::Point> vDirection{};
+		// Every consumer of this frame shares the same downscaled and grayscale levels
+		m_cFramePyramid.SetFrame(input);
 
-		// Extract ROIs from parameters
-		for (const auto &roi : stVehicleParam.ROIs)
+		m_stFrame = FrameContext();
+		m_stFrame.input = input;
+		m_stFrame.output = output;
+		m_stFrame.cameraId = camera_id;
+		m_stFrame.lanes = m_cVehicleDetector.GetLanes();
+
+		// TrafficRoi is signal head 0, TrafficRoi_N the head controlling lane N
+		CustomParams stTrafficParam = m_cTrafficLightDetector.GetParameters();
+		for (const auto &roi : stTrafficParam.ROIs)
 		{
-			if (roi.regionName == "DetectArea")
-			{
-				vDetectArea = roi.polygon;
-			}
-			else if (roi.regionName == "CrossingLine")
+			std::string sBaseName;
+			int nLightId = 0;
+			CACLaneIndex::ParseRegionName(roi.regionName, sBaseName, nLightId);
+			if (sBaseName == "TrafficRoi")
 			{
-				vCrossLine = roi.polygon;
+				m_stFrame.trafficAreas[nLightId] = roi.polygon;
 			}
-			else if (roi.regionName == "Direction")
+		}
+		if (m_stFrame.trafficAreas.empty())
+		{
+			m_stFrame.trafficAreas[0];
+		}
+		m_stFrame.defaultLightId = m_stFrame.trafficAreas.begin()->first;
+
+		// Stalled encoders repeat the last frame; a frame whose analysed regions are byte-identical to
+		// the one the cached results came from gets them back
+		m_stFrame.nowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		std::vector<cv::Rect> vHashRegions;
+		for (const auto &lane : m_stFrame.lanes)
+		{
+			vHashRegions.push_back(cv::boundingRect(lane.detectArea));
+		}
+		for (const auto &area : m_stFrame.trafficAreas)
+		{
+			if (!area.second.empty())
 			{
-				vDirection = roi.polygon;
+				vHashRegions.push_back(cv::boundingRect(area.second));
 			}
 		}
+		if (m_cFrameHash.IsRepeat(camera_id, input, vHashRegions, m_stFrame.nowMs, &m_cFramePyramid))
+		{
+			m_stFrame.input = cv::Mat();
+			m_stFrame.output = cv::Mat();
+			m_cFramePyramid.Release();
+			return m_cFrameHash.GetResults(camera_id, input.size());
+		}
 
-		// Create ROI mask for vehicle detection
-		cv::Mat roiMask = cv::Mat::zeros(input.size(), CV_8UC1);
-		if (!vDetectArea.empty())
+		// The budget governor's level for this camera: frames outside its stride get the last results
+		const CACBudgetGovernor::QualityLevel &stQuality = CACBudgetGovernor::Instance().GetQualityLevel(
+			m_pGovernorClient ? m_pGovernorClient->GetLevel() : 0);
+		m_dLightIntervalMs = stQuality.lightIntervalMs;
+		m_cVehicleDetector.SetMaxInputSide(stQuality.maxInputSide);
+		if (m_nFrameCounter++ % stQuality.frameStride != 0)
 		{
-			std::vector<std::vector<cv::Point>> contours = {vDetectArea};
-			cv::fillPoly(roiMask, contours, cv::Scalar(255));
+			m_stFrame.input = cv::Mat();
+			m_stFrame.output = cv::Mat();
+			m_cFramePyramid.Release();
+			ReportToGovernor(false);
+			return m_vLastResults;
 		}
 
-		// Run vehicle detection only within ROI
-		std::vector<ANSCENTER::Object> vOutVehicle = m_cVehicleDetector.DetectVehicles(input, "cameraID");
+		m_cStageGraph.Run();
+		PublishResults();
 
-		// Filter vehicles to only those within the detection area
-		std::vector<ANSCENTER::Object> filteredVehicles;
-		for (const auto &vehicle : vOutVehicle)
+		results.swap(m_stFrame.results);
+		m_stFrame.input = cv::Mat(); // Do not hold the caller's frame until the next one
+		m_stFrame.output = cv::Mat();
+		m_cFramePyramid.Release();
+		m_cFrameHash.SetResults(camera_id, results);
+		m_vLastResults = results;
+		ReportToGovernor(true);
+		return results;
+	}
+
+	catch (std::exception &e)
+	{
+		results.swap(m_stFrame.results);
+		m_stFrame.input = cv::Mat();
+		m_stFrame.output = cv::Mat();
+		m_cFramePyramid.Release();
+		return results;
+	}
+}
+
+void ANSCustomTL::ReportToGovernor(bool processed)
+{
+	if (!m_pGovernorClient)
+	{
+		return;
+	}
+
+	// Live per-run cost of the stages; red-phase cameras ask for more of the budget
+	CACBudgetGovernor::Sample stSample;
+	stSample.cameraId = m_stFrame.cameraId;
+	stSample.nowMs = m_stFrame.nowMs;
+	stSample.processed = processed;
+	for (const auto &stage : m_cStageGraph.GetStats())
+	{
+		if (stage.name == "detect")
 		{
-			cv::Point center(vehicle.box.x + vehicle.box.width / 2,
-							 vehicle.box.y + vehicle.box.height / 2);
-			if (cv::pointPolygonTest(vDetectArea, center, false) >= 0)
-			{
-				filteredVehicles.push_back(vehicle);
-			}
+			stSample.detectMs = stage.meanMs;
+		}
+		else if (stage.name == "lights")
+		{
+			stSample.lightsMs = stage.meanMs;
 		}
+		else
+		{
+			stSample.otherMs += stage.meanMs;
+		}
+	}
+	stSample.priority = m_dGovernorPriority * (GetJunctionState() == LIGHT_RED ? m_dGovernorRedPriority : 1.0);
+	if (processed)
+	{
+		m_cVehicleDetector.GetInputSides(stSample.tunedSide, stSample.inputSides);
+	}
+	CACBudgetGovernor::Instance().Report(*m_pGovernorClient, stSample);
+}
 
-		// Run traffic light detection
-		CustomParams stTrafficParam = m_cTrafficLightDetector.GetParameters();
-		std::vector<cv::Point> vTrafficArea{};
+TrafficLightState ANSCustomTL::GetJunctionState() const
+{
+	// The most restrictive signal of the junction; the last known states until the lights stage ran
+	const std::map<int, TrafficLightState> &mStates = m_stFrame.lightsDone ? m_stFrame.lightStates : m_mLastLightStates;
+	TrafficLightState eLightState = LIGHT_UNKNOWN;
+	bool bFirst = true;
+	for (const auto &state : mStates)
+	{
+		if (bFirst || state.second == LIGHT_RED || (state.second == LIGHT_YELLOW && eLightState != LIGHT_RED))
+		{
+			eLightState = state.second;
+			bFirst = false;
+		}
+	}
+	return eLightState;
+}
 
-		for (const auto &roi : stTrafficParam.ROIs)
+void ANSCustomTL::RunLightStage()
+{
+	// Light inference runs densely near predicted phase transitions and sparsely mid-phase.
+	// Skipped frames carry the predicted state on the last detected light boxes.
+	FrameContext &frame = m_stFrame;
+	m_dLastLightMs = frame.nowMs;
+	// The mosaic leader of this tick waits for this camera until the stage ends
+	struct LightTick
+	{
+		CACTrafficLight &detector;
+		explicit LightTick(CACTrafficLight &trafficLight) : detector(trafficLight) { detector.BeginLightTick(); }
+		~LightTick() { detector.EndLightTick(); }
+	} tick(m_cTrafficLightDetector);
+	for (const auto &area : frame.trafficAreas)
+	{
+		if (area.first == 0)
 		{
-			if (roi.regionName == "TrafficRoi")
-			{
-				vTrafficArea = roi.polygon;
-			}
+			frame.lightStates[0] = DetectLight(frame.input, area.second, frame.cameraId, frame.nowMs, m_cPhaseEstimator, m_vLastTrafficLights,
+											   m_cTrafficCrop, frame.lights[0]);
+			continue;
+		}
+		auto head = m_mLightHeads.find(area.first);
+		if (head == m_mLightHeads.end())
+		{
+			head = m_mLightHeads.emplace(area.first, LightHead()).first;
+			head->second.phaseEstimator.SetParameters(m_stLightParams);
 		}
+		// Every head has its own tracks in ANSLIB's tracker
+		frame.lightStates[area.first] = DetectLight(frame.input, area.second, frame.cameraId + "#" + std::to_string(area.first), frame.nowMs,
+													head->second.phaseEstimator, head->second.lastLights, head->second.crop, frame.lights[area.first]);
+	}
+	m_mLastLightStates = frame.lightStates;
+	frame.lightsDone = true;
+}
 
-		// Create ROI mask for traffic light detection
-		cv::Mat trafficRoiMask = cv::Mat::zeros(input.size(), CV_8UC1);
-		if (!vTrafficArea.empty())
+void ANSCustomTL::ReuseLights()
+{
+	// No vehicle is in a lane: the last lights and states stand for this frame
+	FrameContext &frame = m_stFrame;
+	for (const auto &area : frame.trafficAreas)
+	{
+		auto head = m_mLightHeads.find(area.first);
+		if (area.first == 0)
 		{
-			std::vector<std::vector<cv::Point>> contours = {vTrafficArea};
-			cv::fillPoly(trafficRoiMask, contours, cv::Scalar(255));
+			frame.lights[0] = m_vLastTrafficLights;
 		}
+		else if (head != m_mLightHeads.end())
+		{
+			frame.lights[area.first] = head->second.lastLights;
+		}
+		auto state = m_mLastLightStates.find(area.first);
+		frame.lightStates[area.first] = state != m_mLastLightStates.end() ? state->second : LIGHT_UNKNOWN;
+	}
+	frame.lightsDone = true;
+}
+
+void ANSCustomTL::RunVehicleStage()
+{
+	// Queue lengths are measured on the lanes whose signal is red
+	FrameContext &frame = m_stFrame;
+	const std::map<int, TrafficLightState> &mStates = frame.lightsDone ? frame.lightStates : m_mLastLightStates;
+	for (const auto &lane : frame.lanes)
+	{
+		auto state = mStates.find(frame.LaneLightId(lane.laneId));
+		m_cVehicleDetector.SetLaneRed(lane.laneId, state != mStates.end() && state->second == LIGHT_RED);
+	}
 
-		cv::Mat cvTrafficImg = cropFromFourPoints(input, vTrafficArea);
-		std::vector<ANSCENTER::Object> vOutTrafficLight = m_cTrafficLightDetector.DetectTrafficLights(cvTrafficImg, "cameraID");
+	// Run vehicle detection only within ROI, at the rate configured for the current light state.
+	// The detections stay in m_vLastVehicles, which skipped frames reuse.
+	m_vLastVehicles = m_cVehicleDetector.DetectVehicles(frame.input, frame.cameraId, &m_cFramePyramid);
+	frame.trackingFrame = m_cVehicleDetector.GetTrackingFrame();
+}
 
-		// Combine the results
-		std::map<std::string, int> vehicleTypeTrackIds; // Map to store track IDs for each vehicle type
-		for (const auto &obj : filteredVehicles)
+void ANSCustomTL::FilterVehicles()
+{
+	// Filter vehicles to only those within a lane, each centre assigned through the lane grid
+	FrameContext &frame = m_stFrame;
+	std::vector<int> vVehicleLanes;
+	m_cVehicleDetector.AssignLanes(m_vLastVehicles, vVehicleLanes);
+	for (size_t i = 0; i < m_vLastVehicles.size(); ++i)
+	{
+		if (vVehicleLanes[i] >= 0)
 		{
-			CustomObject customObj;
-			customObj.classId = obj.classId;
-			// Get or initialize track ID for this vehicle type
-			if (vehicleTypeTrackIds.find(obj.className) == vehicleTypeTrackIds.end()) {
-				vehicleTypeTrackIds[obj.className] = 0;
+			frame.vehicles.push_back(m_vLastVehicles[i]);
+			frame.vehicleLanes.push_back(vVehicleLanes[i]);
+			// Violators keep being read until the plate is confident or the read budget is spent;
+			// requested here, before the render stage draws on the frame
+			bool bRequested = m_cPlateReader.NeedsRead(m_vLastVehicles[i].trackId);
+			if (bRequested)
+			{
+				m_cPlateReader.Request(frame.input, m_vLastVehicles[i].box, m_vLastVehicles[i].trackId, frame.cameraId);
 			}
-			customObj.trackId = vehicleTypeTrackIds[obj.className]++;
-			customObj.className = obj.className;
-			customObj.confidence = obj.confidence;
-			customObj.box = obj.box;
-			customObj.cameraId = camera_id;
-			results.push_back(customObj);
+			frame.plateRequested.push_back(bRequested);
 		}
+	}
+	frame.lanesAssigned = true;
+}
+
+void ANSCustomTL::AnalyseLights()
+{
+	// Check which signal heads are red
+	FrameContext &frame = m_stFrame;
+	size_t nLightCount = 0;
+	for (const auto &lights : frame.lights)
+	{
+		nLightCount += lights.second.size();
+	}
+	std::cout << "\n============= Traffic Light Analysis =============" << std::endl;
+	std::cout << "Camera ID: " << frame.cameraId << std::endl;
+	std::cout << "Number of traffic lights detected: " << nLightCount << std::endl;
 
-		// Traffic light detection
-		std::map<std::string, int> trafficLightTypeTrackIds; // Map to store track IDs for each traffic light type
-		for (const auto &obj : vOutTrafficLight)
+	for (const auto &lights : frame.lights)
+	{
+		for (const auto &obj : lights.second)
 		{
-			CustomObject customObj;
-			customObj.classId = obj.classId;
-			// Get or initialize track ID for this traffic light type
-			if (trafficLightTypeTrackIds.find(obj.className) == trafficLightTypeTrackIds.end()) {
-				trafficLightTypeTrackIds[obj.className] = 0;
+			std::cout << "Traffic Light " << lights.first << " - Class: " << obj.className
+					  << ", ID: " << obj.classId
+					  << ", Confidence: " << obj.confidence
+					  << ", Position: (" << obj.box.x << "," << obj.box.y << ")" << std::endl;
+
+			if (obj.className == "red" && obj.confidence > 0.5)
+			{
+				frame.isRedLight = true;
+				frame.redLights[lights.first] = true;
+				std::cout << "RED LIGHT STATE CONFIRMED - Monitoring for violations" << std::endl;
+				break;
 			}
-			customObj.trackId = trafficLightTypeTrackIds[obj.className]++;
-			customObj.className = obj.className;
-			customObj.confidence = obj.confidence;
-			customObj.box = obj.box;
-			customObj.cameraId = camera_id;
-			results.push_back(customObj);
 		}
+	}
+}
+
+void ANSCustomTL::TrackCrossings()
+{
+	// The tracker marked the crossings while the detect stage updated it; a vehicle crossed on this
+	// frame when its track was marked by that update. Render and violation read the flags.
+	FrameContext &frame = m_stFrame;
+	frame.crossed.assign(frame.vehicles.size(), false);
+	for (size_t i = 0; i < frame.vehicles.size() && frame.trackingFrame >= 0; ++i)
+	{
+		frame.crossed[i] = m_cVehicleDetector.HasCrossedOnFrame(frame.vehicles[i].trackId, frame.trackingFrame);
+	}
+}
+
+void ANSCustomTL::CheckViolations()
+{
+	FrameContext &frame = m_stFrame;
+	const std::string &camera_id = frame.cameraId;
 
-		// Draw ROIs on the image for visualization
-		if (!vDetectArea.empty())
+	// If red light is detected, check for vehicles in the detection area
+	if (frame.isRedLight)
+	{
+		std::cout << "\n============= Vehicle Detection Analysis =============" << std::endl;
+		std::cout << "Total vehicles detected: " << frame.vehicles.size() << std::endl;
+
+		for (size_t i = 0; i < frame.vehicles.size(); ++i)
 		{
-			std::vector<std::vector<cv::Point>> contours = {vDetectArea};
-			cv::polylines(input, contours, true, cv::Scalar(0, 255, 0), 2);
-			cv::putText(input, "Detection Area", vDetectArea[0],
-						cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
+			const auto &vehicle = frame.vehicles[i];
+			std::cout << "\n----- Vehicle Details -----" << std::endl;
+			std::cout << "Lane: " << frame.vehicleLanes[i] << std::endl;
+			std::cout << "Type: " << vehicle.className << std::endl;
+			std::cout << "Track ID: " << vehicle.trackId << std::endl;
+			std::cout << "Confidence: " << vehicle.confidence << std::endl;
+			std::cout << "Position: (" << vehicle.box.x << "," << vehicle.box.y << ")" << std::endl;
+			std::cout << "Size: " << vehicle.box.width << "x" << vehicle.box.height << std::endl;
+
+			// frame.vehicles only holds vehicles whose centre is inside a lane
+			if (!frame.redLights[frame.LaneLightId(frame.vehicleLanes[i])])
+			{
+				std::cout << "Signal of lane " << frame.vehicleLanes[i] << " is not red" << std::endl;
+				continue;
+			}
+			std::cout << "Vehicle is inside detection area" << std::endl;
+
+			// Kiểm tra vi phạm
+			if (i < frame.crossed.size() && frame.crossed[i])
+			{
+				std::cout << "\n!!! RED LIGHT VIOLATION DETECTED !!!" << std::endl;
+				std::cout << "Location: Camera " << camera_id << std::endl;
+				std::cout << "Violation Details:" << std::endl;
+				std::cout << "- Vehicle Type: " << vehicle.className << std::endl;
+				std::cout << "- Track ID: " << vehicle.trackId << std::endl;
+				std::cout << "- Detection Confidence: " << vehicle.confidence << std::endl;
+				std::cout << "- Vehicle Position: (" << vehicle.box.x << "," << vehicle.box.y << ")" << std::endl;
+				std::cout << "- Vehicle Size: " << vehicle.box.width << "x" << vehicle.box.height << std::endl;
+				std::cout << "=========================================" << std::endl;
+
+				// Plate read in the background, attached to this vehicle's results once ready;
+				// one crop per track and frame, the filter stage may have queued it already
+				if (i >= frame.plateRequested.size() || !frame.plateRequested[i])
+				{
+					m_cPlateReader.Request(frame.input, vehicle.box, vehicle.trackId, camera_id);
+				}
+				frame.violations.push_back(i);
+			}
+			else
+			{
+				std::cout << "Vehicle is in detection area but has not crossed the line" << std::endl;
+			}
 		}
+	}
+	else
+	{
+		std::cout << "\nNo red light detected - Traffic flowing normally" << std::endl;
+		std::cout << "Total vehicles in frame: " << frame.vehicles.size() << std::endl;
+	}
+}
+
+void ANSCustomTL::RenderFrame()
+{
+	// Drawn on the output, the caller's frame itself for BGR input
+	FrameContext &frame = m_stFrame;
+	const cv::Mat &input = frame.output;
+
+	// Draw ROIs on the image for visualization
+	for (const auto &lane : frame.lanes)
+	{
+		std::string sSuffix = lane.laneId == 0 ? "" : " " + std::to_string(lane.laneId);
+		std::vector<std::vector<cv::Point>> contours = {lane.detectArea};
+		cv::polylines(input, contours, true, cv::Scalar(0, 255, 0), 2);
+		cv::putText(input, "Detection Area" + sSuffix, lane.detectArea[0],
+					cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
 
-		if (!vCrossLine.empty())
+		if (lane.crossingLine.size() >= 2)
 		{
-			cv::line(input, vCrossLine[0], vCrossLine[1], cv::Scalar(0, 0, 255), 2);
-			cv::putText(input, "Crossing Line", vCrossLine[0],
+			cv::line(input, lane.crossingLine[0], lane.crossingLine[1], cv::Scalar(0, 0, 255), 2);
+			cv::putText(input, "Crossing Line" + sSuffix, lane.crossingLine[0],
 						cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 255), 2);
 		}
+	}
+
+	for (const auto &area : frame.trafficAreas)
+	{
+		if (area.second.empty())
+		{
+			continue;
+		}
+		std::string sSuffix = area.first == 0 ? "" : " " + std::to_string(area.first);
+		std::vector<std::vector<cv::Point>> contours = {area.second};
+		cv::polylines(input, contours, true, cv::Scalar(255, 0, 0), 2);
+		cv::putText(input, "Traffic Light Area" + sSuffix, area.second[0],
+					cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0), 2);
+	}
 
-		if (!vTrafficArea.empty())
+	// Draw detected vehicles with their information
+	for (size_t i = 0; i < frame.vehicles.size(); ++i)
+	{
+		const auto &vehicle = frame.vehicles[i];
+		// Draw bounding box
+		cv::Scalar boxColor(0, 255, 0); // Green color for normal vehicles
+		if (i < frame.crossed.size() && frame.crossed[i])
 		{
-			std::vector<std::vector<cv::Point>> contours = {vTrafficArea};
-			cv::polylines(input, contours, true, cv::Scalar(255, 0, 0), 2);
-			cv::putText(input, "Traffic Light Area", vTrafficArea[0],
-						cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0), 2);
+			boxColor = cv::Scalar(0, 0, 255); // Red color for violating vehicles
 		}
+		cv::rectangle(input, vehicle.box, boxColor, 2);
 
-		// Draw detected vehicles with their information
-		for (const auto &vehicle : filteredVehicles)
+		// Prepare vehicle information text
+		std::string vehicleInfo = cv::format("%s (ID:%d) %.2f",
+											 vehicle.className.c_str(),
+											 vehicle.trackId,
+											 vehicle.confidence);
+
+		// Calculate text position
+		cv::Point textPos(vehicle.box.x, vehicle.box.y - 10);
+		if (textPos.y < 20)
+			textPos.y = vehicle.box.y + 20; // Adjust if text would go above image
+
+		// Draw background rectangle for text
+		int baseline = 0;
+		cv::Size textSize = cv::getTextSize(vehicleInfo, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseline);
+		cv::rectangle(input,
+					  cv::Point(textPos.x - 2, textPos.y - textSize.height - 2),
+					  cv::Point(textPos.x + textSize.width + 2, textPos.y + 2),
+					  cv::Scalar(0, 0, 0), cv::FILLED);
+
+		// Draw vehicle information text
+		cv::putText(input, vehicleInfo, textPos, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
+
+		// Draw vehicle center point
+		cv::Point center(vehicle.box.x + vehicle.box.width / 2,
+						 vehicle.box.y + vehicle.box.height / 2);
+		cv::circle(input, center, 3, boxColor, -1);
+	}
+
+	// Draw traffic lights, boxes moved from the warped crop back to frame coordinates
+	for (const auto &lights : frame.lights)
+	{
+		const std::vector<cv::Point> &vArea = frame.trafficAreas[lights.first];
+		for (const auto &obj : lights.second)
 		{
-			// Draw bounding box
-			cv::Scalar boxColor(0, 255, 0); // Green color for normal vehicles
-			if (m_cVehicleDetector.IsVehicleCrossedLine(vehicle))
+			cv::Rect box = obj.box;
+			if (!vArea.empty())
 			{
-				boxColor = cv::Scalar(0, 0, 255); // Red color for violating vehicles
+				box.x += vArea[0].x;
+				box.y += vArea[0].y;
 			}
-			cv::rectangle(input, vehicle.box, boxColor, 2);
-
-			// Prepare vehicle information text
-			std::string vehicleInfo = cv::format("%s (ID:%d) %.2f",
-												 vehicle.className.c_str(),
-												 vehicle.trackId,
-												 vehicle.confidence);
+			cv::rectangle(input, box, cv::Scalar(0, 255, 0), 2); // Vẽ khung màu xanh cho đèn tín hiệu
 
-			// Calculate text position
-			cv::Point textPos(vehicle.box.x, vehicle.box.y - 10);
-			if (textPos.y < 20)
-				textPos.y = vehicle.box.y + 20; // Adjust if text would go above image
+			// Chuẩn bị vẽ chữ trắng trên nền đen
+			std::string text = cv::format("%s ID:%d %.2f", obj.className.c_str(), obj.classId, obj.confidence);
+			cv::Point textPos(box.x, box.y - 5);
 
-			// Draw background rectangle for text
+			// Tính toán kích thước văn bản và vẽ nền đen
 			int baseline = 0;
-			cv::Size textSize = cv::getTextSize(vehicleInfo, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseline);
+			cv::Size textSize = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseline);
 			cv::rectangle(input,
 						  cv::Point(textPos.x - 2, textPos.y - textSize.height - 2),
 						  cv::Point(textPos.x + textSize.width + 2, textPos.y + 2),
 						  cv::Scalar(0, 0, 0), cv::FILLED);
 
-			// Draw vehicle information text
-			cv::putText(input, vehicleInfo, textPos, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
-
-			// Draw vehicle center point
-			cv::Point center(vehicle.box.x + vehicle.box.width / 2,
-							 vehicle.box.y + vehicle.box.height / 2);
-			cv::circle(input, center, 3, boxColor, -1);
+			// Vẽ chữ trắng
+			cv::putText(input, text, textPos,
+						cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
 		}
+	}
 
-		// Draw traffic lights
-		for (auto &obj : results)
-		{
-			if (obj.className == "red" || obj.className == "green" || obj.className == "yellow")
-			{
-				obj.box.x += vTrafficArea[0].x;
-				obj.box.y += vTrafficArea[0].y;
-				cv::rectangle(input, obj.box, cv::Scalar(0, 255, 0), 2); // Vẽ khung màu xanh cho đèn tín hiệu
-
-				// Chuẩn bị vẽ chữ trắng trên nền đen
-				std::string text = cv::format("%s ID:%d %.2f", obj.className, obj.classId, obj.confidence);
-				cv::Point textPos(obj.box.x, obj.box.y - 5);
-
-				// Tính toán kích thước văn bản và vẽ nền đen
-				int baseline = 0;
-				cv::Size textSize = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseline);
-				cv::rectangle(input,
-							  cv::Point(textPos.x - 2, textPos.y - textSize.height - 2),
-							  cv::Point(textPos.x + textSize.width + 2, textPos.y + 2),
-							  cv::Scalar(0, 0, 0), cv::FILLED);
-
-				// Vẽ chữ trắng
-				cv::putText(input, text, textPos,
-							cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
-			}
-		}
+	// Vẽ thông báo vi phạm
+	for (size_t index : frame.violations)
+	{
+		const auto &vehicle = frame.vehicles[index];
+		cv::Scalar violationColor(0, 0, 255); // Red color
+		cv::rectangle(input, vehicle.box, violationColor, 3);
 
-		// Check if traffic light is red
-		bool isRedLight = false;
-		std::cout << "\n============= Traffic Light Analysis =============" << std::endl;
-		std::cout << "Camera ID: " << camera_id << std::endl;
-		std::cout << "Number of traffic lights detected: " << vOutTrafficLight.size() << std::endl;
+		std::string violationText = "VIOLATION #" + std::to_string(vehicle.trackId);
+		cv::Point textPos(vehicle.box.x, vehicle.box.y - 10);
 
-		for (const auto &obj : vOutTrafficLight)
+		// Vẽ nền cho text
+		cv::Size textSize = cv::getTextSize(violationText, cv::FONT_HERSHEY_SIMPLEX, 0.8, 2, nullptr);
+		cv::rectangle(input,
+					  cv::Point(textPos.x - 5, textPos.y - textSize.height - 5),
+					  cv::Point(textPos.x + textSize.width + 5, textPos.y + 5),
+					  violationColor, cv::FILLED);
+
+		cv::putText(input, violationText, textPos,
+					cv::FONT_HERSHEY_SIMPLEX, 0.8, cv::Scalar(255, 255, 255), 2);
+	}
+}
+
+void ANSCustomTL::ExportResults()
+{
+	FrameContext &frame = m_stFrame;
+	const std::string &camera_id = frame.cameraId;
+	std::vector<CustomObject> &results = frame.results;
+
+	// Combine the results
+	std::map<std::string, int> vehicleTypeTrackIds; // Map to store track IDs for each vehicle type
+	for (size_t i = 0; i < frame.vehicles.size(); ++i)
+	{
+		const auto &obj = frame.vehicles[i];
+		CustomObject customObj;
+		customObj.classId = obj.classId;
+		// Get or initialize track ID for this vehicle type
+		if (vehicleTypeTrackIds.find(obj.className) == vehicleTypeTrackIds.end()) {
+			vehicleTypeTrackIds[obj.className] = 0;
+		}
+		customObj.trackId = vehicleTypeTrackIds[obj.className]++;
+		customObj.className = obj.className;
+		customObj.confidence = obj.confidence;
+		customObj.box = obj.box;
+		customObj.extraInfo = obj.extraInfo;
+		if (frame.lanes.size() > 1)
 		{
-			std::cout << "Traffic Light - Class: " << obj.className
-					  << ", ID: " << obj.classId
-					  << ", Confidence: " << obj.confidence
-					  << ", Position: (" << obj.box.x << "," << obj.box.y << ")" << std::endl;
+			customObj.extraInfo += (customObj.extraInfo.empty() ? "" : ";") + std::string("lane=") + std::to_string(frame.vehicleLanes[i]);
+		}
+		CACPlateReader::PlateResult stPlate;
+		if (m_cPlateReader.GetPlate(obj.trackId, stPlate))
+		{
+			customObj.extraInfo += (customObj.extraInfo.empty() ? "" : ";") + std::string("plate=") + stPlate.text;
+		}
+		customObj.cameraId = camera_id;
+		results.push_back(customObj);
+	}
 
-			if (obj.className == "red" && obj.confidence > 0.5)
+	// Traffic light detection, boxes moved from the warped crop back to frame coordinates
+	std::map<std::string, int> trafficLightTypeTrackIds; // Map to store track IDs for each traffic light type
+	for (const auto &lights : frame.lights)
+	{
+		const std::vector<cv::Point> &vArea = frame.trafficAreas[lights.first];
+		for (const auto &obj : lights.second)
+		{
+			CustomObject customObj;
+			customObj.classId = obj.classId;
+			// Get or initialize track ID for this traffic light type
+			if (trafficLightTypeTrackIds.find(obj.className) == trafficLightTypeTrackIds.end()) {
+				trafficLightTypeTrackIds[obj.className] = 0;
+			}
+			customObj.trackId = trafficLightTypeTrackIds[obj.className]++;
+			customObj.className = obj.className;
+			customObj.confidence = obj.confidence;
+			customObj.box = obj.box;
+			if (!vArea.empty())
 			{
-				isRedLight = true;
-				std::cout << "RED LIGHT STATE CONFIRMED - Monitoring for violations" << std::endl;
-				break;
+				customObj.box.x += vArea[0].x;
+				customObj.box.y += vArea[0].y;
+			}
+			customObj.extraInfo = obj.extraInfo;
+			if (frame.trafficAreas.size() > 1)
+			{
+				customObj.extraInfo += (customObj.extraInfo.empty() ? "" : ";") + std::string("light=") + std::to_string(lights.first);
 			}
+			customObj.cameraId = camera_id;
+			results.push_back(customObj);
 		}
+	}
+}
 
-		// If red light is detected, check for vehicles in the detection area
-		if (isRedLight)
-		{
-			std::cout << "\n============= Vehicle Detection Analysis =============" << std::endl;
-			std::cout << "Total vehicles detected: " << filteredVehicles.size() << std::endl;
-
-			for (const auto &vehicle : filteredVehicles)
-			{
-				std::cout << "\n----- Vehicle Details -----" << std::endl;
-				std::cout << "Type: " << vehicle.className << std::endl;
-				std::cout << "Track ID: " << vehicle.trackId << std::endl;
-				std::cout << "Confidence: " << vehicle.confidence << std::endl;
-				std::cout << "Position: (" << vehicle.box.x << "," << vehicle.box.y << ")" << std::endl;
-				std::cout << "Size: " << vehicle.box.width << "x" << vehicle.box.height << std::endl;
-
-				// Kiểm tra xem phương tiện có nằm trong vùng detect không
-				cv::Point center(vehicle.box.x + vehicle.box.width / 2,
-								 vehicle.box.y + vehicle.box.height / 2);
-				bool isInDetectArea = cv::pointPolygonTest(vDetectArea, center, false) >= 0;
-
-				if (isInDetectArea)
-				{
-					std::cout << "Vehicle is inside detection area" << std::endl;
+void ANSCustomTL::PublishResults()
+{
+	if (!m_pResultStream)
+	{
+		return;
+	}
 
-					// Kiểm tra vi phạm
-					bool isViolation = m_cVehicleDetector.IsVehicleCrossedLine(vehicle);
+	// Written straight into the shared ring, published once the writer goes out of scope
+	FrameContext &frame = m_stFrame;
+	const std::map<int, TrafficLightState> &mStates = frame.lightsDone ? frame.lightStates : m_mLastLightStates;
+	CACResultStream::FrameWriter cWriter(*m_pResultStream, frame.cameraId, frame.nowMs, frame.input.cols, frame.input.rows, GetJunctionState());
+	for (size_t i = 0; i < frame.vehicles.size(); ++i)
+	{
+		const auto &vehicle = frame.vehicles[i];
+		int nLaneId = i < frame.vehicleLanes.size() ? frame.vehicleLanes[i] : 0;
+		CACResultStream::DetectionRecord &stRecord = cWriter.AddDetection();
+		stRecord.classId = vehicle.classId;
+		stRecord.trackId = vehicle.trackId;
+		stRecord.confidence = vehicle.confidence;
+		stRecord.x = vehicle.box.x;
+		stRecord.y = vehicle.box.y;
+		stRecord.width = vehicle.box.width;
+		stRecord.height = vehicle.box.height;
+		stRecord.laneId = nLaneId;
+		stRecord.lightId = frame.LaneLightId(nLaneId);
+		stRecord.crossed = (i < frame.crossed.size() && frame.crossed[i]) ? 1 : 0;
+	}
 
-					if (isViolation)
-					{
-						std::cout << "\n!!! RED LIGHT VIOLATION DETECTED !!!" << std::endl;
-						std::cout << "Location: Camera " << camera_id << std::endl;
-						std::cout << "Violation Details:" << std::endl;
-						std::cout << "- Vehicle Type: " << vehicle.className << std::endl;
-						std::cout << "- Track ID: " << vehicle.trackId << std::endl;
-						std::cout << "- Detection Confidence: " << vehicle.confidence << std::endl;
-						std::cout << "- Vehicle Position: (" << vehicle.box.x << "," << vehicle.box.y << ")" << std::endl;
-						std::cout << "- Vehicle Size: " << vehicle.box.width << "x" << vehicle.box.height << std::endl;
-						std::cout << "=========================================" << std::endl;
-
-						// Vẽ thông báo vi phạm
-						cv::Scalar violationColor(0, 0, 255); // Red color
-						cv::rectangle(input, vehicle.box, violationColor, 3);
-
-						std::string violationText = "VIOLATION #" + std::to_string(vehicle.trackId);
-						cv::Point textPos(vehicle.box.x, vehicle.box.y - 10);
-
-						// Vẽ nền cho text
-						cv::Size textSize = cv::getTextSize(violationText, cv::FONT_HERSHEY_SIMPLEX, 0.8, 2, nullptr);
-						cv::rectangle(input,
-									  cv::Point(textPos.x - 5, textPos.y - textSize.height - 5),
-									  cv::Point(textPos.x + textSize.width + 5, textPos.y + 5),
-									  violationColor, cv::FILLED);
-
-						cv::putText(input, violationText, textPos,
-									cv::FONT_HERSHEY_SIMPLEX, 0.8, cv::Scalar(255, 255, 255), 2);
-					}
-					else
-					{
-						std::cout << "Vehicle is in detection area but has not crossed the line" << std::endl;
-					}
-				}
-				else
-				{
-					std::cout << "Vehicle is outside detection area" << std::endl;
-				}
-			}
+	// One record per light box, or the state alone for a head without boxes on this frame
+	for (const auto &area : frame.trafficAreas)
+	{
+		auto state = mStates.find(area.first);
+		TrafficLightState eState = state != mStates.end() ? state->second : LIGHT_UNKNOWN;
+		auto lights = frame.lights.find(area.first);
+		if (lights == frame.lights.end() || lights->second.empty())
+		{
+			CACResultStream::LightRecord &stRecord = cWriter.AddLight();
+			stRecord.lightId = area.first;
+			stRecord.state = eState;
+			stRecord.classId = -1;
+			continue;
 		}
-		else
+		for (const auto &obj : lights->second)
 		{
-			std::cout << "\nNo red light detected - Traffic flowing normally" << std::endl;
-			std::cout << "Total vehicles in frame: " << filteredVehicles.size() << std::endl;
+			CACResultStream::LightRecord &stRecord = cWriter.AddLight();
+			stRecord.lightId = area.first;
+			stRecord.state = eState;
+			stRecord.classId = obj.classId;
+			stRecord.confidence = obj.confidence;
+			stRecord.x = obj.box.x + (area.second.empty() ? 0 : area.second[0].x);
+			stRecord.y = obj.box.y + (area.second.empty() ? 0 : area.second[0].y);
+			stRecord.width = obj.box.width;
+			stRecord.height = obj.box.height;
 		}
+	}
 
-		return results;
+	for (size_t index : frame.violations)
+	{
+		const auto &vehicle = frame.vehicles[index];
+		CACResultStream::ViolationRecord &stRecord = cWriter.AddViolation();
+		stRecord.trackId = vehicle.trackId;
+		stRecord.classId = vehicle.classId;
+		stRecord.confidence = vehicle.confidence;
+		stRecord.laneId = frame.vehicleLanes[index];
+		stRecord.lightId = frame.LaneLightId(frame.vehicleLanes[index]);
+		stRecord.x = vehicle.box.x;
+		stRecord.y = vehicle.box.y;
+		stRecord.width = vehicle.box.width;
+		stRecord.height = vehicle.box.height;
 	}
+}
 
-	catch (std::exception &e)
+TrafficLightState ANSCustomTL::DetectLight(const cv::Mat &input, const std::vector<cv::Point> &area, const std::string &cameraId, double nowMs,
+										   CACPhaseEstimator &phaseEstimator, std::vector<ANSCENTER::Object> &lastLights,
+										   cv::Mat &crop, std::vector<ANSCENTER::Object> &lights)
+{
+	if (phaseEstimator.ShouldDetectLight(nowMs))
 	{
-		return results;
+		const cv::Mat &cvTrafficImg = cropFromFourPoints(input, area, crop);
+		// The id keys ANSLIB's tracker, which a shared model keeps per camera
+		lights = m_cTrafficLightDetector.DetectTrafficLights(cvTrafficImg, cameraId);
+		TrafficLightState eState = m_cTrafficLightDetector.GetLightState(lights);
+		phaseEstimator.Observe(nowMs, eState);
+		lastLights = lights;
+		return eState;
 	}
+
+	CACPhaseEstimator::Prediction stPrediction = phaseEstimator.Predict(nowMs);
+	lights = m_cTrafficLightDetector.MakePredictedLights(lastLights, stPrediction.state, stPrediction.confidence);
+	return stPrediction.state;
 }
 
 bool ANSCustomTL::SetParamaters(const std::vector<CustomParams> &param)
@@ -484,10 +1114,97 @@ bool ANSCustomTL::SetParamaters(const std::vector<CustomParams> &param)
 		{
 			// Set parameters for vehicle detector
 			m_cVehicleDetector.SetParameters(p);
+			m_cScheduler.SetParameters(p);
+			m_cFrameHash.SetParameters(p);
+			m_cPlateReader.SetParameters(p);
+			double dBudgetMs = -1.0;
+			double dGovernorIntervalMs = 1000.0;
+			std::string sResultStream;
+			bool bResultStream = false;
+			uint32_t nResultStreamRecords = 65536;
+			for (const auto &param : p.handleParametersJson)
+			{
+				try
+				{
+					if (param.name == "governorBudgetMs")
+					{
+						dBudgetMs = std::stod(param.value);
+					}
+					else if (param.name == "governorIntervalMs")
+					{
+						dGovernorIntervalMs = std::stod(param.value);
+					}
+					else if (param.name == "resultStreamRecords")
+					{
+						nResultStreamRecords = (uint32_t)(std::max)(64, std::stoi(param.value));
+					}
+					else if (param.name == "governorPriority")
+					{
+						m_dGovernorPriority = (std::max)(0.0, std::stod(param.value));
+					}
+					else if (param.name == "governorRedPriority")
+					{
+						m_dGovernorRedPriority = (std::max)(0.0, std::stod(param.value));
+					}
+					else if (param.name == "resultStream")
+					{
+						sResultStream = param.value;
+						bResultStream = true;
+					}
+					else if (param.name == "conditionalStages")
+					{
+						m_bConditionalStages = (std::stoi(param.value) != 0);
+					}
+					else if (param.name == "stages")
+					{
+						// Comma separated, in any order; headless nodes leave out render
+						std::vector<std::string> vStageNames;
+						std::stringstream ss(param.value);
+						std::string sName;
+						while (std::getline(ss, sName, ','))
+						{
+							sName.erase(0, sName.find_first_not_of(' '));
+							sName.erase(sName.find_last_not_of(' ') + 1);
+							if (!sName.empty())
+							{
+								vStageNames.push_back(sName);
+							}
+						}
+						std::lock_guard<std::recursive_mutex> lock(_mutex);
+						m_vStageNames = vStageNames;
+						if (!m_cStageGraph.Configure(m_vStageNames))
+						{
+							std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+						}
+					}
+				}
+				catch (const std::exception &e)
+				{
+					std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+				}
+			}
+			if (dBudgetMs >= 0.0)
+			{
+				// Node-wide: the budget applies to every camera of the process
+				CACBudgetGovernor::Instance().Configure(dBudgetMs, dGovernorIntervalMs);
+			}
+			if (bResultStream)
+			{
+				// Shared by every camera of the process that names the same stream
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				m_pResultStream = sResultStream.empty() ? nullptr : CACResultStream::GetShared(sResultStream, nResultStreamRecords);
+				if (!sResultStream.empty() && !m_pResultStream)
+				{
+					std::cerr << "Invalid value for parameter resultStream: " << sResultStream << std::endl;
+				}
+			}
 		}
 		else
 		{
 			m_cTrafficLightDetector.SetParameters(p);
+			m_cPhaseEstimator.SetParameters(p);
+			m_stLightParams = p;
+			m_mLightHeads.clear(); // Recreated with the new parameters on the next frame
 		}
 	}
 	return true;
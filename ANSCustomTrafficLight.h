@@ -3,11 +3,23 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <map>
 #include <mutex>
+#include <functional>
 #include "ANSLIB.h"
 #include "ANSCustomData.h"
 #include "Vehicle.h"
 #include "TrafficLight.h"
+#include "InferenceScheduler.h"
+#include "PhaseEstimator.h"
+#include "FrameHash.h"
+#include "FramePyramid.h"
+#include "NV12Frame.h"
+#include "PlateReader.h"
+#include "StageGraph.h"
+#include "BudgetGovernor.h"
+#include "SharedFrameRing.h"
+#include "ResultStream.h"
 
 #define CUSTOM_API __declspec(dllexport)
 
@@ -32,10 +44,75 @@ public:
 // Implementation of the traffic light model
 class CUSTOM_API ANSCustomTL : public IANSCustomClass
 {
+public:
+  // State of the frame going through the stage graph. Stages hand their outputs over here in place,
+  // the input is a header over the caller's pixels.
+  struct FrameContext
+  {
+    cv::Mat input;  // Header over the caller's frame
+    cv::Mat output; // Where the render stage draws, the input itself for BGR callers; empty to skip it
+    std::string cameraId;
+    double nowMs{0.0};
+    std::vector<CACLane> lanes;
+    std::map<int, std::vector<cv::Point>> trafficAreas; // By light id
+    int defaultLightId{0}; // Head of the lanes without their own: TrafficRoi, else the first TrafficRoi_N
+    std::map<int, std::vector<ANSCENTER::Object>> lights;
+    std::map<int, TrafficLightState> lightStates;
+    bool lightsDone{false};
+    std::vector<ANSCENTER::Object> vehicles; // Inside a lane
+    std::vector<int> vehicleLanes;
+    std::vector<bool> plateRequested; // Per vehicle, crop already queued for ALPR on this frame
+    bool lanesAssigned{false};
+    long long trackingFrame{-1}; // Tracker update made by the detect stage, -1 when it did not run
+    std::vector<bool> crossed; // Per vehicle, set by the track stage
+    std::map<int, bool> redLights;
+    bool isRedLight{false};
+    std::vector<size_t> violations; // Indices into vehicles
+    std::vector<CustomObject> results;
+
+    int LaneLightId(int laneId) const; // Signal head controlling the lane
+  };
 
 private:
   CACVehicle m_cVehicleDetector;           // Vehicle object
   CACTrafficLight m_cTrafficLightDetector; // Traffic light object
+  CACInferenceScheduler m_cScheduler;      // Vehicle detector rate per light state
+  std::vector<ANSCENTER::Object> m_vLastVehicles; // Reused on frames the scheduler skips
+  CACPhaseEstimator m_cPhaseEstimator;     // Learned signal plan, decides when the light model runs
+  std::vector<ANSCENTER::Object> m_vLastTrafficLights; // Last detected light boxes, relabelled on predicted frames
+  CACFrameHash m_cFrameHash;               // Repeated/frozen frame detection per camera
+  CACFramePyramid m_cFramePyramid;         // Downscaled/gray versions of the current frame, built once
+  CACNV12Frame m_cNV12Frame;               // BGR buffer for NV12 input, converted on the ROIs only
+  cv::Mat m_cTrafficCrop;                  // Warped TrafficRoi, buffer reused every frame
+  CACPlateReader m_cPlateReader;           // ALPR on violating vehicles, asynchronous
+
+  // Signal heads of the lanes with their own TrafficRoi_N, head 0 is the members above
+  struct LightHead
+  {
+    CACPhaseEstimator phaseEstimator;
+    std::vector<ANSCENTER::Object> lastLights;
+    cv::Mat crop;
+  };
+  std::map<int, LightHead> m_mLightHeads;
+  CustomParams m_stLightParams;            // Light handle parameters, applied to new heads
+  std::map<int, TrafficLightState> m_mLastLightStates; // Per head, used by frames that skip the lights stage
+
+  FrameContext m_stFrame;
+  CACStageGraph m_cStageGraph;
+  std::vector<std::string> m_vStageNames; // Configured by the "stages" parameter
+
+  // Quality level from the process-wide budget governor
+  std::shared_ptr<CACBudgetGovernor::Client> m_pGovernorClient;
+  double m_dGovernorPriority;
+  double m_dGovernorRedPriority;
+  long long m_nFrameCounter;
+  std::vector<CustomObject> m_vLastResults; // Returned on frames outside the level's stride
+  double m_dLightIntervalMs;
+  double m_dLastLightMs;
+  std::map<std::string, uint32_t> m_mSharedSequences; // Last frame taken from the shared ring, per camera
+  std::map<std::string, long long> m_mSharedDropped;  // Ring frames overwritten before the camera got to them
+  std::shared_ptr<CACResultStream> m_pResultStream; // Binary results for other processes, null when off
+  bool m_bConditionalStages; // Skip stages that cannot change the outcome of the frame
   std::recursive_mutex _mutex;
   ANSCENTER::ANSLIB vehicleDetector;      // This is the vehicle object detector
   ANSCENTER::ANSLIB trafficLightDetector; // This is the traffic light object detector
@@ -58,13 +135,73 @@ private:
 
   double _detectionScoreThreshold{0.5};
 
+  // Detects the lights of one head, or predicts them from its phase estimator
+  TrafficLightState DetectLight(const cv::Mat &input, const std::vector<cv::Point> &area, const std::string &cameraId, double nowMs,
+                                CACPhaseEstimator &phaseEstimator, std::vector<ANSCENTER::Object> &lastLights,
+                                cv::Mat &crop, std::vector<ANSCENTER::Object> &lights);
+
+  // Stages of RunInference, see BuildStageGraph for their order and conditions
+  void BuildStageGraph();
+  void ReportToGovernor(bool processed);
+  TrafficLightState GetJunctionState() const;
+  void RunLightStage();
+  void ReuseLights();
+  void RunVehicleStage();
+  void FilterVehicles();
+  void AnalyseLights();
+  void TrackCrossings();
+  void CheckViolations();
+  void RenderFrame();
+  void ExportResults();
+  void PublishResults();
+
 public:
   bool Initialize(const std::string &modelDiretory, float detectionScoreThreshold, std::string &labelMap) override;
   bool OptimizeModel(bool fp16) override;
   bool SetParamaters(const std::vector<CustomParams> &param);
   std::vector<CustomObject> RunInference(const cv::Mat &input) override;
   std::vector<CustomObject> RunInference(const cv::Mat &input, const std::string &camera_id) override;
+  // RunInference with the overlays drawn on output instead of the input, or nowhere when it is
+  // empty; for input the caller does not own, such as a shared ring slot
+  std::vector<CustomObject> RunFrame(const cv::Mat &input, const cv::Mat &output, const std::string &camera_id);
+  // NV12 decoder output: Y plane (CV_8UC1) and interleaved UV plane (CV_8UC2 at half resolution).
+  // Only the regions the detectors read (DetectArea bounds when cropping or tiling, the whole frame
+  // otherwise, and the TrafficRoi) are converted to BGR, and nothing is drawn. With an output the
+  // whole frame is converted into it and the overlays are drawn there.
+  std::vector<CustomObject> RunInferenceNV12(const cv::Mat &yPlane, const cv::Mat &uvPlane, const std::string &camera_id,
+                                             cv::Mat *output = nullptr);
+  std::vector<CustomObject> RunInferenceNV12(const unsigned char *y, size_t yStride, const unsigned char *uv, size_t uvStride,
+                                             int width, int height, const std::string &camera_id, cv::Mat *output = nullptr);
+  // Newest frame of the camera in a shared frame ring filled by a decoder process, used in place.
+  // Waits up to timeoutMs for a frame newer than the last one; empty results when none came.
+  // The ring slot is never drawn on; with an output the frame is copied there with the overlays.
+  std::vector<CustomObject> RunInferenceShared(CACSharedFrameRing &ring, const std::string &camera_id, int timeoutMs,
+                                               cv::Mat *output = nullptr);
   bool ConfigureParamaters(std::vector<CustomParams> &param) override;
+  bool IsStreamFrozen(const std::string &camera_id) const { return m_cFrameHash.IsFrozen(camera_id); }
+  // Per-lane counts, flow, occupancy and queues; does not wait for a running inference
+  void GetTrafficAnalytics(CACTrafficAnalytics::Snapshot &snapshot) const { m_cVehicleDetector.GetAnalyticsSnapshot(snapshot); }
+  // Adds a stage that runs after the named ones once "stages" lists it, e.g. a custom exporter
+  void RegisterStage(const std::string &name, const std::function<void(FrameContext &)> &run, const std::vector<std::string> &after);
+  // Runs, skips and mean time of each RunInference stage
+  std::vector<CACStageGraph::StageStats> GetStageStats()
+  {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    return m_cStageGraph.GetStats();
+  }
+  // Frames of the shared ring the camera did not get to, since it first read from it
+  long long GetSharedFramesDropped(const std::string &camera_id)
+  {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    auto it = m_mSharedDropped.find(camera_id);
+    return it != m_mSharedDropped.end() ? it->second : 0;
+  }
+  // Tiles, inference time and boxes before/after the merge of the last tiled frame
+  CACTiler::Stats GetTilingStats()
+  {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    return m_cVehicleDetector.GetTilingStats();
+  }
 
   bool Destroy() override;
   ANSCustomTL();
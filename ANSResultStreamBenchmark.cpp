@@ -0,0 +1,129 @@
+// Throughput of a result stream: one producer publishing frames as fast as it can, and consumers
+// with their own mapping of the ring (as other processes would have) validating every record.
+//
+//   ANSResultStreamBenchmark [<consumers> [<seconds> [<vehicles per frame> [<records in the ring>]]]]
+#include "ResultStream.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+struct ConsumerResult
+{
+    uint64_t records{0};
+    uint64_t frames{0};
+    uint64_t lost{0};
+    uint64_t invalid{0}; // Records the producer rewrote while they were read
+    uint64_t corrupt{0}; // Validated records whose payload did not match what the producer wrote
+};
+
+int main(int argc, char **argv)
+{
+    int consumers = argc > 1 ? std::atoi(argv[1]) : 2;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+    int vehicles = argc > 3 ? std::atoi(argv[3]) : 20;
+    uint32_t capacity = argc > 4 ? (uint32_t)std::atoi(argv[4]) : 65536;
+    std::string name = "ans_result_stream_benchmark_" + std::to_string((long long)std::chrono::steady_clock::now().time_since_epoch().count());
+
+    CACResultStream producer;
+    if (!producer.Create(name, capacity))
+    {
+        return -1;
+    }
+
+    std::atomic<bool> running(true);
+    std::vector<ConsumerResult> results(consumers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            CACResultStream stream;
+            if (!stream.Open(name))
+            {
+                return;
+            }
+            ConsumerResult &result = results[i];
+            uint64_t cursor = stream.GetCursor();
+            while (running)
+            {
+                if (!stream.Wait(cursor, 100))
+                {
+                    continue;
+                }
+                const CACResultStream::Record *record;
+                while ((record = stream.Peek(cursor, result.lost)) != nullptr)
+                {
+                    // The producer derives every payload field from the record's sequence
+                    uint64_t sequence = cursor;
+                    uint16_t type = record->type;
+                    int32_t check = record->detection.trackId;
+                    uint64_t frameSequence = record->frameSequence;
+                    if (!stream.Validate(record, sequence))
+                    {
+                        ++result.invalid;
+                        continue;
+                    }
+                    if (type == CACResultStream::RECORD_DETECTION && check != (int32_t)(sequence & 0x7FFFFFFF))
+                    {
+                        ++result.corrupt;
+                    }
+                    if (type == CACResultStream::RECORD_FRAME)
+                    {
+                        result.frames += (frameSequence == sequence) ? 1 : 0;
+                    }
+                    ++result.records;
+                    ++cursor;
+                }
+            } });
+    }
+
+    // Three cameras take turns, like the instances of one process sharing a stream
+    const char *cameraIds[] = {"cam-1", "cam-2", "cam-3"};
+    uint64_t producedFrames = 0;
+    uint64_t producedRecords = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        for (int batch = 0; batch < 256; ++batch)
+        {
+            CACResultStream::FrameWriter writer(producer, cameraIds[producedFrames % 3], (double)producedFrames, 1920, 1080, 3);
+            for (int v = 0; v < vehicles; ++v)
+            {
+                CACResultStream::DetectionRecord &detection = writer.AddDetection();
+                detection.trackId = (int32_t)((producer.GetPublished() + 2 + v) & 0x7FFFFFFF);
+                detection.classId = 2;
+                detection.confidence = 0.9f;
+                detection.width = 100;
+                detection.height = 80;
+            }
+            CACResultStream::LightRecord &light = writer.AddLight();
+            light.state = 3;
+            light.classId = -1;
+            ++producedFrames;
+            producedRecords += vehicles + 2;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::cout << "Ring " << producer.GetCapacity() << " records of " << sizeof(CACResultStream::Record) << " bytes, "
+              << vehicles << " vehicles per frame, " << elapsed << " s" << std::endl;
+    std::cout << "Producer: " << producedFrames / elapsed << " frames/s, " << producedRecords / elapsed << " records/s, "
+              << producedRecords * sizeof(CACResultStream::Record) / elapsed / (1024.0 * 1024.0) << " MB/s" << std::endl;
+    for (int i = 0; i < consumers; ++i)
+    {
+        std::cout << "Consumer " << i << ": " << results[i].records / elapsed << " records/s, " << results[i].frames << " frames, "
+                  << results[i].lost << " lost, " << results[i].invalid << " rewritten while read, " << results[i].corrupt
+                  << " corrupt" << std::endl;
+    }
+    return 0;
+}
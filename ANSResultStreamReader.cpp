@@ -0,0 +1,110 @@
+// Reference consumer of a result stream: follows the ring from the next frame on and prints every
+// record, reading each one in place and checking it was not overwritten meanwhile.
+//
+//   ANSResultStreamReader <stream name> [<camera id>]
+#include "ResultStream.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+static const char *LightStateName(int state)
+{
+    switch (state)
+    {
+    case 1:
+        return "green";
+    case 2:
+        return "yellow";
+    case 3:
+        return "red";
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <stream name> [<camera id>]" << std::endl;
+        return -1;
+    }
+
+    CACResultStream stream;
+    if (!stream.Open(argv[1]))
+    {
+        return -1;
+    }
+    std::string cameraFilter = argc > 2 ? argv[2] : "";
+    std::cout << "Result stream " << argv[1] << ": " << stream.GetCapacity() << " records" << std::endl;
+
+    uint64_t cursor = stream.GetCursor();
+    uint64_t lost = 0;
+    while (true)
+    {
+        if (!stream.Wait(cursor, 1000))
+        {
+            continue;
+        }
+        uint64_t lostBefore = lost;
+        const CACResultStream::Record *record = stream.Peek(cursor, lost);
+        if (lost != lostBefore)
+        {
+            std::cout << "Lapped by the producer, " << lost - lostBefore << " records lost" << std::endl;
+        }
+        if (!record)
+        {
+            continue;
+        }
+
+        // Fields are copied into locals and only used once the slot still holds the same sequence
+        uint64_t sequence = cursor;
+        CACResultStream::Record copy;
+        copy.frameSequence = record->frameSequence;
+        copy.type = record->type;
+        copy.camera = record->camera;
+        std::memcpy(copy.payload, record->payload, sizeof(copy.payload));
+        if (!stream.Validate(record, sequence))
+        {
+            continue; // Peek at the same cursor finds the newer record
+        }
+        ++cursor;
+
+        std::string cameraId = stream.GetCameraId(copy.camera);
+        if (!cameraFilter.empty() && cameraId != cameraFilter)
+        {
+            continue;
+        }
+        char line[256];
+        switch (copy.type)
+        {
+        case CACResultStream::RECORD_FRAME:
+            std::snprintf(line, sizeof(line), "#%llu frame %s id=%llu t=%.1f %dx%d signal=%s det=%u lights=%u violations=%u",
+                          (unsigned long long)sequence, cameraId.c_str(), (unsigned long long)copy.frame.frameId,
+                          copy.frame.timestampMs, copy.frame.width, copy.frame.height, LightStateName(copy.frame.junctionState),
+                          copy.frame.detections, copy.frame.lights, copy.frame.violations);
+            break;
+        case CACResultStream::RECORD_DETECTION:
+            std::snprintf(line, sizeof(line), "  vehicle class=%d track=%d conf=%.2f box=%d,%d,%dx%d lane=%d light=%d%s",
+                          copy.detection.classId, copy.detection.trackId, copy.detection.confidence, copy.detection.x,
+                          copy.detection.y, copy.detection.width, copy.detection.height, copy.detection.laneId,
+                          copy.detection.lightId, copy.detection.crossed ? " crossed" : "");
+            break;
+        case CACResultStream::RECORD_LIGHT:
+            std::snprintf(line, sizeof(line), "  light %d %s class=%d conf=%.2f box=%d,%d,%dx%d", copy.light.lightId,
+                          LightStateName(copy.light.state), copy.light.classId, copy.light.confidence, copy.light.x,
+                          copy.light.y, copy.light.width, copy.light.height);
+            break;
+        case CACResultStream::RECORD_VIOLATION:
+            std::snprintf(line, sizeof(line), "  VIOLATION track=%d class=%d lane=%d light=%d box=%d,%d,%dx%d",
+                          copy.violation.trackId, copy.violation.classId, copy.violation.laneId, copy.violation.lightId,
+                          copy.violation.x, copy.violation.y, copy.violation.width, copy.violation.height);
+            break;
+        default:
+            std::snprintf(line, sizeof(line), "  record type %u", (unsigned)copy.type);
+            break;
+        }
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Coordinator/worker scale-out on one machine. The coordinator starts this executable again as its
+// workers, spreads the cameras of the decoder's shared frame ring (see ANSSharedFrameDecoder) over
+// them and prints the aggregated metrics every few seconds.
+//
+//   ANSShardNode coordinator <socket path> <workers> <frame ring> <model dir> <result stream|-> <camera id>[=<parameters.json>] [...]
+//   ANSShardNode worker <socket path> <index> <frame ring> <model dir> [<result stream>]
+#include "ShardCoordinator.h"
+#include "ShardWorker.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+
+static int RunCoordinator(int argc, char **argv)
+{
+    CACShardCoordinator::Config stConfig;
+    stConfig.socketPath = argv[2];
+    stConfig.workers = std::atoi(argv[3]);
+    stConfig.workerExecutable = argv[0];
+    stConfig.workerArguments = {argv[4], argv[5]};
+    if (std::string(argv[6]) != "-")
+    {
+        stConfig.workerArguments.push_back(argv[6]);
+    }
+
+    CACShardCoordinator coordinator;
+    for (int i = 7; i < argc; ++i)
+    {
+        // The ROIs and parameters of a camera, in the JSON layout of ANSCustomData.h
+        std::string sCamera = argv[i];
+        size_t nSeparator = sCamera.find('=');
+        if (nSeparator == std::string::npos)
+        {
+            coordinator.AddCamera(sCamera);
+        }
+        else
+        {
+            coordinator.AddCamera(sCamera.substr(0, nSeparator), sCamera.substr(nSeparator + 1));
+        }
+    }
+    if (!coordinator.Start(stConfig))
+    {
+        return -1;
+    }
+
+    std::atomic<bool> running(true);
+    std::thread input([&running]()
+                      {
+        std::cin.get();
+        running = false; });
+    std::cout << "Press Enter to stop" << std::endl;
+
+    auto lastPrint = std::chrono::steady_clock::now();
+    while (running)
+    {
+        coordinator.Poll(50);
+        if (std::chrono::steady_clock::now() - lastPrint < std::chrono::seconds(5))
+        {
+            continue;
+        }
+        lastPrint = std::chrono::steady_clock::now();
+        CACShardCoordinator::Stats stats = coordinator.GetStats();
+        std::cout << "Node: " << stats.fps << " fps, " << stats.loadMs << " inference ms/s, " << stats.frames << " frames, "
+                  << stats.dropped << " dropped, " << stats.moves << " moves" << std::endl;
+        for (const auto &worker : stats.workers)
+        {
+            std::cout << "  worker " << worker.index << (worker.connected ? "" : " (down)") << ": pid " << worker.pid << ", "
+                      << worker.cameras << " cameras, " << worker.loadMs << " ms/s, " << worker.restarts << " restarts" << std::endl;
+        }
+        for (const auto &camera : stats.cameras)
+        {
+            std::cout << "  camera " << camera.cameraId << " -> worker " << camera.worker << ": " << camera.fps << " fps, "
+                      << camera.meanMs << " ms per frame, " << camera.failures << " failures" << std::endl;
+        }
+    }
+    coordinator.Stop();
+    input.join();
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string sRole = argc > 1 ? argv[1] : "";
+    if (sRole == "coordinator" && argc >= 8)
+    {
+        return RunCoordinator(argc, argv);
+    }
+    if (sRole == "worker" && argc >= 6)
+    {
+        CACShardWorker::Config stConfig;
+        stConfig.socketPath = argv[2];
+        stConfig.workerIndex = std::atoi(argv[3]);
+        stConfig.frameRing = argv[4];
+        stConfig.modelDirectory = argv[5];
+        stConfig.resultStream = argc > 6 ? argv[6] : "";
+        CACShardWorker worker;
+        return worker.Run(stConfig);
+    }
+    std::cerr << "Usage: " << argv[0] << " coordinator <socket path> <workers> <frame ring> <model dir> <result stream|-> <camera id>[=<parameters.json>] [...]" << std::endl;
+    std::cerr << "       " << argv[0] << " worker <socket path> <index> <frame ring> <model dir> [<result stream>]" << std::endl;
+    return -1;
+}
@@ -0,0 +1,94 @@
+// Stand-in for the decoder process: decodes video files into a shared frame ring, one camera per
+// file, at the files' frame rate (looping), so RunInferenceShared can be exercised on one machine.
+//
+//   ANSSharedFrameDecoder <ring name> <camera id> <video file> [<camera id> <video file> ...]
+#include "SharedFrameRing.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+int main(int argc, char **argv)
+{
+    if (argc < 4 || (argc - 2) % 2 != 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ring name> <camera id> <video file> [<camera id> <video file> ...]" << std::endl;
+        return -1;
+    }
+
+    std::string ringName = argv[1];
+    std::vector<std::string> cameraIds;
+    std::vector<std::string> videoFiles;
+    size_t slotBytes = 0;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        cv::VideoCapture capture(argv[i + 1]);
+        if (!capture.isOpened())
+        {
+            std::cerr << "Cannot open " << argv[i + 1] << std::endl;
+            return -1;
+        }
+        size_t frameBytes = (size_t)capture.get(cv::CAP_PROP_FRAME_WIDTH) * (size_t)capture.get(cv::CAP_PROP_FRAME_HEIGHT) * 3;
+        slotBytes = (std::max)(slotBytes, frameBytes);
+        cameraIds.push_back(argv[i]);
+        videoFiles.push_back(argv[i + 1]);
+    }
+
+    CACSharedFrameRing ring;
+    if (!ring.Create(ringName, cameraIds, 4, slotBytes))
+    {
+        return -1;
+    }
+    std::cout << "Shared frame ring " << ringName << ": " << cameraIds.size() << " cameras, " << slotBytes << " bytes per slot" << std::endl;
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> decoders;
+    for (size_t camera = 0; camera < cameraIds.size(); ++camera)
+    {
+        decoders.emplace_back([&, camera]()
+                              {
+            cv::VideoCapture capture(videoFiles[camera]);
+            double fps = capture.get(cv::CAP_PROP_FPS);
+            auto period = std::chrono::microseconds((long long)(1000000.0 / (fps > 0.0 ? fps : 25.0)));
+            cv::Size size((int)capture.get(cv::CAP_PROP_FRAME_WIDTH), (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+            cv::Mat decoded;
+            long long frames = 0;
+            auto next = std::chrono::steady_clock::now();
+            while (running)
+            {
+                // Decoded straight into the slot; a frame of another size lands in a local buffer and is copied
+                cv::Mat view = ring.BeginWrite((int)camera, size, CV_8UC3);
+                const unsigned char *slotData = view.data;
+                bool decodedFrame = view.empty() ? capture.read(decoded) : capture.read(view);
+                if (!decodedFrame)
+                {
+                    capture.set(cv::CAP_PROP_POS_FRAMES, 0); // Loop the file
+                    continue;
+                }
+                double nowMs = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+                if (!view.empty() && view.data == slotData)
+                {
+                    ring.CommitWrite((int)camera, nowMs);
+                }
+                else if (!ring.Write((int)camera, view.empty() ? decoded : view, nowMs))
+                {
+                    std::cerr << "Camera " << cameraIds[camera] << ": frame does not fit the ring slot" << std::endl;
+                }
+                if (++frames % 250 == 0)
+                {
+                    std::cout << "Camera " << cameraIds[camera] << ": " << frames << " frames" << std::endl;
+                }
+                next += period;
+                std::this_thread::sleep_until(next);
+            } });
+    }
+
+    std::cout << "Press Enter to stop" << std::endl;
+    std::cin.get();
+    running = false;
+    for (auto &decoder : decoders)
+    {
+        decoder.join();
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "BoxTracker.h"
+#include <algorithm>
+
+CACBoxTracker::CACBoxTracker()
+{
+    m_nNextId = 1;
+    m_fMinIoU = 0.3f;
+    m_nMaxMissed = 25;
+}
+
+void CACBoxTracker::Reset()
+{
+    m_vTracks.clear();
+}
+
+void CACBoxTracker::NewSource()
+{
+    for (auto &track : m_vTracks)
+    {
+        track.sourceId = -1;
+    }
+}
+
+static float BoxIoU(const cv::Rect &a, const cv::Rect &b)
+{
+    float inter = (float)(a & b).area();
+    float total = (float)(a.area() + b.area()) - inter;
+    return total > 0.0f ? inter / total : 0.0f;
+}
+
+void CACBoxTracker::Assign(std::vector<ANSCENTER::Object> &objects, bool sourceIds)
+{
+    std::vector<int> objectTrack(objects.size(), -1);
+    std::vector<unsigned char> trackUsed(m_vTracks.size(), 0);
+
+    // Detector ids seen before keep their track
+    for (size_t i = 0; sourceIds && i < objects.size(); ++i)
+    {
+        for (size_t t = 0; t < m_vTracks.size(); ++t)
+        {
+            if (!trackUsed[t] && m_vTracks[t].sourceId >= 0 && m_vTracks[t].sourceId == objects[i].trackId)
+            {
+                objectTrack[i] = (int)t;
+                trackUsed[t] = 1;
+                break;
+            }
+        }
+    }
+
+    // The others continue the track they overlap most, best pairs first
+    std::vector<std::pair<float, std::pair<size_t, size_t>>> pairs;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        for (size_t t = 0; objectTrack[i] < 0 && t < m_vTracks.size(); ++t)
+        {
+            float iou = trackUsed[t] ? 0.0f : BoxIoU(objects[i].box, m_vTracks[t].box);
+            if (iou >= m_fMinIoU)
+            {
+                pairs.push_back(std::make_pair(iou, std::make_pair(i, t)));
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const std::pair<float, std::pair<size_t, size_t>> &a, const std::pair<float, std::pair<size_t, size_t>> &b)
+              { return a.first > b.first; });
+    for (const auto &pair : pairs)
+    {
+        size_t i = pair.second.first;
+        size_t t = pair.second.second;
+        if (objectTrack[i] < 0 && !trackUsed[t])
+        {
+            objectTrack[i] = (int)t;
+            trackUsed[t] = 1;
+        }
+    }
+
+    for (size_t t = 0; t < m_vTracks.size(); ++t)
+    {
+        m_vTracks[t].missed = trackUsed[t] ? 0 : m_vTracks[t].missed + 1;
+    }
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (objectTrack[i] < 0)
+        {
+            Track track;
+            track.id = m_nNextId++;
+            track.missed = 0;
+            objectTrack[i] = (int)m_vTracks.size();
+            m_vTracks.push_back(track);
+        }
+        Track &track = m_vTracks[objectTrack[i]];
+        track.sourceId = sourceIds ? objects[i].trackId : -1;
+        track.box = objects[i].box;
+        objects[i].trackId = track.id;
+    }
+
+    int maxMissed = m_nMaxMissed;
+    m_vTracks.erase(std::remove_if(m_vTracks.begin(), m_vTracks.end(), [maxMissed](const Track &track)
+                                   { return track.missed > maxMissed; }),
+                    m_vTracks.end());
+}
@@ -0,0 +1,41 @@
+#ifndef BOX_TRACKER_H
+#define BOX_TRACKER_H
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Per-camera track ids above the detector. ANSLIB's tracker numbers the objects of one image
+// stream; where the detector output is not one such stream (tiles tracked separately and merged)
+// its ids mean nothing, so the boxes are matched to the camera's tracks by overlap instead.
+// Otherwise a detector id that was seen before keeps its track and only new ones are matched.
+// When the detections start coming from another tracker (another engine or handle), whose ids
+// start over, the tracks are carried over by overlap as well.
+class CACBoxTracker
+{
+private:
+    struct Track
+    {
+        int id;
+        int sourceId; // Detector id of the last match, -1 when matched by overlap
+        cv::Rect box;
+        int missed;   // Detector frames without a match
+    };
+
+    std::vector<Track> m_vTracks;
+    int m_nNextId;
+    float m_fMinIoU;   // Overlap with the last box needed to continue a track
+    int m_nMaxMissed;  // Detector frames a track survives without a match
+
+public:
+    CACBoxTracker();
+
+    // Replaces the trackId of every object with the camera's track id. With sourceIds the objects'
+    // trackIds come from one ANSLIB tracker and identify the objects between frames.
+    void Assign(std::vector<ANSCENTER::Object> &objects, bool sourceIds);
+    // The next detections come from another ANSLIB tracker: forget the detector ids
+    void NewSource();
+    void Reset();
+};
+
+#endif // BOX_TRACKER_H
@@ -0,0 +1,182 @@
+#include "BudgetGovernor.h"
+#include <iostream>
+#include <algorithm>
+#include "ResolutionTuner.h"
+
+CACBudgetGovernor::CACBudgetGovernor()
+{
+    m_vLevels = {
+        {1, 0.0, 0},
+        {1, 500.0, 0},
+        {1, 500.0, 640},
+        {2, 500.0, 640},
+        {2, 1000.0, 640},
+        {3, 1000.0, 480},
+        {5, 2000.0, 480}};
+    m_dBudgetMs = 0.0;
+    m_dIntervalMs = 1000.0;
+    m_dLastRebalanceMs = 0.0;
+}
+
+CACBudgetGovernor &CACBudgetGovernor::Instance()
+{
+    static CACBudgetGovernor governor;
+    return governor;
+}
+
+std::shared_ptr<CACBudgetGovernor::Client> CACBudgetGovernor::Register()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    std::shared_ptr<Client> client = std::make_shared<Client>();
+    m_vClients.push_back(client);
+    return client;
+}
+
+void CACBudgetGovernor::Configure(double budgetMs, double intervalMs)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    m_dBudgetMs = (std::max)(0.0, budgetMs);
+    m_dIntervalMs = (std::max)(10.0, intervalMs);
+    m_stStats.budgetMs = m_dBudgetMs;
+}
+
+double CACBudgetGovernor::EstimateCost(const Client &client, int level) const
+{
+    // Milliseconds per second: processed frames pay the detector and the other stages; the light
+    // stage runs at most once per interval
+    const QualityLevel &quality = m_vLevels[level];
+    double processedFps = client.m_dFps / quality.frameStride;
+    double lightRuns = quality.lightIntervalMs > 0.0 ? (std::min)(processedFps, 1000.0 / quality.lightIntervalMs) : processedFps;
+    // The detector was measured at the side of the camera's current level
+    double detectMs = client.m_dDetectMs;
+    if (client.m_nTunedSide > 0)
+    {
+        double side = CACResolutionTuner::CapSide(client.m_vInputSides, client.m_nTunedSide, quality.maxInputSide);
+        double measured = CACResolutionTuner::CapSide(client.m_vInputSides, client.m_nTunedSide, m_vLevels[client.GetLevel()].maxInputSide);
+        detectMs *= (side * side) / (measured * measured);
+    }
+    return processedFps * (detectMs + client.m_dOtherMs) +
+           lightRuns * client.m_dLightsMs;
+}
+
+double CACBudgetGovernor::Coverage(int level) const
+{
+    // Fraction of frames processed; levels with the same stride are ordered by a small bonus
+    return 1.0 / m_vLevels[level].frameStride + 0.05 * ((int)m_vLevels.size() - 1 - level);
+}
+
+void CACBudgetGovernor::Report(Client &client, const Sample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    const double alpha = 0.1;
+    if (client.m_dLastMs > 0.0 && sample.nowMs > client.m_dLastMs)
+    {
+        double fps = 1000.0 / (sample.nowMs - client.m_dLastMs);
+        client.m_dFps = client.m_dFps == 0.0 ? fps : client.m_dFps + alpha * (fps - client.m_dFps);
+    }
+    client.m_dLastMs = sample.nowMs;
+    client.m_sCameraId = sample.cameraId;
+    client.m_dPriority = sample.priority;
+    if (sample.processed)
+    {
+        client.m_dDetectMs = sample.detectMs;
+        client.m_dLightsMs = sample.lightsMs;
+        client.m_dOtherMs = sample.otherMs;
+        client.m_nTunedSide = sample.tunedSide;
+        client.m_vInputSides = sample.inputSides;
+    }
+
+    if (m_dBudgetMs <= 0.0)
+    {
+        client.m_nLevel.store(0, std::memory_order_relaxed);
+        return;
+    }
+    if (sample.nowMs - m_dLastRebalanceMs >= m_dIntervalMs)
+    {
+        m_dLastRebalanceMs = sample.nowMs;
+        Rebalance();
+    }
+}
+
+void CACBudgetGovernor::Rebalance()
+{
+    std::vector<std::shared_ptr<Client>> clients;
+    for (auto it = m_vClients.begin(); it != m_vClients.end();)
+    {
+        std::shared_ptr<Client> client = it->lock();
+        if (!client)
+        {
+            it = m_vClients.erase(it);
+            continue;
+        }
+        clients.push_back(client);
+        ++it;
+    }
+
+    // Everyone at the lowest level, then the upgrade with the best priority-weighted coverage per
+    // millisecond until nothing more fits
+    int lowest = (int)m_vLevels.size() - 1;
+    std::vector<int> levels(clients.size(), lowest);
+    double planned = 0.0;
+    double demand = 0.0;
+    for (const auto &client : clients)
+    {
+        planned += EstimateCost(*client, lowest);
+        demand += EstimateCost(*client, 0);
+    }
+    while (true)
+    {
+        int best = -1;
+        double bestRatio = 0.0;
+        double bestExtra = 0.0;
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            if (levels[i] == 0)
+            {
+                continue;
+            }
+            double extra = EstimateCost(*clients[i], levels[i] - 1) - EstimateCost(*clients[i], levels[i]);
+            if (planned + extra > m_dBudgetMs)
+            {
+                continue;
+            }
+            double gain = clients[i]->m_dPriority * (Coverage(levels[i] - 1) - Coverage(levels[i]));
+            double ratio = gain / (std::max)(extra, 0.01);
+            if (best < 0 || ratio > bestRatio)
+            {
+                best = (int)i;
+                bestRatio = ratio;
+                bestExtra = extra;
+            }
+        }
+        if (best < 0)
+        {
+            break;
+        }
+        levels[best]--;
+        planned += bestExtra;
+    }
+
+    for (size_t i = 0; i < clients.size(); ++i)
+    {
+        int previous = clients[i]->GetLevel();
+        if (previous != levels[i])
+        {
+            clients[i]->m_nLevel.store(levels[i], std::memory_order_relaxed);
+            std::cout << "Budget governor: camera " << clients[i]->m_sCameraId << " level " << previous << " -> " << levels[i]
+                      << " (priority " << clients[i]->m_dPriority << ", " << EstimateCost(*clients[i], levels[i]) << " ms/s)"
+                      << " | node " << planned << " of " << m_dBudgetMs << " ms/s, " << demand << " ms/s at full quality" << std::endl;
+        }
+    }
+
+    m_stStats.demandMs = demand;
+    m_stStats.plannedMs = planned;
+    m_stStats.clients = (int)clients.size();
+    m_stStats.rebalances++;
+}
+
+CACBudgetGovernor::Stats CACBudgetGovernor::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    return m_stStats;
+}
@@ -0,0 +1,100 @@
+#ifndef BUDGET_GOVERNOR_H
+#define BUDGET_GOVERNOR_H
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// Process-wide compute budget shared by every ANSCustomTL instance. Each camera reports its frame
+// rate and the live cost of its stages; the governor estimates what every quality level would
+// cost the camera per second and, within the node budget (inference milliseconds per second),
+// gives the levels out greedily by priority-weighted coverage gained per millisecond: all cameras
+// start at the lowest level and the best upgrade is taken until the budget is used. Red-phase
+// cameras report a higher priority, so they keep their quality first. Rebalanced continuously.
+// The detector cost of a level is scaled by its input area against the side it was measured at.
+class CACBudgetGovernor
+{
+public:
+    struct QualityLevel
+    {
+        // The engines take a fixed input size, so a lower resolution only makes a run cheaper on the
+        // rungs that have an engine of their own (see CACResolutionTuner); the side limit is mapped
+        // onto the camera's usable rungs and ignored on cameras without any
+        int frameStride;        // Process one frame in this many
+        double lightIntervalMs; // Shortest time between light stage runs, 0 for every frame
+        int maxInputSide;       // Largest vehicle detector input side, 0 for no limit
+    };
+
+    struct Sample
+    {
+        std::string cameraId;
+        double nowMs{0.0};
+        bool processed{false}; // False for frames the stride skipped
+        double detectMs{0.0};  // Per run, from the stage timings
+        double lightsMs{0.0};
+        double otherMs{0.0};   // Every other stage of a processed frame
+        double priority{1.0};
+        int tunedSide{0};             // Detector input side the resolution tuner chose, 0 without tuning
+        std::vector<int> inputSides;  // Usable detector input sides, ascending
+    };
+
+    // One per camera; the level is read on every frame without taking the governor lock
+    class Client
+    {
+        friend class CACBudgetGovernor;
+        std::atomic<int> m_nLevel{0};
+        std::string m_sCameraId;
+        double m_dFps{0.0};
+        double m_dLastMs{0.0};
+        double m_dDetectMs{0.0};
+        double m_dLightsMs{0.0};
+        double m_dOtherMs{0.0};
+        double m_dPriority{1.0};
+        int m_nTunedSide{0};
+        std::vector<int> m_vInputSides;
+
+    public:
+        int GetLevel() const { return m_nLevel.load(std::memory_order_relaxed); }
+    };
+
+    struct Stats
+    {
+        double budgetMs{0.0};
+        double demandMs{0.0};  // All cameras at the best level
+        double plannedMs{0.0}; // At the assigned levels
+        int clients{0};
+        long long rebalances{0};
+    };
+
+private:
+    std::mutex m_cMutex;
+    std::vector<std::weak_ptr<Client>> m_vClients;
+    std::vector<QualityLevel> m_vLevels; // Best first
+    double m_dBudgetMs;                  // Inference milliseconds per second for the node, 0 for no limit
+    double m_dIntervalMs;
+    double m_dLastRebalanceMs;
+    Stats m_stStats;
+
+    CACBudgetGovernor();
+    CACBudgetGovernor(const CACBudgetGovernor &) = delete;
+    CACBudgetGovernor &operator=(const CACBudgetGovernor &) = delete;
+
+    double EstimateCost(const Client &client, int level) const;
+    double Coverage(int level) const;
+    void Rebalance();
+
+public:
+    static CACBudgetGovernor &Instance();
+
+    std::shared_ptr<Client> Register();
+    // Node-wide, every camera should be given the same values
+    void Configure(double budgetMs, double intervalMs);
+    const QualityLevel &GetQualityLevel(int level) const { return m_vLevels[level]; }
+    // Called once per frame; rebalances when the interval has passed
+    void Report(Client &client, const Sample &sample);
+    Stats GetStats();
+};
+
+#endif // BUDGET_GOVERNOR_H
@@ -0,0 +1,307 @@
+#include "DetectorPool.h"
+#include <iostream>
+
+CACDetectorPool::CACDetectorPool()
+{
+    m_bStopping = false;
+    m_nPending = 0;
+    m_tStart = std::chrono::steady_clock::now();
+    m_nOptimizedPrecision = -1;
+    m_bWarmedUp = false;
+}
+
+CACDetectorPool::~CACDetectorPool()
+{
+    Shutdown();
+}
+
+bool CACDetectorPool::Initialize(int size, const Loader &loader)
+{
+    Shutdown();
+    m_bStopping = false;
+    m_nPending = 0;
+    m_tStart = std::chrono::steady_clock::now();
+
+    size = (std::max)(1, size);
+    std::vector<std::future<bool>> loaded;
+    for (int i = 0; i < size; ++i)
+    {
+        m_vWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (int i = 0; i < size; ++i)
+    {
+        std::promise<bool> promise;
+        loaded.push_back(promise.get_future());
+        m_vWorkers[i]->thread = std::thread(&CACDetectorPool::WorkerLoop, this, (size_t)i, loader, std::move(promise));
+    }
+
+    bool result = true;
+    for (auto &future : loaded)
+    {
+        result = future.get() && result;
+    }
+    if (!result)
+    {
+        std::cerr << "Detector pool: failed to load one or more detector handles" << std::endl;
+        Shutdown();
+    }
+    return result;
+}
+
+void CACDetectorPool::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_cWakeMutex);
+        m_bStopping = true;
+    }
+    m_cWakeCondition.notify_all();
+    for (auto &worker : m_vWorkers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+    m_vWorkers.clear();
+}
+
+bool CACDetectorPool::PopLocal(size_t index, Task &task)
+{
+    Worker &worker = *m_vWorkers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.pinned.empty())
+    {
+        task = std::move(worker.pinned.front());
+        worker.pinned.pop_front();
+        worker.pinnedCount--;
+        return true;
+    }
+    if (worker.queue.empty())
+    {
+        return false;
+    }
+    task = std::move(worker.queue.front());
+    worker.queue.pop_front();
+    m_nPending--;
+    return true;
+}
+
+bool CACDetectorPool::Steal(size_t index, Task &task)
+{
+    // Start with the next worker so thieves do not all hit worker 0
+    for (size_t offset = 1; offset < m_vWorkers.size(); ++offset)
+    {
+        Worker &victim = *m_vWorkers[(index + offset) % m_vWorkers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty())
+        {
+            task = std::move(victim.queue.back());
+            victim.queue.pop_back();
+            m_nPending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CACDetectorPool::WorkerLoop(size_t index, Loader loader, std::promise<bool> loaded)
+{
+    Worker &worker = *m_vWorkers[index];
+
+    // The handle lives on this thread for its whole life
+    bool loadResult = false;
+    try
+    {
+        std::string labelMap;
+        worker.detector.reset(new ANSCENTER::ANSLIB());
+        loadResult = loader(*worker.detector, labelMap);
+        if (loadResult)
+        {
+            std::lock_guard<std::mutex> lock(m_cInfoMutex);
+            m_sLabelMap = labelMap;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Detector pool: worker " << index << " failed to load: " << e.what() << std::endl;
+        loadResult = false;
+    }
+    loaded.set_value(loadResult);
+
+    while (true)
+    {
+        Task task;
+        bool local = PopLocal(index, task);
+        if (local || Steal(index, task))
+        {
+            auto start = std::chrono::steady_clock::now();
+            task(*worker.detector);
+            auto end = std::chrono::steady_clock::now();
+
+            worker.busyUs += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            worker.jobsDone++;
+            if (!local)
+            {
+                worker.jobsStolen++;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_cWakeMutex);
+        m_cWakeCondition.wait(lock, [this, &worker]
+                              { return m_bStopping || m_nPending > 0 || worker.pinnedCount > 0; });
+        if (m_bStopping && m_nPending == 0 && worker.pinnedCount == 0)
+        {
+            break;
+        }
+    }
+
+    worker.detector.reset();
+}
+
+std::future<void> CACDetectorPool::Submit(const std::string &affinityKey, Job job)
+{
+    Task task([job](ANSCENTER::ANSLIB &detector)
+              { job(detector); });
+    std::future<void> future = task.get_future();
+    if (m_vWorkers.empty())
+    {
+        throw std::runtime_error("Detector pool is not initialized");
+    }
+
+    {
+        Worker &worker = *m_vWorkers[GetWorkerIndex(affinityKey)];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queue.push_back(std::move(task));
+        m_nPending++;
+    }
+    {
+        // Taking the wake mutex orders the increment before a worker's predicate check
+        std::lock_guard<std::mutex> lock(m_cWakeMutex);
+    }
+    m_cWakeCondition.notify_all();
+    return future;
+}
+
+std::future<void> CACDetectorPool::SubmitPinned(size_t workerIndex, Job job)
+{
+    Task task([job](ANSCENTER::ANSLIB &detector)
+              { job(detector); });
+    std::future<void> future = task.get_future();
+    if (workerIndex >= m_vWorkers.size())
+    {
+        throw std::runtime_error("Detector pool worker index out of range");
+    }
+
+    {
+        Worker &worker = *m_vWorkers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.pinned.push_back(std::move(task));
+        worker.pinnedCount++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_cWakeMutex);
+    }
+    m_cWakeCondition.notify_all();
+    return future;
+}
+
+size_t CACDetectorPool::GetWorkerIndex(const std::string &affinityKey) const
+{
+    return m_vWorkers.empty() ? 0 : std::hash<std::string>()(affinityKey) % m_vWorkers.size();
+}
+
+int CACDetectorPool::RunInference(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results)
+{
+    int result = 0;
+    std::future<void> done = SubmitPinned(GetWorkerIndex(cameraId), [&](ANSCENTER::ANSLIB &detector)
+                                          { result = detector.RunInference(image, cameraId.c_str(), results); });
+    done.get();
+    return result;
+}
+
+bool CACDetectorPool::ForEachHandle(const std::function<bool(ANSCENTER::ANSLIB &)> &job)
+{
+    std::vector<std::future<void>> done;
+    std::vector<char> results(m_vWorkers.size(), 0);
+    for (size_t i = 0; i < m_vWorkers.size(); ++i)
+    {
+        char *result = &results[i];
+        done.push_back(SubmitPinned(i, [result, &job](ANSCENTER::ANSLIB &detector)
+                                    { *result = job(detector) ? 1 : 0; }));
+    }
+    for (auto &future : done)
+    {
+        future.get();
+    }
+
+    bool allDone = true;
+    for (char result : results)
+    {
+        allDone = allDone && (result != 0);
+    }
+    return allDone;
+}
+
+bool CACDetectorPool::Optimize(bool fp16)
+{
+    std::lock_guard<std::mutex> lock(m_cInfoMutex);
+    int precision = fp16 ? 1 : 0;
+    if (m_nOptimizedPrecision == precision)
+    {
+        return true;
+    }
+    bool result = ForEachHandle([fp16](ANSCENTER::ANSLIB &detector)
+                                { return detector.Optimize(fp16) == 1; });
+    if (result)
+    {
+        m_nOptimizedPrecision = precision;
+    }
+    return result;
+}
+
+bool CACDetectorPool::WarmUp(const cv::Mat &frame)
+{
+    std::lock_guard<std::mutex> lock(m_cInfoMutex);
+    if (m_bWarmedUp)
+    {
+        return true;
+    }
+    bool result = ForEachHandle([&frame](ANSCENTER::ANSLIB &detector)
+                                {
+                                    std::vector<ANSCENTER::Object> results;
+                                    detector.RunInference(frame, "warmup", results);
+                                    return true;
+                                });
+    if (result)
+    {
+        m_bWarmedUp = true;
+    }
+    return result;
+}
+
+std::string CACDetectorPool::GetLabelMap()
+{
+    std::lock_guard<std::mutex> lock(m_cInfoMutex);
+    return m_sLabelMap;
+}
+
+std::vector<CACDetectorPool::WorkerStats> CACDetectorPool::GetStats() const
+{
+    std::vector<WorkerStats> stats;
+    double lifetimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_tStart).count();
+    for (const auto &worker : m_vWorkers)
+    {
+        WorkerStats workerStats;
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            workerStats.queueDepth = (int)(worker->queue.size() + worker->pinned.size());
+        }
+        workerStats.jobsDone = worker->jobsDone;
+        workerStats.jobsStolen = worker->jobsStolen;
+        workerStats.busyMs = worker->busyUs / 1000.0;
+        workerStats.utilisation = (lifetimeMs > 0.0) ? workerStats.busyMs / lifetimeMs : 0.0;
+        stats.push_back(workerStats);
+    }
+    return stats;
+}
@@ -0,0 +1,96 @@
+#ifndef DETECTOR_POOL_H
+#define DETECTOR_POOL_H
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Pool of detector handles for one model. Every handle is created, loaded and used by its own
+// worker thread only. ANSLIB keeps tracker state per handle and camera id, so inference for a
+// camera is pinned to the worker its id hashes to and track ids stay stable. Stateless jobs are
+// queued on the worker chosen by their affinity key and idle workers steal them from the back of
+// the other queues, so that work spreads over all handles when the load is uneven.
+class CACDetectorPool
+{
+public:
+    // Loads the model into a fresh handle and reports the model's label map
+    typedef std::function<bool(ANSCENTER::ANSLIB &, std::string &)> Loader;
+    typedef std::function<void(ANSCENTER::ANSLIB &)> Job;
+
+    struct WorkerStats
+    {
+        int queueDepth{0};
+        long long jobsDone{0};
+        long long jobsStolen{0};
+        double busyMs{0.0};
+        double utilisation{0.0}; // busyMs over the worker lifetime
+    };
+
+private:
+    typedef std::packaged_task<void(ANSCENTER::ANSLIB &)> Task;
+
+    struct Worker
+    {
+        std::unique_ptr<ANSCENTER::ANSLIB> detector;
+        std::deque<Task> queue;  // Stealable work
+        std::deque<Task> pinned; // Work that must run on this worker's handle
+        std::atomic<int> pinnedCount{0};
+        std::mutex mutex;
+        std::thread thread;
+        std::atomic<long long> jobsDone{0};
+        std::atomic<long long> jobsStolen{0};
+        std::atomic<long long> busyUs{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_vWorkers;
+    std::mutex m_cWakeMutex;
+    std::condition_variable m_cWakeCondition;
+    std::atomic<bool> m_bStopping;
+    std::atomic<int> m_nPending;
+    std::chrono::steady_clock::time_point m_tStart;
+    std::mutex m_cInfoMutex;
+    std::string m_sLabelMap;
+    int m_nOptimizedPrecision; // -1: not optimised, 0: fp32, 1: fp16
+    bool m_bWarmedUp;
+
+    bool PopLocal(size_t index, Task &task);
+    bool Steal(size_t index, Task &task);
+    void WorkerLoop(size_t index, Loader loader, std::promise<bool> loaded);
+
+public:
+    CACDetectorPool();
+    ~CACDetectorPool();
+
+    // Start size workers; each one creates its handle and runs the loader on it
+    bool Initialize(int size, const Loader &loader);
+    void Shutdown();
+    int GetSize() const { return (int)m_vWorkers.size(); }
+
+    // Stealable: only for jobs that leave no per-camera state in the handle
+    std::future<void> Submit(const std::string &affinityKey, Job job);
+    std::future<void> SubmitPinned(size_t workerIndex, Job job);
+    size_t GetWorkerIndex(const std::string &affinityKey) const;
+    // Pinned to the camera's worker, whose handle holds the camera's tracks
+    int RunInference(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results);
+    // Run the job once on every handle, e.g. to optimise all of them
+    bool ForEachHandle(const std::function<bool(ANSCENTER::ANSLIB &)> &job);
+    // Optimise every handle; a pool shared by several cameras is only optimised once per precision
+    bool Optimize(bool fp16);
+    // Run one inference on every handle so the first real frame does not pay for lazy allocations
+    bool WarmUp(const cv::Mat &frame);
+    std::string GetLabelMap();
+
+    std::vector<WorkerStats> GetStats() const;
+};
+
+#endif // DETECTOR_POOL_H
@@ -0,0 +1,335 @@
+#include "EngineCache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// The manifest is shared by the vehicle and light detectors, which may initialise concurrently
+static std::mutex g_manifestMutex;
+
+static const char *MANIFEST_NAME = "engine_cache.txt";
+
+static bool IsModelSourceFile(const std::filesystem::path &path, const std::string &modelName)
+{
+    // Only the files the engine is built from; engines written by ANSLIB must not change the hash
+    static const char *EXTENSIONS[] = {".onnx", ".xml", ".bin", ".names", ".zip", ".pt", ".weights", ".cfg"};
+    // Exact stem: the rung models (<modelName>_<side>) and other models sharing a prefix are not this one
+    if (path.stem().string() != modelName)
+    {
+        return false;
+    }
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const char *known : EXTENSIONS)
+    {
+        if (extension == known)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsModelOutputFile(const std::string &relativePath, const std::string &modelName)
+{
+    // Files named after the model (<modelName>.engine, <modelName>.fp16.engine, ...) or under a
+    // directory of that name. The other detectors optimise into the same directory at the same time.
+    size_t separator = relativePath.find('/');
+    if (separator != std::string::npos)
+    {
+        return relativePath.compare(0, separator, modelName) == 0 && separator == modelName.size();
+    }
+    return relativePath.compare(0, modelName.size(), modelName) == 0 &&
+           relativePath.size() > modelName.size() && relativePath[modelName.size()] == '.';
+}
+
+std::string CACEngineCache::ComputeModelHash(const std::string &modelDirectory, const std::string &modelName)
+{
+    const unsigned long long FNV_OFFSET = 1469598103934665603ULL;
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+    unsigned long long hash = FNV_OFFSET;
+    auto mix = [&hash, FNV_PRIME](const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= FNV_PRIME;
+        }
+    };
+
+    try
+    {
+        std::vector<std::filesystem::path> files;
+        for (const auto &entry : std::filesystem::directory_iterator(modelDirectory))
+        {
+            if (entry.is_regular_file() && IsModelSourceFile(entry.path(), modelName))
+            {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        std::vector<char> buffer(1 << 20);
+        for (const auto &file : files)
+        {
+            std::string fileName = file.filename().string();
+            mix(fileName.data(), fileName.size());
+
+            std::ifstream stream(file, std::ios::binary);
+            while (stream)
+            {
+                stream.read(buffer.data(), buffer.size());
+                mix(buffer.data(), (size_t)stream.gcount());
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Engine cache: cannot hash model " << modelName << ": " << e.what() << std::endl;
+        return "";
+    }
+
+    std::ostringstream text;
+    text << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return text.str();
+}
+
+static std::string HashText(const std::string &text)
+{
+    unsigned long long hash = 1469598103934665603ULL;
+    for (unsigned char ch : text)
+    {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream result;
+    result << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return result.str();
+}
+
+std::string CACEngineCache::GetBuildFingerprint(int engineType)
+{
+    // An engine is only valid for the GPU and driver it was built with
+    std::ostringstream device;
+    device << "engine " << engineType << "\n";
+#ifdef _WIN32
+    DISPLAY_DEVICEA display;
+    display.cb = sizeof(display);
+    for (DWORD i = 0; EnumDisplayDevicesA(nullptr, i, &display, 0); ++i)
+    {
+        device << display.DeviceString << "\n";
+        // DeviceKey is \Registry\Machine\<subkey> of the adapter's driver settings
+        std::string key = display.DeviceKey;
+        const std::string prefix = "\\Registry\\Machine\\";
+        if (key.size() > prefix.size() && _strnicmp(key.c_str(), prefix.c_str(), prefix.size()) == 0)
+        {
+            char version[128] = {0};
+            DWORD size = sizeof(version);
+            if (RegGetValueA(HKEY_LOCAL_MACHINE, key.substr(prefix.size()).c_str(), "DriverVersion", RRF_RT_REG_SZ, nullptr, version, &size) == ERROR_SUCCESS)
+            {
+                device << version << "\n";
+            }
+        }
+        display.cb = sizeof(display);
+    }
+#else
+    std::ifstream version("/proc/driver/nvidia/version");
+    std::string line;
+    if (std::getline(version, line))
+    {
+        device << line << "\n";
+    }
+    try
+    {
+        std::vector<std::filesystem::path> gpus;
+        for (const auto &entry : std::filesystem::directory_iterator("/proc/driver/nvidia/gpus"))
+        {
+            gpus.push_back(entry.path() / "information");
+        }
+        std::sort(gpus.begin(), gpus.end());
+        for (const auto &gpu : gpus)
+        {
+            std::ifstream information(gpu);
+            while (std::getline(information, line))
+            {
+                if (line.compare(0, 6, "Model:") == 0)
+                {
+                    device << line << "\n";
+                }
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        // No NVIDIA driver, the engine type and driver line are all there is
+    }
+#endif
+    return HashText(device.str());
+}
+
+CACEngineCache::Snapshot CACEngineCache::TakeSnapshot(const std::string &modelDirectory)
+{
+    Snapshot files;
+    try
+    {
+        std::filesystem::path root(modelDirectory);
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+        {
+            if (!entry.is_regular_file() || entry.path().filename() == MANIFEST_NAME)
+            {
+                continue;
+            }
+            files[std::filesystem::relative(entry.path(), root).generic_string()] =
+                std::make_pair((unsigned long long)entry.file_size(), (long long)entry.last_write_time().time_since_epoch().count());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Engine cache: cannot list " << modelDirectory << ": " << e.what() << std::endl;
+    }
+    return files;
+}
+
+namespace
+{
+    // One manifest line: name precision hash fingerprint count, then count times "file" size time
+    struct ManifestEntry
+    {
+        std::string name;
+        std::string precision;
+        std::string hash;
+        std::string fingerprint;
+        CACEngineCache::Snapshot files;
+    };
+
+    std::vector<ManifestEntry> ReadManifest(const std::filesystem::path &path)
+    {
+        std::vector<ManifestEntry> entries;
+        std::ifstream manifest(path);
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            std::istringstream fields(line);
+            ManifestEntry entry;
+            size_t count = 0;
+            if (!(fields >> entry.name >> entry.precision >> entry.hash >> entry.fingerprint >> count))
+            {
+                // Entries written before the engine files were recorded are rebuilt
+                continue;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                std::string file;
+                unsigned long long size = 0;
+                long long time = 0;
+                if (fields >> std::quoted(file) >> size >> time)
+                {
+                    entry.files[file] = std::make_pair(size, time);
+                }
+            }
+            if (entry.files.size() == count)
+            {
+                entries.push_back(entry);
+            }
+        }
+        return entries;
+    }
+}
+
+bool CACEngineCache::IsOptimized(const std::string &modelDirectory, const std::string &modelName, const std::string &modelHash,
+                                 const std::string &precision, const std::string &fingerprint)
+{
+    if (modelHash.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_manifestMutex);
+    std::filesystem::path root(modelDirectory);
+    for (const auto &entry : ReadManifest(root / MANIFEST_NAME))
+    {
+        if (entry.name != modelName || entry.precision != precision)
+        {
+            continue;
+        }
+        if (entry.hash != modelHash || entry.fingerprint != fingerprint || entry.files.empty())
+        {
+            return false;
+        }
+        // The engine itself must still be there as it was written
+        for (const auto &file : entry.files)
+        {
+            std::error_code error;
+            std::filesystem::path path = root / file.first;
+            unsigned long long size = std::filesystem::file_size(path, error);
+            if (error || size != file.second.first)
+            {
+                return false;
+            }
+            long long time = (long long)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+            if (error || time != file.second.second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CACEngineCache::MarkOptimized(const std::string &modelDirectory, const std::string &modelName, const std::string &modelHash,
+                                   const std::string &precision, const std::string &fingerprint, const Snapshot &before)
+{
+    if (modelHash.empty())
+    {
+        return false;
+    }
+
+    Snapshot written;
+    for (const auto &file : TakeSnapshot(modelDirectory))
+    {
+        auto previous = before.find(file.first);
+        if ((previous == before.end() || previous->second != file.second) && IsModelOutputFile(file.first, modelName))
+        {
+            written.insert(file);
+        }
+    }
+    if (written.empty())
+    {
+        std::cerr << "Engine cache: optimising " << modelName << " wrote no files, not cached" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_manifestMutex);
+    std::filesystem::path manifestPath = std::filesystem::path(modelDirectory) / MANIFEST_NAME;
+
+    // Keep the other entries, replace the one for this model and precision
+    std::vector<ManifestEntry> entries;
+    for (const auto &entry : ReadManifest(manifestPath))
+    {
+        if (!(entry.name == modelName && entry.precision == precision))
+        {
+            entries.push_back(entry);
+        }
+    }
+    entries.push_back({modelName, precision, modelHash, fingerprint, written});
+
+    std::ofstream manifest(manifestPath, std::ios::trunc);
+    for (const auto &entry : entries)
+    {
+        manifest << entry.name << " " << entry.precision << " " << entry.hash << " " << entry.fingerprint << " " << entry.files.size();
+        for (const auto &file : entry.files)
+        {
+            manifest << " " << std::quoted(file.first) << " " << file.second.first << " " << file.second.second;
+        }
+        manifest << "\n";
+    }
+    return (bool)manifest;
+}
@@ -0,0 +1,44 @@
+#ifndef ENGINE_CACHE_H
+#define ENGINE_CACHE_H
+#pragma once
+#include <string>
+#include <map>
+
+// Startup cost of one detector, reported after Initialize
+struct StartupTimings
+{
+    double loadMs{0.0};
+    double optimiseMs{0.0};
+    double warmupMs{0.0};
+    bool optimiseCached{false};
+};
+
+// Remembers on disk which engines have already been built for which model, precision and device.
+// ANSLIB writes the optimised engine into the model directory; the manifest (engine_cache.txt in
+// the model directory) records the files Optimize wrote, with their size and write time, next to
+// the hash of the model files and the build fingerprint (engine type, GPU and driver). A restarted
+// node reuses the engine only while those files are still there unchanged and the fingerprint
+// matches; a changed model, a deleted engine or a driver update rebuilds it. Only files named
+// after the model count as its engine: the detectors share the directory and optimise at once.
+class CACEngineCache
+{
+public:
+    // File (relative to the model directory) -> size and write time
+    typedef std::map<std::string, std::pair<unsigned long long, long long>> Snapshot;
+
+    // FNV-1a over the names and contents of the model's source files (<modelName>.onnx, .names, ...; stem exactly modelName).
+    // Reads every byte, callers compute it once per load.
+    static std::string ComputeModelHash(const std::string &modelDirectory, const std::string &modelName);
+    // Engine type with the GPU model and driver version of this machine, as a hash
+    static std::string GetBuildFingerprint(int engineType);
+    // Files of the model directory, taken before Optimize so MarkOptimized can tell what it wrote
+    static Snapshot TakeSnapshot(const std::string &modelDirectory);
+
+    static bool IsOptimized(const std::string &modelDirectory, const std::string &modelName, const std::string &modelHash,
+                            const std::string &precision, const std::string &fingerprint);
+    // Records the files named after the model that are new or changed since before; nothing is recorded when there are none
+    static bool MarkOptimized(const std::string &modelDirectory, const std::string &modelName, const std::string &modelHash,
+                              const std::string &precision, const std::string &fingerprint, const Snapshot &before);
+};
+
+#endif // ENGINE_CACHE_H
@@ -0,0 +1,244 @@
+#include "FlowPropagator.h"
+#include <algorithm>
+#include <cmath>
+
+static float Median(std::vector<float> &values)
+{
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    return values[middle];
+}
+
+CACFlowPropagator::CACFlowPropagator()
+{
+    m_bEnabled = false;
+    m_nMaxInterval = 4;
+    m_nPointsPerBox = 10;
+    m_fMinQuality = 0.5f;
+    m_fMaxFBError = 1.0f;
+    Reset();
+}
+
+void CACFlowPropagator::Configure(bool enabled, int maxInterval, int pointsPerBox, float minQuality)
+{
+    m_bEnabled = enabled;
+    m_nMaxInterval = (std::max)(1, maxInterval);
+    m_nPointsPerBox = (std::max)(3, pointsPerBox);
+    m_fMinQuality = (std::min)(1.0f, (std::max)(0.0f, minQuality));
+    Reset();
+}
+
+void CACFlowPropagator::Reset()
+{
+    m_nInterval = 1;
+    m_nFramesSinceKeyframe = 0;
+    m_fSegmentQuality = 1.0f;
+    m_cArea = cv::Rect();
+    m_cPrevGray.release();
+    m_vBoxes.clear();
+    m_vVelocities.clear();
+    m_stStats.interval = m_nInterval;
+}
+
+void CACFlowPropagator::ToGray(const cv::Mat &input, const cv::Rect &area, cv::Mat &gray) const
+{
+    if (input.channels() == 1)
+    {
+        input(area).copyTo(gray);
+    }
+    else
+    {
+        cv::cvtColor(input(area), gray, cv::COLOR_BGR2GRAY);
+    }
+}
+
+void CACFlowPropagator::SetKeyframe(const cv::Mat &input, const cv::Rect &area, const std::vector<ANSCENTER::Object> &boxes)
+{
+    if (!m_bEnabled || input.empty())
+    {
+        return;
+    }
+
+    cv::Rect clippedArea = area & cv::Rect(0, 0, input.cols, input.rows);
+    if (clippedArea.empty())
+    {
+        return;
+    }
+
+    // A full segment of good flow lets the next one be longer
+    if (m_nFramesSinceKeyframe + 1 >= m_nInterval && m_fSegmentQuality >= (1.0f + m_fMinQuality) / 2)
+    {
+        m_nInterval = (std::min)(m_nMaxInterval, m_nInterval + 1);
+    }
+
+    ToGray(input, clippedArea, m_cPrevGray);
+    m_cArea = clippedArea;
+    m_vBoxes = boxes;
+    m_vVelocities.assign(boxes.size(), cv::Point2f(0, 0));
+    m_nFramesSinceKeyframe = 0;
+    m_fSegmentQuality = 1.0f;
+    m_stStats.keyframes++;
+    m_stStats.interval = m_nInterval;
+}
+
+bool CACFlowPropagator::Propagate(const cv::Mat &input, const cv::Rect &area, std::vector<ANSCENTER::Object> &propagated)
+{
+    propagated.clear();
+    if (!m_bEnabled || input.empty() || m_cPrevGray.empty())
+    {
+        return false;
+    }
+
+    cv::Rect clippedArea = area & cv::Rect(0, 0, input.cols, input.rows);
+    if (clippedArea != m_cArea || m_nFramesSinceKeyframe + 1 >= m_nInterval)
+    {
+        return false;
+    }
+
+    try
+    {
+        cv::Mat gray;
+        ToGray(input, clippedArea, gray);
+        cv::Rect localArea(0, 0, clippedArea.width, clippedArea.height);
+
+        // Features inside the central part of every box, all boxes tracked in one LK call
+        std::vector<cv::Point2f> points;
+        std::vector<size_t> firstPoint(m_vBoxes.size() + 1, 0);
+        for (size_t i = 0; i < m_vBoxes.size(); ++i)
+        {
+            firstPoint[i] = points.size();
+            cv::Rect box = m_vBoxes[i].box;
+            box.x -= clippedArea.x;
+            box.y -= clippedArea.y;
+            cv::Rect inner(box.x + box.width / 10, box.y + box.height / 10, box.width * 8 / 10, box.height * 8 / 10);
+            inner &= localArea;
+            if (inner.width < 4 || inner.height < 4)
+            {
+                continue;
+            }
+
+            std::vector<cv::Point2f> boxPoints;
+            double minDistance = (std::max)(2, (std::min)(inner.width, inner.height) / 8);
+            cv::goodFeaturesToTrack(m_cPrevGray(inner), boxPoints, m_nPointsPerBox, 0.01, minDistance);
+            for (auto &pt : boxPoints)
+            {
+                points.push_back(cv::Point2f(pt.x + inner.x, pt.y + inner.y));
+            }
+        }
+        firstPoint[m_vBoxes.size()] = points.size();
+
+        std::vector<cv::Point2f> forward;
+        std::vector<cv::Point2f> backward;
+        std::vector<uchar> forwardStatus;
+        std::vector<uchar> backwardStatus;
+        std::vector<float> errors;
+        if (!points.empty())
+        {
+            cv::calcOpticalFlowPyrLK(m_cPrevGray, gray, points, forward, forwardStatus, errors);
+            cv::calcOpticalFlowPyrLK(gray, m_cPrevGray, forward, backward, backwardStatus, errors);
+        }
+
+        int trackedPoints = 0;
+        int totalPoints = 0;
+        std::vector<ANSCENTER::Object> moved;
+        std::vector<cv::Point2f> movedVelocities;
+        for (size_t i = 0; i < m_vBoxes.size(); ++i)
+        {
+            // Every box wants m_nPointsPerBox points; boxes without texture lower the quality
+            totalPoints += m_nPointsPerBox;
+
+            std::vector<cv::Point2f> from;
+            std::vector<cv::Point2f> to;
+            for (size_t p = firstPoint[i]; p < firstPoint[i + 1]; ++p)
+            {
+                float dx = backward[p].x - points[p].x;
+                float dy = backward[p].y - points[p].y;
+                if (forwardStatus[p] && backwardStatus[p] && dx * dx + dy * dy <= m_fMaxFBError * m_fMaxFBError)
+                {
+                    from.push_back(points[p]);
+                    to.push_back(forward[p]);
+                }
+            }
+            trackedPoints += (int)from.size();
+            ANSCENTER::Object obj = m_vBoxes[i];
+            obj.polygon.clear();
+            obj.extraInfo = "interpolated";
+            if (from.size() < 3)
+            {
+                // Too few points to measure: the box keeps moving as it did
+                cv::Point2f velocity = m_vVelocities[i];
+                obj.box.x += (int)std::lround(velocity.x);
+                obj.box.y += (int)std::lround(velocity.y);
+                obj.box &= cv::Rect(0, 0, input.cols, input.rows);
+                if (obj.box.area() > 0)
+                {
+                    moved.push_back(obj);
+                    movedVelocities.push_back(velocity);
+                }
+                continue;
+            }
+
+            // Median translation and median spread ratio (scale) are robust to a few bad points
+            std::vector<float> shiftX;
+            std::vector<float> shiftY;
+            cv::Point2f fromCenter(0, 0);
+            cv::Point2f toCenter(0, 0);
+            for (size_t p = 0; p < from.size(); ++p)
+            {
+                shiftX.push_back(to[p].x - from[p].x);
+                shiftY.push_back(to[p].y - from[p].y);
+                fromCenter += from[p];
+                toCenter += to[p];
+            }
+            fromCenter *= 1.0f / from.size();
+            toCenter *= 1.0f / to.size();
+
+            std::vector<float> ratios;
+            for (size_t p = 0; p < from.size(); ++p)
+            {
+                double fromDistance = cv::norm(from[p] - fromCenter);
+                if (fromDistance > 1.0)
+                {
+                    ratios.push_back((float)(cv::norm(to[p] - toCenter) / fromDistance));
+                }
+            }
+            float scale = ratios.empty() ? 1.0f : (std::min)(1.25f, (std::max)(0.8f, Median(ratios)));
+
+            cv::Point2f velocity(Median(shiftX), Median(shiftY));
+            float centerX = obj.box.x + obj.box.width / 2.0f + velocity.x;
+            float centerY = obj.box.y + obj.box.height / 2.0f + velocity.y;
+            int width = (int)std::lround(obj.box.width * scale);
+            int height = (int)std::lround(obj.box.height * scale);
+            obj.box = cv::Rect((int)std::lround(centerX - width / 2.0f), (int)std::lround(centerY - height / 2.0f), width, height);
+            obj.box &= cv::Rect(0, 0, input.cols, input.rows);
+            if (obj.box.area() > 0)
+            {
+                moved.push_back(obj);
+                movedVelocities.push_back(velocity);
+            }
+        }
+
+        float quality = totalPoints > 0 ? (float)trackedPoints / totalPoints : 1.0f;
+        m_stStats.lastQuality = quality;
+        m_fSegmentQuality = (std::min)(m_fSegmentQuality, quality);
+        if (quality < m_fMinQuality)
+        {
+            // Flow is unreliable on this scene, detect now and keyframe more often
+            m_nInterval = (std::max)(1, m_nInterval / 2);
+            m_stStats.interval = m_nInterval;
+            return false;
+        }
+
+        m_cPrevGray = gray;
+        m_vBoxes = moved;
+        m_vVelocities = movedVelocities;
+        m_nFramesSinceKeyframe++;
+        m_stStats.propagated++;
+        propagated = moved;
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef FLOW_PROPAGATOR_H
+#define FLOW_PROPAGATOR_H
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Moves the last detected vehicle boxes with pyramidal Lucas-Kanade flow between keyframes, so the
+// vehicle model only runs every k-th frame. Features are taken inside each box and flow is computed
+// on the DetectArea only. k grows while the flow is reliable and is halved when it is not. A box
+// that loses its points (occlusion, no texture) coasts on its last velocity until the next keyframe.
+class CACFlowPropagator
+{
+public:
+    struct Stats
+    {
+        long long keyframes{0};
+        long long propagated{0};
+        int interval{1};         // Current k
+        float lastQuality{0.0f}; // Fraction of feature points that survived the forward-backward check
+    };
+
+private:
+    bool m_bEnabled;
+    int m_nMaxInterval;     // Largest k
+    int m_nPointsPerBox;    // Features tracked per box
+    float m_fMinQuality;    // Below this the propagation is dropped and the detector runs
+    float m_fMaxFBError;    // Forward-backward error, in pixels, for a point to count as tracked
+
+    int m_nInterval;
+    int m_nFramesSinceKeyframe;
+    float m_fSegmentQuality; // Worst quality since the last keyframe
+    cv::Rect m_cArea;
+    cv::Mat m_cPrevGray;
+    std::vector<ANSCENTER::Object> m_vBoxes;
+    std::vector<cv::Point2f> m_vVelocities; // Per box, pixels per frame; zero at the keyframe
+    Stats m_stStats;
+
+    void ToGray(const cv::Mat &input, const cv::Rect &area, cv::Mat &gray) const;
+
+public:
+    CACFlowPropagator();
+
+    void Configure(bool enabled, int maxInterval, int pointsPerBox, float minQuality);
+    bool IsEnabled() const { return m_bEnabled; }
+    int GetMaxInterval() const { return m_nMaxInterval; }
+    int GetPointsPerBox() const { return m_nPointsPerBox; }
+    float GetMinQuality() const { return m_fMinQuality; }
+    Stats GetStats() const { return m_stStats; }
+
+    // Propagated boxes (extraInfo = "interpolated") when this frame is not a keyframe and the flow
+    // is good enough; false means the detector has to run and SetKeyframe be called with its result
+    bool Propagate(const cv::Mat &input, const cv::Rect &area, std::vector<ANSCENTER::Object> &propagated);
+    void SetKeyframe(const cv::Mat &input, const cv::Rect &area, const std::vector<ANSCENTER::Object> &boxes);
+    void Reset();
+};
+
+#endif // FLOW_PROPAGATOR_H
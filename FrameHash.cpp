@@ -0,0 +1,280 @@
+#include "FrameHash.h"
+#include <iostream>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int PopCount(unsigned long long value)
+{
+#ifdef _MSC_VER
+    return (int)__popcnt64(value);
+#else
+    return __builtin_popcountll(value);
+#endif
+}
+
+CACFrameHash::CACFrameHash()
+{
+    m_bEnabled = false;
+    m_dFrozenAfterMs = 5000.0;
+}
+
+void CACFrameHash::Reset()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    m_mStreams.clear();
+}
+
+bool CACFrameHash::SetParameters(const CustomParams &params)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    for (const auto &param : params.handleParametersJson)
+    {
+        try
+        {
+            if (param.name == "frameHash")
+            {
+                m_bEnabled = (std::stoi(param.value) != 0);
+            }
+            else if (param.name == "streamFrozenMs")
+            {
+                m_dFrozenAfterMs = (std::max)(0.0, std::stod(param.value));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+        }
+    }
+    Reset();
+    return true;
+}
+
+std::vector<cv::Rect> CACFrameHash::ClipRegions(const cv::Mat &input, const std::vector<cv::Rect> &regions)
+{
+    cv::Rect frameRect(0, 0, input.cols, input.rows);
+    std::vector<cv::Rect> areas;
+    for (const auto &region : regions)
+    {
+        cv::Rect area = region & frameRect;
+        if (!area.empty())
+        {
+            areas.push_back(area);
+        }
+    }
+    if (areas.empty())
+    {
+        areas.push_back(frameRect);
+    }
+    return areas;
+}
+
+unsigned long long CACFrameHash::Checksum(const cv::Mat &input, const std::vector<cv::Rect> &areas)
+{
+    // FNV-1a over the raw pixels, eight bytes at a time
+    unsigned long long checksum = 1469598103934665603ULL;
+    for (const auto &area : areas)
+    {
+        size_t rowBytes = (size_t)area.width * input.elemSize();
+        for (int y = area.y; y < area.y + area.height; ++y)
+        {
+            const uchar *row = input.ptr<uchar>(y) + (size_t)area.x * input.elemSize();
+            size_t i = 0;
+            for (; i + 8 <= rowBytes; i += 8)
+            {
+                unsigned long long word;
+                std::memcpy(&word, row + i, 8);
+                checksum = (checksum ^ word) * 1099511628211ULL;
+            }
+            for (; i < rowBytes; ++i)
+            {
+                checksum = (checksum ^ row[i]) * 1099511628211ULL;
+            }
+        }
+    }
+    return checksum;
+}
+
+void CACFrameHash::ComputeHash(const cv::Mat &input, const std::vector<cv::Rect> &regions, CACFramePyramid *pyramid,
+                               std::vector<unsigned long long> &hash)
+{
+    std::vector<cv::Rect> areas = ClipRegions(input, regions);
+    hash.assign(areas.size() * HASH_WORDS, 0ULL);
+    for (size_t r = 0; r < areas.size(); ++r)
+    {
+        if (pyramid && !pyramid->Empty())
+        {
+            // Four pixels per hash cell are enough for area averaging to hide re-encoding noise
+            int level = pyramid->ChooseLevel((std::min)(areas[r].width, areas[r].height), 4 * HASH_GRID);
+            cv::resize(pyramid->GetGray(level)(pyramid->ScaleRect(areas[r], level)), m_cGray,
+                       cv::Size(HASH_GRID + 1, HASH_GRID), 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            // Shrink first (area averaging also removes most re-encoding noise), convert the thumbnail only
+            cv::resize(input(areas[r]), m_cThumbnail, cv::Size(HASH_GRID + 1, HASH_GRID), 0, 0, cv::INTER_AREA);
+            if (m_cThumbnail.channels() == 1)
+            {
+                m_cGray = m_cThumbnail;
+            }
+            else
+            {
+                cv::cvtColor(m_cThumbnail, m_cGray, cv::COLOR_BGR2GRAY);
+            }
+        }
+
+        // One bit per horizontal neighbour pair: brighter to the right or not
+        unsigned long long *words = &hash[r * HASH_WORDS];
+        for (int y = 0; y < HASH_GRID; ++y)
+        {
+            const uchar *row = m_cGray.ptr<uchar>(y);
+            for (int x = 0; x < HASH_GRID; ++x)
+            {
+                int bit = y * HASH_GRID + x;
+                if (row[x + 1] > row[x])
+                {
+                    words[bit / 64] |= (1ULL << (bit % 64));
+                }
+            }
+        }
+    }
+}
+
+int CACFrameHash::HammingDistance(const std::vector<unsigned long long> &a, const std::vector<unsigned long long> &b, size_t offset)
+{
+    int distance = 0;
+    for (size_t i = offset; i < offset + HASH_WORDS; ++i)
+    {
+        distance += PopCount(a[i] ^ b[i]);
+    }
+    return distance;
+}
+
+bool CACFrameHash::IsRepeat(const std::string &cameraId, const cv::Mat &input, const std::vector<cv::Rect> &regions, double nowMs,
+                            CACFramePyramid *pyramid)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    if (!m_bEnabled || input.empty())
+    {
+        return false;
+    }
+
+    StreamState &stream = m_mStreams[cameraId];
+    stream.stats.frames++;
+    stream.currentMs = nowMs;
+    try
+    {
+        ComputeHash(input, regions, pyramid, stream.current);
+    }
+    catch (const std::exception &e)
+    {
+        stream.current.clear();
+        return false;
+    }
+
+    // Compared with the frame the results belong to, not the previous frame, so a slow drift
+    // (dawn, clouds) cannot keep returning stale results
+    bool sameHash = !stream.reference.empty() && stream.reference.size() == stream.current.size();
+    int maxDistance = 0;
+    for (size_t offset = 0; sameHash && offset < stream.current.size(); offset += HASH_WORDS)
+    {
+        maxDistance = (std::max)(maxDistance, HammingDistance(stream.reference, stream.current, offset));
+    }
+    stream.stats.lastDistance = maxDistance;
+
+    // Only frames that hash like the cached one pay for the exact comparison. The checksum of a
+    // reference is known once it was itself taken from such a frame, so after a change the first
+    // repeat still runs the detectors.
+    stream.currentExactValid = false;
+    bool repeat = false;
+    if (sameHash && maxDistance == 0)
+    {
+        stream.currentExact = Checksum(input, ClipRegions(input, regions));
+        stream.currentExactValid = true;
+        repeat = stream.referenceExactValid && stream.currentExact == stream.referenceExact;
+    }
+
+    if (!repeat)
+    {
+        if (stream.stats.frozen)
+        {
+            std::cout << "Camera " << cameraId << ": stream resumed after " << stream.stats.frozenMs << " ms" << std::endl;
+        }
+        stream.stats.frozen = false;
+        stream.stats.frozenMs = 0.0;
+        return false;
+    }
+
+    // Every frame since the cached one was identical to it
+    stream.stats.repeats++;
+    double identicalMs = nowMs - stream.referenceMs;
+    if (identicalMs >= m_dFrozenAfterMs)
+    {
+        if (!stream.stats.frozen)
+        {
+            std::cout << "Camera " << cameraId << ": stream frozen, picture unchanged for " << identicalMs << " ms" << std::endl;
+        }
+        stream.stats.frozen = true;
+        stream.stats.frozenMs = identicalMs;
+    }
+    return true;
+}
+
+std::vector<CustomObject> CACFrameHash::GetResults(const std::string &cameraId, const cv::Size &frameSize) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    auto it = m_mStreams.find(cameraId);
+    if (it == m_mStreams.end())
+    {
+        return std::vector<CustomObject>();
+    }
+
+    std::vector<CustomObject> results = it->second.results;
+    if (it->second.stats.frozen)
+    {
+        CustomObject health;
+        health.classId = -1;
+        health.className = "stream_frozen";
+        health.confidence = 1.0f;
+        health.box = cv::Rect(0, 0, frameSize.width, frameSize.height);
+        health.extraInfo = "frozen_ms=" + std::to_string((long long)it->second.stats.frozenMs);
+        health.cameraId = cameraId;
+        results.push_back(health);
+    }
+    return results;
+}
+
+void CACFrameHash::SetResults(const std::string &cameraId, const std::vector<CustomObject> &results)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    if (!m_bEnabled)
+    {
+        return;
+    }
+
+    StreamState &stream = m_mStreams[cameraId];
+    if (stream.current.empty())
+    {
+        return;
+    }
+    stream.reference = stream.current;
+    stream.referenceMs = stream.currentMs;
+    stream.referenceExact = stream.currentExact;
+    stream.referenceExactValid = stream.currentExactValid;
+    stream.results = results;
+}
+
+bool CACFrameHash::IsFrozen(const std::string &cameraId) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    auto it = m_mStreams.find(cameraId);
+    return it != m_mStreams.end() && it->second.stats.frozen;
+}
+
+CACFrameHash::Stats CACFrameHash::GetStats(const std::string &cameraId) const
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    auto it = m_mStreams.find(cameraId);
+    return it != m_mStreams.end() ? it->second.stats : Stats();
+}
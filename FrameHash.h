@@ -0,0 +1,83 @@
+#ifndef FRAME_HASH_H
+#define FRAME_HASH_H
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include "ANSCustomData.h"
+#include "FramePyramid.h"
+
+// Per-camera detection of frames the encoder repeated while the uplink is degraded. Each analysed
+// region (DetectArea, TrafficRoi) is reduced to a 256-bit difference hash; only a frame whose hashes
+// equal those of the frame the cached results came from pays for a checksum of the regions, and
+// only a byte-identical frame gets those results back without running any detector. A static scene
+// also hashes alike, but sensor noise keeps a live camera's frames apart, so a small vehicle
+// entering or a slow change is never answered from the cache. A feed is reported as frozen once
+// it stays identical to the cached frame for m_dFrozenAfterMs.
+class CACFrameHash
+{
+public:
+    static const int HASH_GRID = 16;                          // 16x16 neighbour comparisons per region
+    static const int HASH_WORDS = HASH_GRID * HASH_GRID / 64; // 64-bit words per region
+
+    struct Stats
+    {
+        long long frames{0};
+        long long repeats{0};
+        int lastDistance{0}; // Hash bits that differ from the cached frame, largest over the regions
+        bool frozen{false};
+        double frozenMs{0.0}; // Time since the picture last changed, while frozen
+    };
+
+private:
+    struct StreamState
+    {
+        std::vector<unsigned long long> reference; // Hash of the frame the cached results belong to
+        std::vector<unsigned long long> current;
+        double referenceMs{0.0};
+        double currentMs{0.0};
+        std::vector<CustomObject> results;
+        unsigned long long referenceExact{0}; // Checksum of the cached frame's regions
+        bool referenceExactValid{false};      // Only taken for frames that hashed like their reference
+        unsigned long long currentExact{0};
+        bool currentExactValid{false};
+        Stats stats;
+    };
+
+    bool m_bEnabled;
+    double m_dFrozenAfterMs; // Repeats for this long raise the "stream_frozen" signal
+    std::map<std::string, StreamState> m_mStreams;
+    mutable std::recursive_mutex m_cMutex; // IsFrozen/GetStats are called from other threads
+    cv::Mat m_cThumbnail;
+    cv::Mat m_cGray;
+
+    void ComputeHash(const cv::Mat &input, const std::vector<cv::Rect> &regions, CACFramePyramid *pyramid,
+                     std::vector<unsigned long long> &hash);
+    static std::vector<cv::Rect> ClipRegions(const cv::Mat &input, const std::vector<cv::Rect> &regions);
+    static unsigned long long Checksum(const cv::Mat &input, const std::vector<cv::Rect> &areas);
+    static int HammingDistance(const std::vector<unsigned long long> &a, const std::vector<unsigned long long> &b, size_t offset);
+
+public:
+    CACFrameHash();
+
+    bool SetParameters(const CustomParams &params);
+    bool IsEnabled() const { return m_bEnabled; }
+
+    // True when the frame is byte-identical, on the regions, to the one the cached results were
+    // computed on. With a pyramid the thumbnails are taken from its smallest level that still has a
+    // few pixels per hash cell.
+    bool IsRepeat(const std::string &cameraId, const cv::Mat &input, const std::vector<cv::Rect> &regions, double nowMs,
+                  CACFramePyramid *pyramid = nullptr);
+    // Cached results of the camera, plus a "stream_frozen" object once the feed counts as frozen
+    std::vector<CustomObject> GetResults(const std::string &cameraId, const cv::Size &frameSize) const;
+    // Results of the frame last passed to IsRepeat; it becomes the new reference
+    void SetResults(const std::string &cameraId, const std::vector<CustomObject> &results);
+
+    bool IsFrozen(const std::string &cameraId) const;
+    Stats GetStats(const std::string &cameraId) const;
+    void Reset();
+};
+
+#endif // FRAME_HASH_H
@@ -0,0 +1,222 @@
+#include "FramePool.h"
+#include <new>
+
+namespace
+{
+    // Owner of wrapped foreign memory: runs the release callback kept in userdata
+    class CACForeignAllocator : public cv::MatAllocator
+    {
+    public:
+        cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags,
+                               cv::UMatUsageFlags usageFlags) const override
+        {
+            // Only reached through Mat::create, which goes to the Mat's allocator, the pool
+            return CACFramePool::Instance().allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        bool allocate(cv::UMatData *data, cv::AccessFlag, cv::UMatUsageFlags) const override
+        {
+            return data != nullptr;
+        }
+
+        void deallocate(cv::UMatData *data) const override
+        {
+            if (!data)
+            {
+                return;
+            }
+            std::function<void()> *release = static_cast<std::function<void()> *>(data->userdata);
+            if (release && *release)
+            {
+                (*release)();
+            }
+            delete release;
+            delete data;
+        }
+    };
+
+    CACForeignAllocator &GetForeignAllocator()
+    {
+        static CACForeignAllocator *allocator = new CACForeignAllocator();
+        return *allocator;
+    }
+}
+
+void *CACFramePool::AllocateAligned(size_t bytes)
+{
+    return ::operator new(bytes, std::align_val_t(ALIGNMENT));
+}
+
+void CACFramePool::FreeAligned(void *data)
+{
+    ::operator delete(data, std::align_val_t(ALIGNMENT));
+}
+
+CACFramePool::CACFramePool(size_t maxPooledBytes)
+{
+    m_nMaxPooledBytes = maxPooledBytes;
+}
+
+CACFramePool::~CACFramePool()
+{
+    Trim();
+}
+
+CACFramePool &CACFramePool::Instance()
+{
+    // Never destroyed: Mats released during static destruction still come back here
+    static CACFramePool *pool = new CACFramePool();
+    return *pool;
+}
+
+cv::UMatData *CACFramePool::allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag,
+                                     cv::UMatUsageFlags) const
+{
+    // Continuous layout, as cv::Mat's own allocator; caller-given steps only apply to caller memory
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; --i)
+    {
+        if (step)
+        {
+            if (data && step[i] != cv::Mat::AUTO_STEP)
+            {
+                total = step[i];
+            }
+            else
+            {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    cv::UMatData *u = new cv::UMatData(this);
+    u->size = total;
+    if (data)
+    {
+        u->data = u->origdata = static_cast<uchar *>(data);
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    size_t bytes = (std::max)((size_t)1, total);
+    void *buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_stStats.outstanding++;
+        std::vector<void *> &buffers = m_mFreeBuffers[bytes];
+        if (!buffers.empty())
+        {
+            buffer = buffers.back();
+            buffers.pop_back();
+            m_stStats.reused++;
+        }
+        else
+        {
+            m_stStats.allocated++;
+            m_stStats.pooledBytes += bytes;
+        }
+    }
+    if (!buffer)
+    {
+        buffer = AllocateAligned(bytes);
+    }
+    u->data = u->origdata = static_cast<uchar *>(buffer);
+    return u;
+}
+
+bool CACFramePool::allocate(cv::UMatData *data, cv::AccessFlag, cv::UMatUsageFlags) const
+{
+    return data != nullptr;
+}
+
+void CACFramePool::deallocate(cv::UMatData *data) const
+{
+    if (!data)
+    {
+        return;
+    }
+    if (!(data->flags & cv::UMatData::USER_ALLOCATED))
+    {
+        size_t bytes = (std::max)((size_t)1, data->size);
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_stStats.outstanding--;
+        if (m_nMaxPooledBytes > 0 && m_stStats.pooledBytes > m_nMaxPooledBytes)
+        {
+            // Over budget (frame size changed, burst of frames): give the memory back
+            m_stStats.pooledBytes -= bytes;
+            FreeAligned(data->origdata);
+        }
+        else
+        {
+            m_mFreeBuffers[bytes].push_back(data->origdata);
+        }
+        data->origdata = nullptr;
+    }
+    delete data;
+}
+
+cv::Mat CACFramePool::Acquire(int rows, int cols, int type)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_stStats.acquired++;
+    }
+    cv::Mat frame;
+    frame.allocator = this;
+    frame.create(rows, cols, type);
+    return frame;
+}
+
+void CACFramePool::Reserve(const cv::Size &size, int type, int count)
+{
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < count; ++i)
+    {
+        frames.push_back(Acquire(size, type));
+    }
+    // Released together, so the pool keeps count buffers
+}
+
+void CACFramePool::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    for (auto &entry : m_mFreeBuffers)
+    {
+        for (void *data : entry.second)
+        {
+            FreeAligned(data);
+            m_stStats.pooledBytes -= entry.first;
+        }
+        entry.second.clear();
+    }
+    m_mFreeBuffers.clear();
+}
+
+void CACFramePool::SetMaxPooledBytes(size_t maxPooledBytes)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    m_nMaxPooledBytes = maxPooledBytes;
+}
+
+CACFramePool::Stats CACFramePool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    return m_stStats;
+}
+
+cv::Mat CACFramePool::Wrap(void *data, const cv::Size &size, int type, size_t step, std::function<void()> release)
+{
+    // A header over the memory plus a reference-counted owner that runs release, so copies of the
+    // Mat keep the memory alive like any owning Mat
+    cv::Mat frame(size.height, size.width, type, data, step == 0 ? cv::Mat::AUTO_STEP : step);
+    cv::UMatData *u = new cv::UMatData(&GetForeignAllocator());
+    u->data = u->origdata = static_cast<uchar *>(data);
+    u->size = frame.step[0] * (size_t)size.height;
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+    u->userdata = new std::function<void()>(std::move(release));
+    u->refcount = 1;
+    frame.u = u;
+    frame.allocator = &Instance();
+    return frame;
+}
@@ -0,0 +1,66 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+#pragma once
+#include <map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <opencv2/opencv.hpp>
+
+// Pool of 64-byte aligned frame buffers, used as the cv::MatAllocator of the Mats it hands out.
+// The Mats own their pixels like any other: shallow copies keep the buffer alive, and when the last
+// one goes away the buffer returns to the pool instead of being freed, so a steady stream of
+// same-sized frames allocates nothing. A pooled Mat that is created again at another size (create,
+// copyTo, a cv function writing into it) reallocates through the pool too. A pool must outlive the
+// Mats it allocated; Instance() is never destroyed. Foreign memory (decoder surfaces, mapped
+// files) can be wrapped with a release callback, without copying.
+class CACFramePool : public cv::MatAllocator
+{
+public:
+    struct Stats
+    {
+        long long acquired{0};
+        long long reused{0};      // Served from the free list
+        long long allocated{0};   // New buffers
+        long long outstanding{0}; // Buffers currently handed out
+        size_t pooledBytes{0};    // Bytes held by the pool, free or handed out
+    };
+
+private:
+    static const size_t ALIGNMENT = 64;
+
+    mutable std::mutex m_cMutex;
+    mutable std::map<size_t, std::vector<void *>> m_mFreeBuffers; // By byte size
+    size_t m_nMaxPooledBytes;
+    mutable Stats m_stStats;
+
+    static void *AllocateAligned(size_t bytes);
+    static void FreeAligned(void *data);
+
+public:
+    // maxPooledBytes caps the memory kept by the pool; 0 means no cap
+    explicit CACFramePool(size_t maxPooledBytes = 0);
+    ~CACFramePool();
+
+    static CACFramePool &Instance();
+
+    cv::Mat Acquire(int rows, int cols, int type);
+    cv::Mat Acquire(const cv::Size &size, int type) { return Acquire(size.height, size.width, type); }
+    // Pre-allocate count buffers of this shape so the first frames do not allocate either
+    void Reserve(const cv::Size &size, int type, int count);
+    void Trim(); // Free every buffer that is not handed out
+    void SetMaxPooledBytes(size_t maxPooledBytes);
+    Stats GetStats() const;
+
+    // Mat over foreign memory; release is called once the last reference is gone. Reallocating it
+    // (another size) moves it into the pool and releases the foreign memory.
+    static cv::Mat Wrap(void *data, const cv::Size &size, int type, size_t step, std::function<void()> release);
+
+    // cv::MatAllocator
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData *data) const override;
+};
+
+#endif // FRAME_POOL_H
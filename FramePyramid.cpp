@@ -0,0 +1,98 @@
+#include "FramePyramid.h"
+#include <cmath>
+
+CACFramePyramid::CACFramePyramid()
+{
+    m_nFrameId = 0;
+    for (int i = 0; i < MAX_LEVELS; ++i)
+    {
+        m_vLevelReady[i] = false;
+        m_vGrayReady[i] = false;
+    }
+}
+
+void CACFramePyramid::SetFrame(const cv::Mat &input)
+{
+    m_vLevels[0] = input;
+    m_vLevelReady[0] = true;
+    for (int i = 1; i < MAX_LEVELS; ++i)
+    {
+        m_vLevelReady[i] = false;
+    }
+    for (int i = 0; i < MAX_LEVELS; ++i)
+    {
+        m_vGrayReady[i] = false;
+    }
+    m_nFrameId++;
+}
+
+void CACFramePyramid::Release()
+{
+    if (m_vGray[0].data == m_vLevels[0].data)
+    {
+        m_vGray[0].release();
+    }
+    m_vLevels[0].release();
+    for (int i = 0; i < MAX_LEVELS; ++i)
+    {
+        m_vLevelReady[i] = false;
+        m_vGrayReady[i] = false;
+    }
+}
+
+const cv::Mat &CACFramePyramid::GetLevel(int level)
+{
+    level = (std::max)(0, (std::min)(MAX_LEVELS - 1, level));
+    if (!m_vLevelReady[level])
+    {
+        // Built from the level above; resize reuses the buffer when the frame size is unchanged
+        const cv::Mat &parent = GetLevel(level - 1);
+        cv::Size size((parent.cols + 1) / 2, (parent.rows + 1) / 2);
+        cv::resize(parent, m_vLevels[level], size, 0, 0, cv::INTER_AREA);
+        m_vLevelReady[level] = true;
+    }
+    return m_vLevels[level];
+}
+
+const cv::Mat &CACFramePyramid::GetGray(int level)
+{
+    level = (std::max)(0, (std::min)(MAX_LEVELS - 1, level));
+    if (!m_vGrayReady[level])
+    {
+        const cv::Mat &color = GetLevel(level);
+        if (color.channels() == 1)
+        {
+            m_vGray[level] = color;
+        }
+        else
+        {
+            cv::cvtColor(color, m_vGray[level], cv::COLOR_BGR2GRAY);
+        }
+        m_vGrayReady[level] = true;
+    }
+    return m_vGray[level];
+}
+
+int CACFramePyramid::ChooseLevel(int fullSide, int minSide) const
+{
+    int level = 0;
+    while (level + 1 < MAX_LEVELS && (fullSide >> (level + 1)) >= minSide)
+    {
+        level++;
+    }
+    return level;
+}
+
+cv::Rect CACFramePyramid::ScaleRect(const cv::Rect &rect, int level) const
+{
+    int x0 = rect.x >> level;
+    int y0 = rect.y >> level;
+    int x1 = (rect.x + rect.width + (1 << level) - 1) >> level;
+    int y1 = (rect.y + rect.height + (1 << level) - 1) >> level;
+    cv::Size size = m_vLevels[0].size();
+    for (int i = 0; i < level; ++i)
+    {
+        size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+    }
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0) & cv::Rect(0, 0, size.width, size.height);
+}
@@ -0,0 +1,43 @@
+#ifndef FRAME_PYRAMID_H
+#define FRAME_PYRAMID_H
+#pragma once
+#include <opencv2/opencv.hpp>
+
+// Per-frame image pyramid shared by every consumer of the frame (motion gate, frame hash,
+// vehicle detector input). Level 0 is the input itself; each further level halves the previous
+// one with area averaging. Levels and their grayscale versions are built on first use and kept in
+// buffers that are reused from frame to frame, so each conversion happens at most once per frame.
+class CACFramePyramid
+{
+public:
+    static const int MAX_LEVELS = 5;
+
+private:
+    cv::Mat m_vLevels[MAX_LEVELS];
+    cv::Mat m_vGray[MAX_LEVELS];
+    bool m_vLevelReady[MAX_LEVELS];
+    bool m_vGrayReady[MAX_LEVELS];
+    long long m_nFrameId;
+
+public:
+    CACFramePyramid();
+
+    // Start a new frame; no pixels are copied or converted here
+    void SetFrame(const cv::Mat &input);
+    // End of the frame: level 0 (and its gray version for gray input) is the caller's image and is
+    // let go; the buffers of the other levels are kept for the next frame
+    void Release();
+    long long GetFrameId() const { return m_nFrameId; }
+    bool Empty() const { return m_vLevels[0].empty(); }
+
+    const cv::Mat &GetLevel(int level);
+    const cv::Mat &GetGray(int level);
+    double GetScale(int level) const { return 1.0 / (1 << level); }
+
+    // Deepest level at which a length of fullSide pixels (level 0) is still at least minSide
+    int ChooseLevel(int fullSide, int minSide) const;
+    // Level-0 rectangle in the coordinates of the level, clipped to it
+    cv::Rect ScaleRect(const cv::Rect &rect, int level) const;
+};
+
+#endif // FRAME_PYRAMID_H
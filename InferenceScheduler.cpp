@@ -0,0 +1,85 @@
+#include "InferenceScheduler.h"
+#include <iostream>
+
+CACInferenceScheduler::CACInferenceScheduler()
+{
+    m_vVehicleStride[LIGHT_UNKNOWN] = 1;
+    m_vVehicleStride[LIGHT_GREEN] = 1;
+    m_vVehicleStride[LIGHT_YELLOW] = 1;
+    m_vVehicleStride[LIGHT_RED] = 1;
+    Reset();
+}
+
+void CACInferenceScheduler::Reset()
+{
+    // Make the first frame always run
+    m_nFramesSinceVehicleRun = (1 << 30);
+    m_eLastState = LIGHT_UNKNOWN;
+    m_stStats = Stats();
+}
+
+bool CACInferenceScheduler::SetParameters(const CustomParams &params)
+{
+    for (const auto &param : params.handleParametersJson)
+    {
+        try
+        {
+            if (param.name == "vehicleStrideUnknown")
+            {
+                SetVehicleStride(LIGHT_UNKNOWN, std::stoi(param.value));
+            }
+            else if (param.name == "vehicleStrideGreen")
+            {
+                SetVehicleStride(LIGHT_GREEN, std::stoi(param.value));
+            }
+            else if (param.name == "vehicleStrideYellow")
+            {
+                SetVehicleStride(LIGHT_YELLOW, std::stoi(param.value));
+            }
+            else if (param.name == "vehicleStrideRed")
+            {
+                SetVehicleStride(LIGHT_RED, std::stoi(param.value));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+        }
+    }
+    return true;
+}
+
+void CACInferenceScheduler::SetVehicleStride(TrafficLightState state, int stride)
+{
+    if (state >= LIGHT_UNKNOWN && state < LIGHT_STATE_COUNT)
+    {
+        m_vVehicleStride[state] = (std::max)(1, stride);
+    }
+}
+
+int CACInferenceScheduler::GetVehicleStride(TrafficLightState state) const
+{
+    if (state >= LIGHT_UNKNOWN && state < LIGHT_STATE_COUNT)
+    {
+        return m_vVehicleStride[state];
+    }
+    return 1;
+}
+
+bool CACInferenceScheduler::ShouldRunVehicles(TrafficLightState state)
+{
+    m_stStats.frames[state]++;
+    m_nFramesSinceVehicleRun++;
+
+    // Switching to a state with a shorter stride (e.g. green -> yellow) must not wait for the old stride
+    bool stateTightened = (state != m_eLastState) && (GetVehicleStride(state) < GetVehicleStride(m_eLastState));
+    m_eLastState = state;
+
+    if (stateTightened || m_nFramesSinceVehicleRun >= GetVehicleStride(state))
+    {
+        m_nFramesSinceVehicleRun = 0;
+        m_stStats.vehicleRuns[state]++;
+        return true;
+    }
+    return false;
+}
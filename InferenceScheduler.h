@@ -0,0 +1,43 @@
+#ifndef INFERENCE_SCHEDULER_H
+#define INFERENCE_SCHEDULER_H
+#pragma once
+#include <string>
+#include <vector>
+#include "ANSCustomData.h"
+#include "TrafficLight.h"
+
+// Decides per frame whether the vehicle detector runs, based on the current light state.
+// Each state has its own stride (1 = every frame); violations only matter on yellow/red,
+// so green phases can run at a fraction of the rate. Leaving green always runs immediately.
+// Every stride defaults to 1: tracking, counts and queues still want every frame on green, so a
+// higher green stride is left to cameras that only report violations.
+class CACInferenceScheduler
+{
+public:
+    static const int LIGHT_STATE_COUNT = 4;
+
+    struct Stats
+    {
+        long long frames[LIGHT_STATE_COUNT]{};
+        long long vehicleRuns[LIGHT_STATE_COUNT]{};
+    };
+
+private:
+    int m_vVehicleStride[LIGHT_STATE_COUNT];
+    int m_nFramesSinceVehicleRun;
+    TrafficLightState m_eLastState;
+    Stats m_stStats;
+
+public:
+    CACInferenceScheduler();
+
+    bool SetParameters(const CustomParams &params);
+    void SetVehicleStride(TrafficLightState state, int stride);
+    int GetVehicleStride(TrafficLightState state) const;
+
+    bool ShouldRunVehicles(TrafficLightState state);
+    Stats GetStats() const { return m_stStats; }
+    void Reset();
+};
+
+#endif // INFERENCE_SCHEDULER_H
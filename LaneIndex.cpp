@@ -0,0 +1,236 @@
+#include "LaneIndex.h"
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include "RegionKernel.h"
+
+CACLaneIndex::CACLaneIndex()
+{
+    m_nCellSize = 64;
+    m_nCols = 0;
+    m_nRows = 0;
+}
+
+void CACLaneIndex::ParseRegionName(const std::string &regionName, std::string &baseName, int &laneId)
+{
+    baseName = regionName;
+    laneId = 0;
+
+    size_t separator = regionName.rfind('_');
+    if (separator == std::string::npos || separator + 1 >= regionName.size())
+    {
+        return;
+    }
+    for (size_t i = separator + 1; i < regionName.size(); ++i)
+    {
+        if (regionName[i] < '0' || regionName[i] > '9')
+        {
+            return;
+        }
+    }
+    baseName = regionName.substr(0, separator);
+    laneId = std::atoi(regionName.c_str() + separator + 1);
+}
+
+std::vector<CACLane> CACLaneIndex::BuildLanes(const std::vector<CustomRegion> &rois)
+{
+    std::map<int, CACLane> lanes; // Ordered by lane id
+    for (const auto &roi : rois)
+    {
+        std::string baseName;
+        int laneId = 0;
+        ParseRegionName(roi.regionName, baseName, laneId);
+
+        if (baseName == "DetectArea")
+        {
+            lanes[laneId].detectArea = roi.polygon;
+        }
+        else if (baseName == "CrossingLine")
+        {
+            lanes[laneId].crossingLine = roi.polygon;
+        }
+        else if (baseName == "Direction")
+        {
+            lanes[laneId].direction = roi.polygon;
+        }
+    }
+
+    std::vector<CACLane> result;
+    for (auto &entry : lanes)
+    {
+        if (entry.second.detectArea.size() < 3)
+        {
+            continue;
+        }
+        entry.second.laneId = entry.first;
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+void CACLaneIndex::Build(const std::vector<CACLane> &lanes, int cellSize)
+{
+    m_vLanes = lanes;
+    m_cBounds = cv::Rect();
+    m_vCellStart.clear();
+    m_vCellLanes.clear();
+    m_nCols = 0;
+    m_nRows = 0;
+    if (m_vLanes.empty())
+    {
+        return;
+    }
+
+    std::vector<cv::Rect> laneRects;
+    for (const auto &lane : m_vLanes)
+    {
+        cv::Rect laneRect = cv::boundingRect(lane.detectArea); // Includes the border points
+        laneRects.push_back(laneRect);
+        m_cBounds = m_cBounds.empty() ? laneRect : (m_cBounds | laneRect);
+    }
+
+    // Grow the cells until the grid stays small
+    m_nCellSize = (std::max)(8, cellSize);
+    while (true)
+    {
+        m_nCols = (m_cBounds.width + m_nCellSize - 1) / m_nCellSize;
+        m_nRows = (m_cBounds.height + m_nCellSize - 1) / m_nCellSize;
+        if (m_nCols * m_nRows <= MAX_CELLS)
+        {
+            break;
+        }
+        m_nCellSize *= 2;
+    }
+
+    std::vector<std::vector<int>> cells(m_nCols * m_nRows);
+    for (size_t lane = 0; lane < laneRects.size(); ++lane)
+    {
+        cv::Rect laneRect = laneRects[lane];
+        int col0 = (laneRect.x - m_cBounds.x) / m_nCellSize;
+        int row0 = (laneRect.y - m_cBounds.y) / m_nCellSize;
+        int col1 = (laneRect.x + laneRect.width - 1 - m_cBounds.x) / m_nCellSize;
+        int row1 = (laneRect.y + laneRect.height - 1 - m_cBounds.y) / m_nCellSize;
+        for (int row = row0; row <= row1; ++row)
+        {
+            for (int col = col0; col <= col1; ++col)
+            {
+                cells[row * m_nCols + col].push_back((int)lane);
+            }
+        }
+    }
+
+    m_vCellStart.reserve(cells.size() + 1);
+    for (const auto &cell : cells)
+    {
+        m_vCellStart.push_back((int)m_vCellLanes.size());
+        m_vCellLanes.insert(m_vCellLanes.end(), cell.begin(), cell.end());
+    }
+    m_vCellStart.push_back((int)m_vCellLanes.size());
+}
+
+int CACLaneIndex::Locate(const cv::Point &point) const
+{
+    if (m_vLanes.empty() || !m_cBounds.contains(point))
+    {
+        return -1;
+    }
+
+    int cell = ((point.y - m_cBounds.y) / m_nCellSize) * m_nCols + (point.x - m_cBounds.x) / m_nCellSize;
+    for (int i = m_vCellStart[cell]; i < m_vCellStart[cell + 1]; ++i)
+    {
+        int lane = m_vCellLanes[i];
+        if (CACRegionKernel::ContainsPoint(m_vLanes[lane].detectArea, point))
+        {
+            return lane;
+        }
+    }
+    return -1;
+}
+
+void CACLaneIndex::Assign(const std::vector<ANSCENTER::Object> &objects, std::vector<int> &laneIndices) const
+{
+    laneIndices.assign(objects.size(), -1);
+    if (m_vLanes.empty())
+    {
+        return;
+    }
+
+    // Centres grouped by grid cell, each group classified against the cell's lanes in one kernel call
+    std::vector<std::pair<int, size_t>> cellObjects; // (cell, object)
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const cv::Rect &box = objects[i].box;
+        cv::Point centre(box.x + box.width / 2, box.y + box.height / 2);
+        if (m_cBounds.contains(centre))
+        {
+            int cell = ((centre.y - m_cBounds.y) / m_nCellSize) * m_nCols + (centre.x - m_cBounds.x) / m_nCellSize;
+            cellObjects.push_back(std::make_pair(cell, i));
+        }
+    }
+    std::sort(cellObjects.begin(), cellObjects.end());
+
+    CACBoxBatch batch;
+    std::vector<std::vector<cv::Point>> polygons;
+    std::vector<unsigned int> masks;
+    for (size_t begin = 0; begin < cellObjects.size();)
+    {
+        int cell = cellObjects[begin].first;
+        size_t end = begin;
+        batch.Clear();
+        while (end < cellObjects.size() && cellObjects[end].first == cell)
+        {
+            batch.Add(objects[cellObjects[end].second].box);
+            ++end;
+        }
+
+        // The cell's lanes are in lane order, the first one containing the centre wins
+        for (int first = m_vCellStart[cell]; first < m_vCellStart[cell + 1]; first += CACRegionKernel::MAX_REGIONS)
+        {
+            int last = (std::min)(first + CACRegionKernel::MAX_REGIONS, m_vCellStart[cell + 1]);
+            polygons.clear();
+            for (int i = first; i < last; ++i)
+            {
+                polygons.push_back(m_vLanes[m_vCellLanes[i]].detectArea);
+            }
+            CACRegionKernel::ClassifyCentres(batch, polygons, masks);
+            for (size_t b = 0; b < masks.size(); ++b)
+            {
+                int &lane = laneIndices[cellObjects[begin + b].second];
+                for (int r = 0; lane < 0 && r < last - first; ++r)
+                {
+                    if (masks[b] & (1u << r))
+                    {
+                        lane = m_vCellLanes[first + r];
+                    }
+                }
+            }
+        }
+        begin = end;
+    }
+}
+
+bool CACLaneIndex::IsPastStopLine(int laneIndex, const cv::Point &point) const
+{
+    if (laneIndex < 0 || laneIndex >= (int)m_vLanes.size())
+    {
+        return false;
+    }
+
+    const CACLane &lane = m_vLanes[laneIndex];
+    if (lane.crossingLine.size() < 2 || lane.direction.size() < 2)
+    {
+        return true;
+    }
+
+    // Side of the stop line the point is on, compared with the side the direction of travel points to
+    cv::Point line = lane.crossingLine[1] - lane.crossingLine[0];
+    cv::Point travel = lane.direction[1] - lane.direction[0];
+    long long travelSide = (long long)line.x * travel.y - (long long)line.y * travel.x;
+    if (travelSide == 0)
+    {
+        return true;
+    }
+    cv::Point offset = point - lane.crossingLine[0];
+    long long pointSide = (long long)line.x * offset.y - (long long)line.y * offset.x;
+    return (pointSide > 0) == (travelSide > 0) && pointSide != 0;
+}
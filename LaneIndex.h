@@ -0,0 +1,58 @@
+#ifndef LANE_INDEX_H
+#define LANE_INDEX_H
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+#include "ANSCustomData.h"
+
+// One approach lane of a junction. Lane 0 is built from the plain ROI names (DetectArea,
+// CrossingLine, Direction), lane N from the suffixed ones (DetectArea_N, CrossingLine_N, Direction_N).
+struct CACLane
+{
+    int laneId{0};
+    std::vector<cv::Point> detectArea;
+    std::vector<cv::Point> crossingLine; // Stop line, two points
+    std::vector<cv::Point> direction;    // Direction of travel, two points
+};
+
+// Assigns points to lanes through a uniform grid over the lane bounds. Every cell lists the lanes
+// whose bounding rectangle touches it, so a lookup tests one or two polygons whatever the lane count.
+// Assign groups the centres by cell and classifies each group against the cell's lanes with the
+// SIMD region kernel. Where lanes overlap, the first lane in lane id order wins.
+class CACLaneIndex
+{
+private:
+    std::vector<CACLane> m_vLanes;
+    cv::Rect m_cBounds;
+    int m_nCellSize;
+    int m_nCols;
+    int m_nRows;
+    std::vector<int> m_vCellStart; // Cell c lists m_vCellLanes[m_vCellStart[c] .. m_vCellStart[c + 1])
+    std::vector<int> m_vCellLanes;
+
+public:
+    static const int MAX_CELLS = 16384;
+
+    CACLaneIndex();
+
+    // "DetectArea_2" -> ("DetectArea", 2), "DetectArea" -> ("DetectArea", 0)
+    static void ParseRegionName(const std::string &regionName, std::string &baseName, int &laneId);
+    // Groups the lane ROIs by lane id; lanes without a DetectArea are dropped
+    static std::vector<CACLane> BuildLanes(const std::vector<CustomRegion> &rois);
+
+    void Build(const std::vector<CACLane> &lanes, int cellSize);
+    const std::vector<CACLane> &GetLanes() const { return m_vLanes; }
+    bool Empty() const { return m_vLanes.empty(); }
+
+    // Index into GetLanes() of the lane containing the point, -1 when outside every lane
+    int Locate(const cv::Point &point) const;
+    // Lane index of every box centre, same as Locate on each
+    void Assign(const std::vector<ANSCENTER::Object> &objects, std::vector<int> &laneIndices) const;
+    // Whether a point of the lane is past its stop line in the direction of travel. Lanes without a
+    // stop line, or with a direction parallel to it, count the whole DetectArea as past the line.
+    bool IsPastStopLine(int laneIndex, const cv::Point &point) const;
+};
+
+#endif // LANE_INDEX_H
@@ -0,0 +1,268 @@
+#include "LightMosaic.h"
+#include <map>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include "FramePool.h"
+
+CACLightMosaic::CACLightMosaic()
+{
+    m_bCollecting = false;
+    m_nInFlight = 0;
+    m_nWidth = 640;
+    m_nMaxHeight = 640;
+    m_nPadding = 8;
+    m_dMaxWaitMs = 5.0;
+}
+
+std::shared_ptr<CACLightMosaic> CACLightMosaic::Acquire(const std::string &key)
+{
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<CACLightMosaic>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<CACLightMosaic> mosaic = registry[key].lock();
+    if (!mosaic)
+    {
+        mosaic = std::make_shared<CACLightMosaic>();
+        registry[key] = mosaic;
+    }
+    return mosaic;
+}
+
+void CACLightMosaic::BeginTick()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    m_nInFlight++;
+}
+
+void CACLightMosaic::EndTick()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    m_nInFlight = (std::max)(0, m_nInFlight - 1);
+    m_cCondition.notify_all(); // A leader may be waiting for this camera
+}
+
+void CACLightMosaic::Configure(int width, int maxHeight, int padding, double maxWaitMs)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    m_nPadding = (std::max)(0, padding);
+    m_nWidth = (std::max)(2 * m_nPadding + 32, width);
+    m_nMaxHeight = (std::max)(2 * m_nPadding + 32, maxHeight);
+    m_dMaxWaitMs = (std::max)(0.0, maxWaitMs);
+}
+
+CACLightMosaic::Stats CACLightMosaic::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    return m_stStats;
+}
+
+std::vector<int> CACLightMosaic::Pack(const std::vector<cv::Size> &sizes, int width, int maxHeight, int padding,
+                                      std::vector<Placement> &placements)
+{
+    placements.assign(sizes.size(), Placement());
+    std::vector<int> atlasHeights;
+    if (sizes.empty())
+    {
+        return atlasHeights;
+    }
+
+    // Scale down crops wider than the atlas, then place the tallest first so shelves waste little
+    std::vector<cv::Size> scaled(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        double scale = (std::min)(1.0, (double)(width - 2 * padding) / (std::max)(1, sizes[i].width));
+        placements[i].scale = scale;
+        scaled[i] = cv::Size((std::max)(1, (int)std::lround(sizes[i].width * scale)),
+                             (std::max)(1, (int)std::lround(sizes[i].height * scale)));
+    }
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&scaled](size_t a, size_t b)
+                     { return scaled[a].height > scaled[b].height; });
+
+    atlasHeights.push_back(0);
+    int shelfX = padding;
+    int shelfY = padding;
+    int shelfHeight = 0;
+    for (size_t index : order)
+    {
+        const cv::Size &size = scaled[index];
+        if (shelfX + size.width + padding > width)
+        {
+            shelfY += shelfHeight + padding;
+            shelfX = padding;
+            shelfHeight = 0;
+        }
+        if (shelfY + size.height + padding > maxHeight && atlasHeights.back() > 0)
+        {
+            atlasHeights.push_back(0);
+            shelfX = padding;
+            shelfY = padding;
+            shelfHeight = 0;
+        }
+
+        placements[index].atlas = (int)atlasHeights.size() - 1;
+        placements[index].cell = cv::Rect(shelfX, shelfY, size.width, size.height);
+        shelfX += size.width + padding;
+        shelfHeight = (std::max)(shelfHeight, size.height);
+        atlasHeights.back() = (std::max)(atlasHeights.back(), shelfY + size.height + padding);
+    }
+    return atlasHeights;
+}
+
+void CACLightMosaic::RunBatch(const std::vector<std::shared_ptr<Request>> &batch, const Runner &runner)
+{
+    // Crops that cannot share an atlas run on their own
+    std::vector<std::shared_ptr<Request>> packed;
+    for (const auto &request : batch)
+    {
+        if (batch.size() == 1 || request->crop.empty() || request->crop.type() != CV_8UC3)
+        {
+            request->status = runner(request->crop, request->results);
+            std::lock_guard<std::mutex> lock(m_cMutex);
+            m_stStats.inferences++;
+        }
+        else
+        {
+            packed.push_back(request);
+        }
+    }
+    if (packed.empty())
+    {
+        return;
+    }
+
+    int width;
+    int maxHeight;
+    int padding;
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        width = m_nWidth;
+        maxHeight = m_nMaxHeight;
+        padding = m_nPadding;
+    }
+
+    std::vector<cv::Size> sizes;
+    for (const auto &request : packed)
+    {
+        sizes.push_back(request->crop.size());
+    }
+    std::vector<Placement> placements;
+    std::vector<int> atlasHeights = Pack(sizes, width, maxHeight, padding, placements);
+
+    for (size_t atlas = 0; atlas < atlasHeights.size(); ++atlas)
+    {
+        // Grey gutters keep boxes from spanning two cells
+        cv::Mat frame = CACFramePool::Instance().Acquire(atlasHeights[atlas], width, CV_8UC3);
+        frame.setTo(cv::Scalar(114, 114, 114));
+        std::vector<size_t> members;
+        for (size_t i = 0; i < packed.size(); ++i)
+        {
+            if (placements[i].atlas != (int)atlas)
+            {
+                continue;
+            }
+            members.push_back(i);
+            cv::Mat target = frame(placements[i].cell);
+            if (placements[i].scale < 1.0)
+            {
+                cv::resize(packed[i]->crop, target, placements[i].cell.size(), 0, 0, cv::INTER_AREA);
+            }
+            else
+            {
+                packed[i]->crop.copyTo(target);
+            }
+        }
+
+        std::vector<ANSCENTER::Object> detections;
+        int status = runner(frame, detections);
+        {
+            std::lock_guard<std::mutex> lock(m_cMutex);
+            m_stStats.inferences++;
+        }
+
+        for (size_t i : members)
+        {
+            packed[i]->status = status;
+        }
+        for (const auto &obj : detections)
+        {
+            cv::Point center(obj.box.x + obj.box.width / 2, obj.box.y + obj.box.height / 2);
+            for (size_t i : members)
+            {
+                const Placement &placement = placements[i];
+                if (!placement.cell.contains(center))
+                {
+                    continue;
+                }
+
+                // Back to crop coordinates
+                cv::Rect box = obj.box & placement.cell;
+                ANSCENTER::Object mapped = obj;
+                mapped.box = cv::Rect((int)std::lround((box.x - placement.cell.x) / placement.scale),
+                                      (int)std::lround((box.y - placement.cell.y) / placement.scale),
+                                      (int)std::lround(box.width / placement.scale),
+                                      (int)std::lround(box.height / placement.scale)) &
+                             cv::Rect(0, 0, packed[i]->crop.cols, packed[i]->crop.rows);
+                packed[i]->results.push_back(mapped);
+                break;
+            }
+        }
+    }
+}
+
+int CACLightMosaic::Detect(const cv::Mat &crop, const Runner &runner, std::vector<ANSCENTER::Object> &results)
+{
+    // The crop is not copied: the caller stays blocked until its batch has run
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->crop = crop;
+
+    std::unique_lock<std::mutex> lock(m_cMutex);
+    m_vPending.push_back(request);
+    m_stStats.requests++;
+
+    if (m_bCollecting)
+    {
+        // A leader is gathering this tick; it runs our crop too
+        m_cCondition.notify_all();
+        m_cCondition.wait(lock, [&request]()
+                          { return request->done; });
+        results = request->results;
+        return request->status;
+    }
+
+    m_bCollecting = true;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::microseconds((long long)(m_dMaxWaitMs * 1000.0));
+    m_cCondition.wait_until(lock, deadline, [this]()
+                            { return (int)m_vPending.size() >= m_nInFlight; });
+    std::vector<std::shared_ptr<Request>> batch;
+    batch.swap(m_vPending);
+    m_bCollecting = false; // Cameras arriving from now on start the next batch
+    m_stStats.batches++;
+    lock.unlock();
+
+    try
+    {
+        RunBatch(batch, runner);
+    }
+    catch (const std::exception &e)
+    {
+        for (const auto &pending : batch)
+        {
+            pending->results.clear();
+            pending->status = 0;
+        }
+    }
+
+    lock.lock();
+    for (const auto &pending : batch)
+    {
+        pending->done = true;
+    }
+    m_cCondition.notify_all();
+    results = request->results;
+    return request->status;
+}
@@ -0,0 +1,84 @@
+#ifndef LIGHT_MOSAIC_H
+#define LIGHT_MOSAIC_H
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Batches the TrafficRoi crops of every camera using one light model into a single atlas image.
+// The first camera of a tick becomes the leader: it waits until every camera inside its light stage
+// has a crop pending (or maxWaitMs passed), packs the crops on shelves separated by a grey gutter,
+// runs the detector once per atlas and hands each camera the boxes whose centre falls in its cell,
+// in crop coordinates. A tick with a single crop runs on the crop directly.
+class CACLightMosaic
+{
+public:
+    // Runs the light detector on one image
+    typedef std::function<int(const cv::Mat &, std::vector<ANSCENTER::Object> &)> Runner;
+
+    struct Stats
+    {
+        long long requests{0};
+        long long batches{0};
+        long long inferences{0}; // Detector calls, one per atlas
+    };
+
+    struct Placement
+    {
+        int atlas{0};
+        cv::Rect cell; // Where the (scaled) crop sits in its atlas
+        double scale{1.0};
+    };
+
+private:
+    struct Request
+    {
+        cv::Mat crop;
+        std::vector<ANSCENTER::Object> results;
+        int status{0};
+        bool done{false};
+    };
+
+    std::mutex m_cMutex;
+    std::condition_variable m_cCondition;
+    std::vector<std::shared_ptr<Request>> m_vPending;
+    bool m_bCollecting; // A leader is gathering the current batch
+    int m_nInFlight; // Cameras between BeginTick and EndTick
+    int m_nWidth;
+    int m_nMaxHeight;
+    int m_nPadding;
+    double m_dMaxWaitMs;
+    Stats m_stStats;
+
+    void RunBatch(const std::vector<std::shared_ptr<Request>> &batch, const Runner &runner);
+
+public:
+    CACLightMosaic();
+
+    // Process-wide mosaic per light model key
+    static std::shared_ptr<CACLightMosaic> Acquire(const std::string &key);
+
+    // Bracket the light stage of one camera frame. Detect blocks, so a camera in flight has at most
+    // one crop pending; the leader stops waiting once every camera in flight has one, and cameras
+    // that skip detection this tick leave the count at EndTick. Heads of one camera are batched
+    // one per tick.
+    void BeginTick();
+    void EndTick();
+    void Configure(int width, int maxHeight, int padding, double maxWaitMs);
+
+    // Blocks until the batch holding this crop has run
+    int Detect(const cv::Mat &crop, const Runner &runner, std::vector<ANSCENTER::Object> &results);
+    Stats GetStats();
+
+    // Shelf packing, tallest crops first. Crops wider than the atlas are scaled down to fit and a
+    // new atlas is started when maxHeight would be exceeded. Returns the height of every atlas.
+    static std::vector<int> Pack(const std::vector<cv::Size> &sizes, int width, int maxHeight, int padding,
+                                 std::vector<Placement> &placements);
+};
+
+#endif // LIGHT_MOSAIC_H
@@ -0,0 +1,222 @@
+#include "LocalSocket.h"
+#include <cstring>
+#include <mutex>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#define CLOSE_SOCKET closesocket
+static const uintptr_t NO_SOCKET = (uintptr_t)INVALID_SOCKET;
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <signal.h>
+#define CLOSE_SOCKET close
+static const int NO_SOCKET = -1;
+#endif
+
+static void StartSockets()
+{
+    static std::once_flag s_cOnce;
+    std::call_once(s_cOnce, []()
+                   {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#else
+        // A worker that went away must not take the coordinator down with SIGPIPE
+        signal(SIGPIPE, SIG_IGN);
+#endif
+                   });
+}
+
+static bool MakeAddress(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+CACLocalSocket::CACLocalSocket()
+{
+    m_nSocket = NO_SOCKET;
+}
+
+CACLocalSocket::~CACLocalSocket()
+{
+    Close();
+}
+
+CACLocalSocket::CACLocalSocket(CACLocalSocket &&other) noexcept
+{
+    m_nSocket = other.m_nSocket;
+    m_sPath.swap(other.m_sPath);
+    m_sBuffer.swap(other.m_sBuffer);
+    other.m_nSocket = NO_SOCKET;
+}
+
+CACLocalSocket &CACLocalSocket::operator=(CACLocalSocket &&other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_nSocket = other.m_nSocket;
+        m_sPath.swap(other.m_sPath);
+        m_sBuffer.swap(other.m_sBuffer);
+        other.m_nSocket = NO_SOCKET;
+    }
+    return *this;
+}
+
+bool CACLocalSocket::IsValid() const
+{
+    return m_nSocket != NO_SOCKET;
+}
+
+bool CACLocalSocket::WaitReadable(int timeoutMs) const
+{
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(m_nSocket, &readable);
+    timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    return select((int)m_nSocket + 1, &readable, nullptr, nullptr, timeoutMs < 0 ? nullptr : &timeout) > 0;
+}
+
+bool CACLocalSocket::Listen(const std::string &path)
+{
+    Close();
+    StartSockets();
+    sockaddr_un address;
+    if (!MakeAddress(path, address))
+    {
+        return false;
+    }
+    m_nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!IsValid())
+    {
+        return false;
+    }
+#ifdef _WIN32
+    DeleteFileA(path.c_str());
+#else
+    unlink(path.c_str());
+#endif
+    if (bind(m_nSocket, reinterpret_cast<sockaddr *>(&address), (socklen_t)sizeof(address)) != 0 || listen(m_nSocket, 16) != 0)
+    {
+        Close();
+        return false;
+    }
+    m_sPath = path;
+    return true;
+}
+
+CACLocalSocket CACLocalSocket::Accept(int timeoutMs)
+{
+    CACLocalSocket connection;
+    if (IsValid() && WaitReadable(timeoutMs))
+    {
+        connection.m_nSocket = accept(m_nSocket, nullptr, nullptr);
+    }
+    return connection;
+}
+
+bool CACLocalSocket::Connect(const std::string &path)
+{
+    Close();
+    StartSockets();
+    sockaddr_un address;
+    if (!MakeAddress(path, address))
+    {
+        return false;
+    }
+    m_nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!IsValid())
+    {
+        return false;
+    }
+    if (connect(m_nSocket, reinterpret_cast<sockaddr *>(&address), (socklen_t)sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CACLocalSocket::Close()
+{
+    if (IsValid())
+    {
+        CLOSE_SOCKET(m_nSocket);
+        m_nSocket = NO_SOCKET;
+    }
+    if (!m_sPath.empty())
+    {
+#ifdef _WIN32
+        DeleteFileA(m_sPath.c_str());
+#else
+        unlink(m_sPath.c_str());
+#endif
+        m_sPath.clear();
+    }
+    m_sBuffer.clear();
+}
+
+bool CACLocalSocket::Send(const std::string &line)
+{
+    if (!IsValid())
+    {
+        return false;
+    }
+    std::string message = line + "\n";
+    size_t sent = 0;
+    while (sent < message.size())
+    {
+        int result = (int)send(m_nSocket, message.data() + sent, (int)(message.size() - sent), 0);
+        if (result <= 0)
+        {
+            return false;
+        }
+        sent += (size_t)result;
+    }
+    return true;
+}
+
+int CACLocalSocket::Receive(std::string &line, int timeoutMs)
+{
+    while (true)
+    {
+        size_t end = m_sBuffer.find('\n');
+        if (end != std::string::npos)
+        {
+            line = m_sBuffer.substr(0, end);
+            m_sBuffer.erase(0, end + 1);
+            return 1;
+        }
+        if (!IsValid())
+        {
+            return -1;
+        }
+        if (!WaitReadable(timeoutMs))
+        {
+            return 0;
+        }
+        char chunk[4096];
+        int received = (int)recv(m_nSocket, chunk, (int)sizeof(chunk), 0);
+        if (received <= 0)
+        {
+            return -1;
+        }
+        m_sBuffer.append(chunk, (size_t)received);
+        timeoutMs = 0; // The rest of a line that was already on its way
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef LOCAL_SOCKET_H
+#define LOCAL_SOCKET_H
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Stream socket on a local (AF_UNIX) path carrying newline-terminated text messages. Windows 10
+// 1803 and later have AF_UNIX through Winsock, so the same code runs on both platforms.
+class CACLocalSocket
+{
+private:
+#ifdef _WIN32
+    uintptr_t m_nSocket; // SOCKET
+#else
+    int m_nSocket;
+#endif
+    std::string m_sPath;     // Listening socket: the path it removes on Close
+    std::string m_sBuffer;   // Received bytes after the last complete line
+
+    bool IsValid() const;
+    // Waits up to timeoutMs for the socket to be readable, 0 polls, negative waits without limit
+    bool WaitReadable(int timeoutMs) const;
+
+public:
+    CACLocalSocket();
+    ~CACLocalSocket();
+    CACLocalSocket(const CACLocalSocket &) = delete;
+    CACLocalSocket &operator=(const CACLocalSocket &) = delete;
+    CACLocalSocket(CACLocalSocket &&other) noexcept;
+    CACLocalSocket &operator=(CACLocalSocket &&other) noexcept;
+
+    // Server: binds the path (a stale socket file left by a crashed process is replaced)
+    bool Listen(const std::string &path);
+    // Server: the next connection, or a closed socket when none came within timeoutMs
+    CACLocalSocket Accept(int timeoutMs);
+    // Client
+    bool Connect(const std::string &path);
+    void Close();
+    bool IsOpen() const { return IsValid(); }
+
+    // One message; must not contain a newline. False when the peer is gone.
+    bool Send(const std::string &line);
+    // 1: a message was read, 0: none within timeoutMs, -1: the peer closed the connection
+    int Receive(std::string &line, int timeoutMs);
+};
+
+#endif // LOCAL_SOCKET_H
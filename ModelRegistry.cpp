@@ -0,0 +1,103 @@
+#include "ModelRegistry.h"
+#include <iostream>
+#include <tuple>
+#include <sstream>
+
+bool CACModelRegistry::Key::operator<(const Key &other) const
+{
+    return std::tie(modelDirectory, modelName, className, modelType, detectionType, precision, scoreThreshold, confidenceThreshold, nmsThreshold) <
+           std::tie(other.modelDirectory, other.modelName, other.className, other.modelType, other.detectionType, other.precision,
+                    other.scoreThreshold, other.confidenceThreshold, other.nmsThreshold);
+}
+
+std::string CACModelRegistry::Key::ToString() const
+{
+    std::ostringstream text;
+    text << modelDirectory << "|" << modelName << "|" << className << "|" << modelType << "|" << detectionType << "|" << precision
+         << "|" << scoreThreshold << "|" << confidenceThreshold << "|" << nmsThreshold;
+    return text.str();
+}
+
+CACModelRegistry &CACModelRegistry::Instance()
+{
+    static CACModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<CACDetectorPool> CACModelRegistry::Acquire(const Key &key, int poolSize, const CACDetectorPool::Loader &loader)
+{
+    std::promise<std::shared_ptr<CACDetectorPool>> promise;
+    {
+        std::unique_lock<std::mutex> lock(m_cMutex);
+        Entry &entry = m_mEntries[key];
+
+        std::shared_ptr<CACDetectorPool> pool = entry.pool.lock();
+        if ((pool || entry.loading.valid()) && poolSize != entry.poolSize)
+        {
+            // One pool per key: resizing it would reload the model under the cameras using it
+            std::cerr << "Model registry: " << key.ToString() << " asked for " << poolSize << " handle(s), shared with the "
+                      << entry.poolSize << " it was loaded with" << std::endl;
+        }
+        if (pool)
+        {
+            return pool;
+        }
+
+        if (entry.loading.valid())
+        {
+            // Someone else is loading this model; wait without holding the registry lock
+            std::shared_future<std::shared_ptr<CACDetectorPool>> loading = entry.loading;
+            lock.unlock();
+            return loading.get();
+        }
+
+        entry.loading = promise.get_future().share();
+        entry.poolSize = poolSize;
+    }
+
+    // Load outside the lock so different models load in parallel
+    std::cout << "Model registry: loading " << key.ToString() << " with " << poolSize << " handle(s)" << std::endl;
+    std::shared_ptr<CACDetectorPool> pool = std::make_shared<CACDetectorPool>();
+    if (!pool->Initialize(poolSize, loader))
+    {
+        pool.reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        Entry &entry = m_mEntries[key];
+        entry.pool = pool;
+        entry.loading = std::shared_future<std::shared_ptr<CACDetectorPool>>();
+        if (!pool)
+        {
+            // Let the next caller retry the load
+            m_mEntries.erase(key);
+        }
+    }
+    promise.set_value(pool);
+    return pool;
+}
+
+std::vector<CACModelRegistry::EntryInfo> CACModelRegistry::GetEntries()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    std::vector<EntryInfo> entries;
+    for (auto it = m_mEntries.begin(); it != m_mEntries.end();)
+    {
+        std::shared_ptr<CACDetectorPool> pool = it->second.pool.lock();
+        if (!pool && !it->second.loading.valid())
+        {
+            // Last user is gone, the pool has been unloaded
+            it = m_mEntries.erase(it);
+            continue;
+        }
+
+        EntryInfo info;
+        info.key = it->first.ToString();
+        info.users = pool ? pool.use_count() - 1 : 0;
+        info.handles = pool ? pool->GetSize() : 0;
+        entries.push_back(info);
+        ++it;
+    }
+    return entries;
+}
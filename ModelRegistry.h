@@ -0,0 +1,68 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include "DetectorPool.h"
+
+// Process-wide registry of loaded models. Every camera that asks for the same model files, precision
+// and thresholds gets the same detector pool, so the weights are loaded once per distinct model
+// instead of once per camera. The thresholds are baked into the handles at load and the precision is
+// what the pool is optimised to, so cameras that differ in either get their own pool. Pools are
+// reference counted through std::shared_ptr and unloaded when the last camera releases them.
+class CACModelRegistry
+{
+public:
+    struct Key
+    {
+        std::string modelDirectory;
+        std::string modelName;
+        std::string className;
+        int modelType{0};
+        int detectionType{0};
+        std::string precision; // "fp32" or "fp16"
+        float scoreThreshold{0.0f};
+        float confidenceThreshold{0.0f};
+        float nmsThreshold{0.0f};
+
+        bool operator<(const Key &other) const;
+        std::string ToString() const;
+    };
+
+    struct EntryInfo
+    {
+        std::string key;
+        long users{0};
+        int handles{0};
+    };
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<CACDetectorPool> pool;
+        std::shared_future<std::shared_ptr<CACDetectorPool>> loading; // Valid while the first user loads it
+        int poolSize{0};                                               // Handles the first user asked for
+    };
+
+    std::mutex m_cMutex;
+    std::map<Key, Entry> m_mEntries;
+
+    CACModelRegistry() {}
+    CACModelRegistry(const CACModelRegistry &) = delete;
+    CACModelRegistry &operator=(const CACModelRegistry &) = delete;
+
+public:
+    static CACModelRegistry &Instance();
+
+    // Shared pool for the key; the first caller loads it with poolSize handles, concurrent callers
+    // for the same key wait for that load. Later callers asking for another poolSize get the pool as
+    // it was loaded, with a warning. Returns nullptr if loading failed.
+    std::shared_ptr<CACDetectorPool> Acquire(const Key &key, int poolSize, const CACDetectorPool::Loader &loader);
+    std::vector<EntryInfo> GetEntries();
+};
+
+#endif // MODEL_REGISTRY_H
@@ -0,0 +1,145 @@
+#include "MotionGate.h"
+
+CACMotionGate::CACMotionGate()
+{
+    m_nMode = MOTION_GATE_OFF;
+    m_nDownscaleWidth = 160;
+    m_nPixelThreshold = 25;
+    m_fMinChangedRatio = 0.002f;
+    m_nMaxSkippedFrames = 25;
+    m_nSkippedFrames = 0;
+}
+
+void CACMotionGate::Configure(int mode, int downscaleWidth, int pixelThreshold, float minChangedRatio, int maxSkippedFrames)
+{
+    m_nMode = (mode < MOTION_GATE_OFF || mode > MOTION_GATE_ANSLIB) ? MOTION_GATE_OFF : mode;
+    m_nDownscaleWidth = (std::max)(16, downscaleWidth);
+    m_nPixelThreshold = (std::max)(1, pixelThreshold);
+    m_fMinChangedRatio = (std::max)(0.0f, minChangedRatio);
+    m_nMaxSkippedFrames = (std::max)(0, maxSkippedFrames);
+    Reset();
+}
+
+void CACMotionGate::Reset()
+{
+    m_nSkippedFrames = 0;
+    m_cArea = cv::Rect();
+    m_cPrevGray.release();
+    m_cAreaMask.release();
+}
+
+bool CACMotionGate::HasFrameDifference(const cv::Mat &input, const cv::Rect &area, const std::vector<cv::Point> &polygon,
+                                       CACFramePyramid *pyramid)
+{
+    // Downscale the DetectArea only; the rest of the frame is never touched
+    double scale = (std::min)(1.0, (double)m_nDownscaleWidth / (std::max)(1, area.width));
+    cv::Size smallSize((std::max)(1, (int)std::lround(area.width * scale)),
+                       (std::max)(1, (int)std::lround(area.height * scale)));
+
+    cv::Mat gray;
+    if (pyramid && !pyramid->Empty())
+    {
+        // The shared gray level is already close to the target size, only a small resize is left
+        int level = pyramid->ChooseLevel(area.width, m_nDownscaleWidth);
+        cv::Rect levelArea = pyramid->ScaleRect(area, level);
+        cv::resize(pyramid->GetGray(level)(levelArea), gray, smallSize, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+        cv::Mat smallColor;
+        cv::resize(input(area), smallColor, smallSize, 0, 0, cv::INTER_AREA);
+        if (smallColor.channels() == 1)
+        {
+            gray = smallColor;
+        }
+        else
+        {
+            cv::cvtColor(smallColor, gray, cv::COLOR_BGR2GRAY);
+        }
+    }
+    cv::GaussianBlur(gray, gray, cv::Size(3, 3), 0);
+
+    // Rebuild the polygon mask when the area changes
+    if (area != m_cArea || m_cAreaMask.size() != smallSize)
+    {
+        m_cArea = area;
+        m_cPrevGray.release();
+        m_cAreaMask = cv::Mat::zeros(smallSize, CV_8UC1);
+        if (polygon.size() >= 3)
+        {
+            std::vector<cv::Point> scaled;
+            for (const auto &pt : polygon)
+            {
+                scaled.push_back(cv::Point((int)std::lround((pt.x - area.x) * scale),
+                                           (int)std::lround((pt.y - area.y) * scale)));
+            }
+            std::vector<std::vector<cv::Point>> contours = {scaled};
+            cv::fillPoly(m_cAreaMask, contours, cv::Scalar(255));
+        }
+        else
+        {
+            m_cAreaMask.setTo(cv::Scalar(255));
+        }
+    }
+
+    if (m_cPrevGray.empty())
+    {
+        m_cPrevGray = gray;
+        return true;
+    }
+
+    cv::Mat diff;
+    cv::absdiff(gray, m_cPrevGray, diff);
+    cv::threshold(diff, diff, m_nPixelThreshold, 255, cv::THRESH_BINARY);
+    cv::bitwise_and(diff, m_cAreaMask, diff);
+    m_cPrevGray = gray;
+
+    int maskPixels = (std::max)(1, cv::countNonZero(m_cAreaMask));
+    m_stStats.lastChangedRatio = (float)cv::countNonZero(diff) / maskPixels;
+    return m_stStats.lastChangedRatio >= m_fMinChangedRatio;
+}
+
+bool CACMotionGate::ShouldDetect(const cv::Mat &input, const cv::Rect &area, const std::vector<cv::Point> &polygon,
+                                 const MovementDetector &detectMovement, CACFramePyramid *pyramid)
+{
+    if (m_nMode == MOTION_GATE_OFF || input.empty())
+    {
+        return true;
+    }
+
+    cv::Rect clippedArea = area & cv::Rect(0, 0, input.cols, input.rows);
+    if (clippedArea.empty())
+    {
+        return true;
+    }
+
+    m_stStats.frames++;
+    bool motion = true;
+    try
+    {
+        if (m_nMode == MOTION_GATE_ANSLIB)
+        {
+            std::vector<ANSCENTER::Object> movements;
+            detectMovement(input(clippedArea), movements);
+            motion = !movements.empty();
+        }
+        else
+        {
+            motion = HasFrameDifference(input, clippedArea, polygon, pyramid);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        motion = true;
+    }
+
+    if (motion || m_nSkippedFrames >= m_nMaxSkippedFrames)
+    {
+        m_nSkippedFrames = 0;
+        return true;
+    }
+
+    m_nSkippedFrames++;
+    m_stStats.skipped++;
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+#include "FramePyramid.h"
+
+// Cheap motion check inside the DetectArea, used to skip the vehicle model on static scenes.
+// Detection is still forced every m_nMaxSkippedFrames frames so stopped vehicles are re-confirmed.
+class CACMotionGate
+{
+public:
+    enum Mode
+    {
+        MOTION_GATE_OFF = 0,
+        MOTION_GATE_FRAME_DIFF = 1, // Downscaled grayscale frame difference
+        MOTION_GATE_ANSLIB = 2      // ANSLIB::DetectMovement on the DetectArea crop
+    };
+
+    typedef std::function<int(const cv::Mat &, std::vector<ANSCENTER::Object> &)> MovementDetector;
+
+    struct Stats
+    {
+        long long frames{0};
+        long long skipped{0};
+        float lastChangedRatio{0.0f};
+    };
+
+private:
+    int m_nMode;
+    int m_nDownscaleWidth;    // Width of the downscaled DetectArea used for differencing
+    int m_nPixelThreshold;    // Grey-level difference counted as a changed pixel
+    float m_fMinChangedRatio; // Fraction of DetectArea pixels that must change to count as motion
+    int m_nMaxSkippedFrames;  // Force a detection after this many skipped frames
+
+    int m_nSkippedFrames;
+    cv::Rect m_cArea;
+    cv::Mat m_cPrevGray;
+    cv::Mat m_cAreaMask;
+    Stats m_stStats;
+
+    bool HasFrameDifference(const cv::Mat &input, const cv::Rect &area, const std::vector<cv::Point> &polygon,
+                            CACFramePyramid *pyramid);
+
+public:
+    CACMotionGate();
+
+    void Configure(int mode, int downscaleWidth, int pixelThreshold, float minChangedRatio, int maxSkippedFrames);
+    int GetMode() const { return m_nMode; }
+    int GetDownscaleWidth() const { return m_nDownscaleWidth; }
+    int GetPixelThreshold() const { return m_nPixelThreshold; }
+    float GetMinChangedRatio() const { return m_fMinChangedRatio; }
+    int GetMaxSkippedFrames() const { return m_nMaxSkippedFrames; }
+    Stats GetStats() const { return m_stStats; }
+
+    // Returns true when the vehicle model should run on this frame. With a pyramid the difference
+    // is taken on its grayscale level closest to the downscale width instead of resizing the input.
+    bool ShouldDetect(const cv::Mat &input, const cv::Rect &area, const std::vector<cv::Point> &polygon,
+                      const MovementDetector &detectMovement, CACFramePyramid *pyramid = nullptr);
+    void Reset();
+};
+
+#endif // MOTION_GATE_H
@@ -0,0 +1,62 @@
+#include "NV12Frame.h"
+
+void CACNV12Frame::WrapPlanes(const unsigned char *y, size_t yStride, const unsigned char *uv, size_t uvStride,
+                              int width, int height, cv::Mat &yPlane, cv::Mat &uvPlane)
+{
+    yPlane = cv::Mat(height, width, CV_8UC1, (void *)y, yStride);
+    uvPlane = cv::Mat(height / 2, width / 2, CV_8UC2, (void *)uv, uvStride);
+}
+
+void CACNV12Frame::ConvertFull(const cv::Mat &yPlane, const cv::Mat &uvPlane, cv::Mat &bgr)
+{
+    cv::Rect frameRect(0, 0, yPlane.cols & ~1, yPlane.rows & ~1);
+    cv::Mat uv = (uvPlane.channels() == 1) ? uvPlane.reshape(2) : uvPlane;
+    cv::cvtColorTwoPlane(yPlane(frameRect), uv(cv::Rect(0, 0, frameRect.width / 2, frameRect.height / 2)), bgr,
+                         cv::COLOR_YUV2BGR_NV12);
+}
+
+const cv::Mat &CACNV12Frame::Convert(const cv::Mat &yPlane, const cv::Mat &uvPlane, const std::vector<cv::Rect> &regions)
+{
+    // Even frame size so every 2x2 block has its chroma sample
+    cv::Rect frameRect(0, 0, yPlane.cols & ~1, yPlane.rows & ~1);
+    if (m_cBGR.size() != frameRect.size() || m_cBGR.type() != CV_8UC3)
+    {
+        m_cBGR = cv::Mat::zeros(frameRect.size(), CV_8UC3);
+    }
+
+    cv::Mat uv = (uvPlane.channels() == 1) ? uvPlane.reshape(2) : uvPlane;
+
+    std::vector<cv::Rect> areas;
+    for (const auto &region : regions)
+    {
+        cv::Rect area = region & frameRect;
+        if (!area.empty())
+        {
+            areas.push_back(area);
+        }
+    }
+    if (areas.empty())
+    {
+        areas.push_back(frameRect);
+    }
+
+    long long converted = 0;
+    for (const auto &area : areas)
+    {
+        int x0 = area.x & ~1;
+        int y0 = area.y & ~1;
+        int x1 = (std::min)(frameRect.width, (area.x + area.width + 1) & ~1);
+        int y1 = (std::min)(frameRect.height, (area.y + area.height + 1) & ~1);
+        cv::Rect even(x0, y0, x1 - x0, y1 - y0);
+
+        // The destination is a view into the frame buffer, so the conversion writes in place
+        cv::Mat target = m_cBGR(even);
+        cv::cvtColorTwoPlane(yPlane(even), uv(cv::Rect(even.x / 2, even.y / 2, even.width / 2, even.height / 2)),
+                             target, cv::COLOR_YUV2BGR_NV12);
+        converted += even.area();
+    }
+
+    m_stStats.frames++;
+    m_stStats.convertedRatio = (double)converted / (std::max)(1, frameRect.area());
+    return m_cBGR;
+}
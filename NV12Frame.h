@@ -0,0 +1,39 @@
+#ifndef NV12_FRAME_H
+#define NV12_FRAME_H
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Converts NV12 decoder output to BGR only where the analytics look. The Y plane (CV_8UC1,
+// width x height) and the interleaved UV plane (CV_8UC2, width/2 x height/2, or CV_8UC1 with
+// width bytes per row) are used in place, typically as cv::Mat headers over decoder memory.
+// The requested regions are widened to even coordinates, as NV12 chroma covers 2x2 pixels, and
+// converted into a BGR frame buffer that persists between frames. Pixels outside the regions are
+// never converted.
+class CACNV12Frame
+{
+public:
+    struct Stats
+    {
+        long long frames{0};
+        double convertedRatio{0.0}; // Converted pixels over frame pixels, last frame
+    };
+
+private:
+    cv::Mat m_cBGR;
+    Stats m_stStats;
+
+public:
+    // Returns the BGR frame; only the regions hold the current picture
+    const cv::Mat &Convert(const cv::Mat &yPlane, const cv::Mat &uvPlane, const std::vector<cv::Rect> &regions);
+    const cv::Mat &GetBGR() const { return m_cBGR; }
+    // The whole frame into the caller's buffer, (re)allocated to the even frame size
+    static void ConvertFull(const cv::Mat &yPlane, const cv::Mat &uvPlane, cv::Mat &bgr);
+    Stats GetStats() const { return m_stStats; }
+
+    // Header over external NV12 memory, no copy
+    static void WrapPlanes(const unsigned char *y, size_t yStride, const unsigned char *uv, size_t uvStride,
+                           int width, int height, cv::Mat &yPlane, cv::Mat &uvPlane);
+};
+
+#endif // NV12_FRAME_H
@@ -0,0 +1,385 @@
+#include "ParamsJson.h"
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    struct JsonValue
+    {
+        enum Type
+        {
+            NUL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT
+        };
+        Type type{NUL};
+        std::string text; // Numbers, strings and booleans as written
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue *Find(const std::string &name) const
+        {
+            for (const auto &member : members)
+            {
+                if (member.first == name)
+                {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonParser
+    {
+        const std::string &m_sText;
+        size_t m_nPos;
+
+        void SkipSpace()
+        {
+            while (m_nPos < m_sText.size())
+            {
+                char c = m_sText[m_nPos];
+                if (std::isspace((unsigned char)c))
+                {
+                    ++m_nPos;
+                }
+                else if (m_sText.compare(m_nPos, 2, "//") == 0)
+                {
+                    size_t end = m_sText.find('\n', m_nPos);
+                    m_nPos = end == std::string::npos ? m_sText.size() : end + 1;
+                }
+                else if (m_sText.compare(m_nPos, 2, "/*") == 0)
+                {
+                    size_t end = m_sText.find("*/", m_nPos + 2);
+                    m_nPos = end == std::string::npos ? m_sText.size() : end + 2;
+                }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        bool Fail(const std::string &message)
+        {
+            throw std::runtime_error(message + " at offset " + std::to_string(m_nPos));
+        }
+
+        bool Expect(char c)
+        {
+            SkipSpace();
+            if (m_nPos >= m_sText.size() || m_sText[m_nPos] != c)
+            {
+                return Fail(std::string("expected '") + c + "'");
+            }
+            ++m_nPos;
+            return true;
+        }
+
+        std::string ParseString()
+        {
+            Expect('"');
+            std::string value;
+            while (m_nPos < m_sText.size() && m_sText[m_nPos] != '"')
+            {
+                char c = m_sText[m_nPos++];
+                if (c != '\\')
+                {
+                    value += c;
+                    continue;
+                }
+                if (m_nPos >= m_sText.size())
+                {
+                    break;
+                }
+                char escape = m_sText[m_nPos++];
+                switch (escape)
+                {
+                case 'n':
+                    value += '\n';
+                    break;
+                case 't':
+                    value += '\t';
+                    break;
+                case 'r':
+                    value += '\r';
+                    break;
+                case 'b':
+                    value += '\b';
+                    break;
+                case 'f':
+                    value += '\f';
+                    break;
+                case 'u':
+                {
+                    // Code points up to U+FFFF as UTF-8; camera parameters are ASCII in practice
+                    unsigned long code = std::strtoul(m_sText.substr(m_nPos, 4).c_str(), nullptr, 16);
+                    m_nPos += 4;
+                    if (code < 0x80)
+                    {
+                        value += (char)code;
+                    }
+                    else if (code < 0x800)
+                    {
+                        value += (char)(0xC0 | (code >> 6));
+                        value += (char)(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        value += (char)(0xE0 | (code >> 12));
+                        value += (char)(0x80 | ((code >> 6) & 0x3F));
+                        value += (char)(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    value += escape;
+                    break;
+                }
+            }
+            if (m_nPos >= m_sText.size())
+            {
+                Fail("unterminated string");
+            }
+            ++m_nPos;
+            return value;
+        }
+
+    public:
+        explicit JsonParser(const std::string &text) : m_sText(text), m_nPos(0) {}
+
+        JsonValue ParseValue()
+        {
+            SkipSpace();
+            JsonValue value;
+            if (m_nPos >= m_sText.size())
+            {
+                Fail("unexpected end");
+            }
+            char c = m_sText[m_nPos];
+            if (c == '{')
+            {
+                value.type = JsonValue::OBJECT;
+                ++m_nPos;
+                SkipSpace();
+                if (m_nPos < m_sText.size() && m_sText[m_nPos] == '}')
+                {
+                    ++m_nPos;
+                    return value;
+                }
+                while (true)
+                {
+                    SkipSpace();
+                    std::string name = ParseString();
+                    Expect(':');
+                    value.members.push_back(std::make_pair(name, ParseValue()));
+                    SkipSpace();
+                    if (m_nPos < m_sText.size() && m_sText[m_nPos] == ',')
+                    {
+                        ++m_nPos;
+                        continue;
+                    }
+                    Expect('}');
+                    return value;
+                }
+            }
+            if (c == '[')
+            {
+                value.type = JsonValue::ARRAY;
+                ++m_nPos;
+                SkipSpace();
+                if (m_nPos < m_sText.size() && m_sText[m_nPos] == ']')
+                {
+                    ++m_nPos;
+                    return value;
+                }
+                while (true)
+                {
+                    value.items.push_back(ParseValue());
+                    SkipSpace();
+                    if (m_nPos < m_sText.size() && m_sText[m_nPos] == ',')
+                    {
+                        ++m_nPos;
+                        continue;
+                    }
+                    Expect(']');
+                    return value;
+                }
+            }
+            if (c == '"')
+            {
+                value.type = JsonValue::STRING;
+                value.text = ParseString();
+                return value;
+            }
+            for (const char *word : {"true", "false", "null"})
+            {
+                size_t length = std::char_traits<char>::length(word);
+                if (m_sText.compare(m_nPos, length, word) == 0)
+                {
+                    value.type = word[0] == 'n' ? JsonValue::NUL : JsonValue::BOOLEAN;
+                    value.text = word;
+                    m_nPos += length;
+                    return value;
+                }
+            }
+            size_t start = m_nPos;
+            while (m_nPos < m_sText.size() && (std::isdigit((unsigned char)m_sText[m_nPos]) || std::strchr("+-.eE", m_sText[m_nPos])))
+            {
+                ++m_nPos;
+            }
+            if (m_nPos == start)
+            {
+                Fail("unexpected character");
+            }
+            value.type = JsonValue::NUMBER;
+            value.text = m_sText.substr(start, m_nPos - start);
+            return value;
+        }
+
+        void ExpectEnd()
+        {
+            SkipSpace();
+            if (m_nPos != m_sText.size())
+            {
+                Fail("trailing characters");
+            }
+        }
+    };
+
+    int ToInt(const JsonValue *value, int fallback)
+    {
+        return value && value->type == JsonValue::NUMBER ? std::atoi(value->text.c_str()) : fallback;
+    }
+}
+
+bool CACParamsJson::Parse(const std::string &text, std::vector<CustomParams> &params, std::string &error)
+{
+    params.clear();
+    try
+    {
+        JsonParser parser(text);
+        JsonValue root = parser.ParseValue();
+        parser.ExpectEnd();
+
+        // The handles array, either under "parameters" or on its own
+        const JsonValue *handles = root.type == JsonValue::OBJECT ? root.Find("parameters") : &root;
+        if (!handles || handles->type != JsonValue::ARRAY)
+        {
+            error = "no parameters array";
+            return false;
+        }
+        for (const auto &handle : handles->items)
+        {
+            if (handle.type != JsonValue::OBJECT)
+            {
+                continue;
+            }
+            CustomParams stParams;
+            const JsonValue *name = handle.Find("handleName");
+            stParams.handleName = name ? name->text : "";
+            stParams.handleId = ToInt(handle.Find("handleId"), 0);
+
+            const JsonValue *values = handle.Find("handleParametersJson");
+            for (size_t i = 0; values && i < values->items.size(); ++i)
+            {
+                const JsonValue &value = values->items[i];
+                const JsonValue *paramName = value.Find("name");
+                const JsonValue *paramValue = value.Find("value");
+                if (!paramName || !paramValue)
+                {
+                    continue;
+                }
+                // Flags are integers to SetParamaters
+                std::string sValue = paramValue->type == JsonValue::BOOLEAN ? (paramValue->text == "true" ? "1" : "0") : paramValue->text;
+                stParams.handleParametersJson.push_back({ToInt(value.Find("type"), 0), paramName->text, sValue});
+            }
+
+            const JsonValue *regions = handle.Find("ROIs");
+            for (size_t i = 0; regions && i < regions->items.size(); ++i)
+            {
+                const JsonValue &region = regions->items[i];
+                CustomRegion stRegion;
+                stRegion.regionType = ToInt(region.Find("regionType"), 0);
+                const JsonValue *regionName = region.Find("regionName");
+                stRegion.regionName = regionName ? regionName->text : "";
+                const JsonValue *polygon = region.Find("polygon");
+                for (size_t j = 0; polygon && j < polygon->items.size(); ++j)
+                {
+                    stRegion.polygon.push_back(cv::Point(ToInt(polygon->items[j].Find("x"), 0), ToInt(polygon->items[j].Find("y"), 0)));
+                }
+                stParams.ROIs.push_back(stRegion);
+            }
+            params.push_back(stParams);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+        params.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CACParamsJson::Load(const std::string &path, std::vector<CustomParams> &params, std::string &error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return Parse(text.str(), params, error);
+}
+
+void CACParamsJson::Merge(std::vector<CustomParams> &params, const std::vector<CustomParams> &overrides)
+{
+    for (const auto &handle : overrides)
+    {
+        CustomParams *target = nullptr;
+        for (auto &existing : params)
+        {
+            if (existing.handleId == handle.handleId)
+            {
+                target = &existing;
+                break;
+            }
+        }
+        if (!target)
+        {
+            params.push_back(handle);
+            continue;
+        }
+        for (const auto &value : handle.handleParametersJson)
+        {
+            bool bFound = false;
+            for (auto &existing : target->handleParametersJson)
+            {
+                if (existing.name == value.name)
+                {
+                    existing.value = value.value;
+                    bFound = true;
+                }
+            }
+            if (!bFound)
+            {
+                target->handleParametersJson.push_back(value);
+            }
+        }
+        if (!handle.ROIs.empty())
+        {
+            target->ROIs = handle.ROIs;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PARAMS_JSON_H
+#define PARAMS_JSON_H
+#pragma once
+#include <string>
+#include <vector>
+#include "ANSCustomData.h"
+
+// Reads camera parameters written in the JSON layout of the example in ANSCustomData.h: a
+// "parameters" array of handles with their handleParametersJson and ROIs. Values may be numbers or
+// strings and are kept as text; // and /* */ comments are allowed.
+class CACParamsJson
+{
+public:
+    static bool Parse(const std::string &text, std::vector<CustomParams> &params, std::string &error);
+    static bool Load(const std::string &path, std::vector<CustomParams> &params, std::string &error);
+
+    // Applies overrides onto the handles of params with the same handleId: parameters by name, and
+    // the ROIs when the override has any. Handles params does not have are added.
+    static void Merge(std::vector<CustomParams> &params, const std::vector<CustomParams> &overrides);
+};
+
+#endif // PARAMS_JSON_H
@@ -0,0 +1,269 @@
+#include "PhaseEstimator.h"
+#include <iostream>
+#include <cmath>
+
+CACPhaseEstimator::CACPhaseEstimator()
+{
+    m_bEnabled = false;
+    m_dDenseWindowMs = 1500.0;
+    m_dSparseIntervalMs = 1000.0;
+    m_fMinConfidence = 0.6f;
+    m_nDebounceFrames = 2;
+    Reset();
+}
+
+void CACPhaseEstimator::Reset()
+{
+    for (auto &phase : m_vPhases)
+    {
+        phase = PhaseModel();
+    }
+    m_dCycleMs = 0.0;
+    m_dCycleDeviationMs = 0.0;
+    m_nCycleSamples = 0;
+    m_eState = LIGHT_UNKNOWN;
+    m_dPhaseStartMs = 0.0;
+    m_bPhaseStartObserved = false;
+    m_eCandidate = LIGHT_UNKNOWN;
+    m_nCandidateCount = 0;
+    m_dCandidateStartMs = 0.0;
+    m_dLastDetectionMs = -1.0;
+    m_fMismatchPenalty = 1.0f;
+}
+
+bool CACPhaseEstimator::SetParameters(const CustomParams &params)
+{
+    for (const auto &param : params.handleParametersJson)
+    {
+        try
+        {
+            if (param.name == "phasePrediction")
+            {
+                m_bEnabled = (std::stoi(param.value) != 0);
+            }
+            else if (param.name == "lightDenseWindowMs")
+            {
+                m_dDenseWindowMs = (std::max)(0.0, std::stod(param.value));
+            }
+            else if (param.name == "lightSparseIntervalMs")
+            {
+                m_dSparseIntervalMs = (std::max)(0.0, std::stod(param.value));
+            }
+            else if (param.name == "phaseMinConfidence")
+            {
+                m_fMinConfidence = std::stof(param.value);
+            }
+            else if (param.name == "phaseDebounceFrames")
+            {
+                m_nDebounceFrames = (std::max)(1, std::stoi(param.value));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+        }
+    }
+    return true;
+}
+
+void CACPhaseEstimator::Observe(double timestampMs, TrafficLightState state)
+{
+    m_dLastDetectionMs = timestampMs;
+    if (state == LIGHT_UNKNOWN)
+    {
+        return;
+    }
+
+    if (m_eState == LIGHT_UNKNOWN)
+    {
+        // We do not know when this phase started, so its length cannot be learned
+        m_eState = state;
+        m_dPhaseStartMs = timestampMs;
+        m_bPhaseStartObserved = false;
+        return;
+    }
+
+    // A confident prediction that turns out wrong means the plan changed (or is not fixed-time)
+    Prediction prediction = Predict(timestampMs);
+    if (prediction.confidence >= m_fMinConfidence && prediction.state != state)
+    {
+        m_fMismatchPenalty *= 0.5f;
+    }
+    else
+    {
+        m_fMismatchPenalty = (std::min)(1.0f, m_fMismatchPenalty + 0.1f);
+    }
+
+    if (state == m_eState)
+    {
+        m_eCandidate = LIGHT_UNKNOWN;
+        m_nCandidateCount = 0;
+        return;
+    }
+
+    // Debounce: a single misdetection must not split a phase
+    if (state == m_eCandidate)
+    {
+        m_nCandidateCount++;
+    }
+    else
+    {
+        m_eCandidate = state;
+        m_nCandidateCount = 1;
+        m_dCandidateStartMs = timestampMs;
+    }
+    if (m_nCandidateCount >= m_nDebounceFrames)
+    {
+        AcceptTransition(state, m_dCandidateStartMs);
+    }
+}
+
+void CACPhaseEstimator::AcceptTransition(TrafficLightState next, double timestampMs)
+{
+    const double ALPHA = 0.3;
+    PhaseModel &current = m_vPhases[m_eState];
+
+    if (m_bPhaseStartObserved)
+    {
+        double duration = timestampMs - m_dPhaseStartMs;
+        if (current.samples == 0)
+        {
+            current.meanMs = duration;
+            current.deviationMs = 0.0;
+        }
+        else
+        {
+            current.deviationMs = (1.0 - ALPHA) * current.deviationMs + ALPHA * std::fabs(duration - current.meanMs);
+            current.meanMs = (1.0 - ALPHA) * current.meanMs + ALPHA * duration;
+        }
+        current.samples++;
+    }
+    current.next = next;
+
+    // Cycle length: time between two consecutive starts of the same phase
+    PhaseModel &upcoming = m_vPhases[next];
+    if (upcoming.lastEntryMs >= 0.0)
+    {
+        double cycle = timestampMs - upcoming.lastEntryMs;
+        if (m_nCycleSamples == 0)
+        {
+            m_dCycleMs = cycle;
+        }
+        else
+        {
+            m_dCycleDeviationMs = (1.0 - ALPHA) * m_dCycleDeviationMs + ALPHA * std::fabs(cycle - m_dCycleMs);
+            m_dCycleMs = (1.0 - ALPHA) * m_dCycleMs + ALPHA * cycle;
+        }
+        m_nCycleSamples++;
+    }
+    upcoming.lastEntryMs = timestampMs;
+
+    m_eState = next;
+    m_dPhaseStartMs = timestampMs;
+    m_bPhaseStartObserved = true;
+    m_eCandidate = LIGHT_UNKNOWN;
+    m_nCandidateCount = 0;
+}
+
+float CACPhaseEstimator::PhaseConfidence(TrafficLightState state) const
+{
+    const PhaseModel &phase = m_vPhases[state];
+    if (phase.samples == 0 || phase.meanMs <= 0.0)
+    {
+        return 0.0f;
+    }
+    float sampleFactor = (std::min)(1.0f, phase.samples / 3.0f);
+    float spread = (float)(phase.deviationMs / phase.meanMs);
+    return sampleFactor * (std::max)(0.0f, 1.0f - 2.0f * spread) * m_fMismatchPenalty;
+}
+
+float CACPhaseEstimator::CycleConfidence() const
+{
+    if (m_nCycleSamples == 0 || m_dCycleMs <= 0.0)
+    {
+        return 0.0f;
+    }
+    float sampleFactor = (std::min)(1.0f, m_nCycleSamples / 3.0f);
+    float spread = (float)(m_dCycleDeviationMs / m_dCycleMs);
+    return sampleFactor * (std::max)(0.0f, 1.0f - 2.0f * spread) * m_fMismatchPenalty;
+}
+
+CACPhaseEstimator::Prediction CACPhaseEstimator::Predict(double timestampMs) const
+{
+    Prediction prediction;
+    prediction.state = m_eState;
+    if (m_eState == LIGHT_UNKNOWN || !m_bPhaseStartObserved)
+    {
+        return prediction;
+    }
+
+    // Whole cycles past the end of the current phase repeat it; confidence compounds per cycle
+    float confidence = 1.0f;
+    double currentEnd = m_dPhaseStartMs + m_vPhases[m_eState].meanMs;
+    float cycleConfidence = CycleConfidence();
+    if (cycleConfidence > 0.0f && timestampMs >= currentEnd + m_dCycleMs)
+    {
+        double cycles = std::floor((timestampMs - currentEnd) / m_dCycleMs);
+        timestampMs -= cycles * m_dCycleMs;
+        confidence = (float)std::pow(cycleConfidence, cycles);
+    }
+
+    // Walk the learned phase sequence forward from the current phase; confidence compounds per phase
+    TrafficLightState state = m_eState;
+    double phaseStart = m_dPhaseStartMs;
+    for (int step = 0; step < 8; ++step)
+    {
+        const PhaseModel &phase = m_vPhases[state];
+        float phaseConfidence = PhaseConfidence(state);
+        if (phaseConfidence <= 0.0f)
+        {
+            prediction.state = state;
+            prediction.confidence = 0.0f;
+            return prediction;
+        }
+
+        double phaseEnd = phaseStart + phase.meanMs;
+        if (timestampMs < phaseEnd)
+        {
+            prediction.state = state;
+            prediction.confidence = confidence * phaseConfidence;
+            prediction.msToTransition = phaseEnd - timestampMs;
+            return prediction;
+        }
+        if (phase.next == LIGHT_UNKNOWN)
+        {
+            prediction.state = state;
+            prediction.confidence = 0.0f;
+            return prediction;
+        }
+        confidence *= phaseConfidence;
+        phaseStart = phaseEnd;
+        state = phase.next;
+    }
+
+    prediction.state = state;
+    prediction.confidence = 0.0f;
+    return prediction;
+}
+
+bool CACPhaseEstimator::ShouldDetectLight(double timestampMs) const
+{
+    if (!m_bEnabled || m_dLastDetectionMs < 0.0)
+    {
+        return true;
+    }
+
+    Prediction prediction = Predict(timestampMs);
+    if (prediction.confidence < m_fMinConfidence)
+    {
+        return true;
+    }
+
+    // Dense around both ends of the predicted phase, so early and late transitions are caught
+    double elapsed = m_vPhases[prediction.state].meanMs - prediction.msToTransition;
+    if (prediction.msToTransition <= m_dDenseWindowMs || elapsed <= m_dDenseWindowMs)
+    {
+        return true;
+    }
+    return (timestampMs - m_dLastDetectionMs) >= m_dSparseIntervalMs;
+}
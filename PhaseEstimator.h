@@ -0,0 +1,76 @@
+#ifndef PHASE_ESTIMATOR_H
+#define PHASE_ESTIMATOR_H
+#pragma once
+#include <string>
+#include <vector>
+#include "ANSCustomData.h"
+#include "TrafficLight.h"
+
+// Learns a fixed-time signal plan from light observations: the duration of every phase,
+// which phase follows which, and the cycle length. Once the plan is known with enough
+// confidence, light inference only runs densely around predicted transitions and sparsely
+// mid-phase; frames in between get the predicted state instead of a detection. A prediction more
+// than a cycle past the current phase is brought back by whole cycles of the learned length, so
+// the phase walk never has to cover more than one cycle.
+class CACPhaseEstimator
+{
+public:
+    struct Prediction
+    {
+        TrafficLightState state{LIGHT_UNKNOWN};
+        float confidence{0.0f};
+        double msToTransition{0.0}; // Time left in the predicted phase
+    };
+
+private:
+    struct PhaseModel
+    {
+        double meanMs{0.0};
+        double deviationMs{0.0}; // Mean absolute deviation
+        int samples{0};
+        TrafficLightState next{LIGHT_UNKNOWN};
+        double lastEntryMs{-1.0};
+    };
+
+    bool m_bEnabled;
+    double m_dDenseWindowMs;    // Run every frame this close to a predicted transition
+    double m_dSparseIntervalMs; // Otherwise run at most this often
+    float m_fMinConfidence;     // Below this the light is detected on every frame
+    int m_nDebounceFrames;      // Consecutive observations needed to accept a new state
+
+    PhaseModel m_vPhases[4];
+    double m_dCycleMs;
+    double m_dCycleDeviationMs;
+    int m_nCycleSamples;
+
+    TrafficLightState m_eState;
+    double m_dPhaseStartMs;
+    bool m_bPhaseStartObserved; // false while the first phase started before we were watching
+    TrafficLightState m_eCandidate;
+    int m_nCandidateCount;
+    double m_dCandidateStartMs;
+    double m_dLastDetectionMs;
+    float m_fMismatchPenalty;
+
+    void AcceptTransition(TrafficLightState next, double timestampMs);
+    float PhaseConfidence(TrafficLightState state) const;
+    float CycleConfidence() const;
+
+public:
+    CACPhaseEstimator();
+
+    bool SetParameters(const CustomParams &params);
+    bool IsEnabled() const { return m_bEnabled; }
+
+    // Feed the light state detected at timestampMs
+    void Observe(double timestampMs, TrafficLightState state);
+    // Whether light inference should run at timestampMs
+    bool ShouldDetectLight(double timestampMs) const;
+    // State expected at timestampMs with its confidence
+    Prediction Predict(double timestampMs) const;
+
+    double GetCycleMs() const { return m_dCycleMs; }
+    void Reset();
+};
+
+#endif // PHASE_ESTIMATOR_H
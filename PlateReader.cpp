@@ -0,0 +1,259 @@
+#include "PlateReader.h"
+#include <iostream>
+#include "ModelRegistry.h"
+
+CACPlateReader::CACPlateReader()
+{
+    m_bEnabled = false;
+    m_sModelName = "alpr";
+    m_sClassName = "alpr.names";
+    m_nMaxQueue = 8;
+    m_nMaxReadsPerTrack = 3;
+    m_fMinConfidence = 0.8f;
+    m_nCropMargin = 16;
+    m_fThreshold = 0.5f;
+    m_bStopping = false;
+}
+
+CACPlateReader::~CACPlateReader()
+{
+    Stop();
+}
+
+bool CACPlateReader::SetParameters(const CustomParams &params)
+{
+    std::string modelName = m_sModelName;
+    std::string className = m_sClassName;
+    for (const auto &param : params.handleParametersJson)
+    {
+        try
+        {
+            if (param.name == "alpr")
+            {
+                m_bEnabled = (std::stoi(param.value) != 0);
+            }
+            else if (param.name == "alprModelName")
+            {
+                m_sModelName = param.value;
+            }
+            else if (param.name == "alprClassName")
+            {
+                m_sClassName = param.value;
+            }
+            else if (param.name == "alprMaxQueue")
+            {
+                m_nMaxQueue = (std::max)(1, std::stoi(param.value));
+            }
+            else if (param.name == "alprMaxReadsPerTrack")
+            {
+                m_nMaxReadsPerTrack = (std::max)(1, std::stoi(param.value));
+            }
+            else if (param.name == "alprMinConfidence")
+            {
+                m_fMinConfidence = std::stof(param.value);
+            }
+            else if (param.name == "alprCropMargin")
+            {
+                m_nCropMargin = (std::max)(0, std::stoi(param.value));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+        }
+    }
+
+    if (m_cWorker.joinable() && (!m_bEnabled || modelName != m_sModelName || className != m_sClassName))
+    {
+        Stop();
+    }
+    if (!m_sModelDirectory.empty())
+    {
+        Start(m_sModelDirectory, m_fThreshold);
+    }
+    return true;
+}
+
+void CACPlateReader::Start(const std::string &modelDirectory, float threshold)
+{
+    m_sModelDirectory = modelDirectory;
+    m_fThreshold = threshold;
+    if (!m_bEnabled || m_cWorker.joinable())
+    {
+        return;
+    }
+
+    // Shared with every camera using the same ALPR model, loaded off the startup path
+    CACModelRegistry::Key key;
+    key.modelDirectory = modelDirectory;
+    key.modelName = m_sModelName;
+    key.modelType = ALPR;
+    key.precision = "fp32";
+    std::string modelName = m_sModelName;
+    std::string className = m_sClassName;
+    CACDetectorPool::Loader loader = [=](ANSCENTER::ANSLIB &detector, std::string &labelMap)
+    {
+        return detector.LoadModelFromFolder(
+                   "", modelName.c_str(), className.c_str(),
+                   threshold, 0.5f, 0.5f,
+                   1, ALPR, LICENSEPLATE, modelDirectory.c_str(), labelMap) == 1;
+    };
+    m_fDetector = std::async(std::launch::async, [key, loader]()
+                             { return CACModelRegistry::Instance().Acquire(key, 1, loader); })
+                      .share();
+
+    m_bStopping = false;
+    m_cWorker = std::thread(&CACPlateReader::WorkerLoop, this);
+}
+
+void CACPlateReader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_bStopping = true;
+        m_qJobs.clear();
+    }
+    m_cCondition.notify_all();
+    if (m_cWorker.joinable())
+    {
+        m_cWorker.join();
+    }
+}
+
+bool CACPlateReader::NeedsRead(int trackId)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    auto it = m_mPlates.find(trackId);
+    return it != m_mPlates.end() && it->second.reads < m_nMaxReadsPerTrack && it->second.confidence < m_fMinConfidence;
+}
+
+bool CACPlateReader::Request(const cv::Mat &frame, const cv::Rect &box, int trackId, const std::string &cameraId)
+{
+    if (!m_cWorker.joinable())
+    {
+        return false;
+    }
+
+    cv::Rect cropRect(box.x - m_nCropMargin, box.y - m_nCropMargin, box.width + 2 * m_nCropMargin, box.height + 2 * m_nCropMargin);
+    cropRect &= cv::Rect(0, 0, frame.cols, frame.rows);
+    if (cropRect.empty())
+    {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        PlateResult &plate = m_mPlates[trackId];
+        if (plate.reads >= m_nMaxReadsPerTrack || plate.confidence >= m_fMinConfidence)
+        {
+            m_stStats.skipped++;
+            return false;
+        }
+        if ((int)m_qJobs.size() >= m_nMaxQueue)
+        {
+            m_stStats.dropped++;
+            return false;
+        }
+        plate.reads++;
+        plate.lastRequest = now;
+
+        // Forget tracks not requested for a minute, track ids are eventually reused
+        for (auto it = m_mPlates.begin(); it != m_mPlates.end();)
+        {
+            it = (now - it->second.lastRequest > std::chrono::seconds(60)) ? m_mPlates.erase(it) : std::next(it);
+        }
+    }
+
+    // The frame buffer is reused by the caller, so the crop is copied into a pooled buffer
+    Job job;
+    job.crop = CACFramePool::Instance().Acquire(cropRect.size(), frame.type());
+    frame(cropRect).copyTo(job.crop);
+    job.trackId = trackId;
+    job.cameraId = cameraId;
+
+    {
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_qJobs.push_back(std::move(job));
+        m_stStats.queued++;
+    }
+    m_cCondition.notify_one();
+    return true;
+}
+
+bool CACPlateReader::GetPlate(int trackId, PlateResult &result)
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    auto it = m_mPlates.find(trackId);
+    if (it == m_mPlates.end() || it->second.text.empty())
+    {
+        return false;
+    }
+    result = it->second;
+    return true;
+}
+
+CACPlateReader::Stats CACPlateReader::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_cMutex);
+    return m_stStats;
+}
+
+void CACPlateReader::WorkerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_cMutex);
+            m_cCondition.wait(lock, [this]()
+                              { return m_bStopping || !m_qJobs.empty(); });
+            if (m_bStopping)
+            {
+                return;
+            }
+            job = std::move(m_qJobs.front());
+            m_qJobs.pop_front();
+        }
+
+        // Jobs queued while the model loads wait here for it
+        std::shared_ptr<CACDetectorPool> detector = m_fDetector.get();
+        if (!detector)
+        {
+            continue;
+        }
+
+        std::vector<ANSCENTER::Object> plates;
+        try
+        {
+            detector->RunInference(job.crop, job.cameraId, plates);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Plate reader: " << e.what() << std::endl;
+        }
+
+        // The class name is the plate class, the recognised text is in extraInfo; the most confident one wins
+        const ANSCENTER::Object *best = nullptr;
+        for (const auto &plate : plates)
+        {
+            if (!plate.extraInfo.empty() && (!best || plate.confidence > best->confidence))
+            {
+                best = &plate;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_cMutex);
+        m_stStats.reads++;
+        if (best)
+        {
+            m_stStats.plates++;
+            PlateResult &result = m_mPlates[job.trackId];
+            if (best->confidence > result.confidence)
+            {
+                result.text = best->extraInfo;
+                result.confidence = best->confidence;
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef PLATE_READER_H
+#define PLATE_READER_H
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+#include "ANSCustomData.h"
+#include "DetectorPool.h"
+#include "FramePool.h"
+
+// Cascade stage reading the plate of violating vehicles only. The ALPR model is loaded in the
+// background through the model registry, so startup does not wait for it. Violations queue a
+// full-resolution crop of the vehicle (bounded queue, oldest requests kept); a worker thread runs
+// ALPR on them and keeps the most confident plate per track. A track is read at most
+// maxReadsPerTrack times, and not again once a plate above minConfidence is known.
+class CACPlateReader
+{
+public:
+    struct PlateResult
+    {
+        std::string text;
+        float confidence{0.0f};
+        int reads{0}; // Crops queued for this track, read or pending
+        std::chrono::steady_clock::time_point lastRequest;
+    };
+
+    struct Stats
+    {
+        long long queued{0};
+        long long dropped{0}; // Queue full
+        long long skipped{0}; // Track already read enough
+        long long reads{0};   // ALPR inferences
+        long long plates{0};  // Reads that returned a plate
+    };
+
+private:
+    struct Job
+    {
+        cv::Mat crop; // Pooled
+        int trackId{0};
+        std::string cameraId;
+    };
+
+    bool m_bEnabled;
+    std::string m_sModelName;
+    std::string m_sClassName;
+    int m_nMaxQueue;
+    int m_nMaxReadsPerTrack;
+    float m_fMinConfidence;
+    int m_nCropMargin;
+    std::string m_sModelDirectory; // From Start, so SetParameters can start or restart the reader
+    float m_fThreshold;
+
+    std::shared_future<std::shared_ptr<CACDetectorPool>> m_fDetector;
+    std::thread m_cWorker;
+    std::mutex m_cMutex;
+    std::condition_variable m_cCondition;
+    std::deque<Job> m_qJobs;
+    std::map<int, PlateResult> m_mPlates; // By track id
+    bool m_bStopping;
+    Stats m_stStats;
+
+    void WorkerLoop();
+
+public:
+    CACPlateReader();
+    ~CACPlateReader();
+
+    // Once started, turning alpr on or off or changing the model starts, stops or restarts the reader
+    bool SetParameters(const CustomParams &params);
+    bool IsEnabled() const { return m_bEnabled; }
+
+    // Starts loading the ALPR model and the worker; returns immediately
+    void Start(const std::string &modelDirectory, float threshold);
+    void Stop();
+
+    // Queues the vehicle box of frame, which must not carry overlays, for reading; false when the track was read enough or the queue is full
+    bool Request(const cv::Mat &frame, const cv::Rect &box, int trackId, const std::string &cameraId);
+    // Whether the track was queued before (a violator) and still needs reads
+    bool NeedsRead(int trackId);
+    bool GetPlate(int trackId, PlateResult &result);
+    Stats GetStats();
+};
+
+#endif // PLATE_READER_H
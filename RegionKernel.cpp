@@ -0,0 +1,479 @@
+#include "RegionKernel.h"
+#include <random>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CAC_REGION_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CAC_TARGET_AVX2
+#else
+#define CAC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define CAC_REGION_NEON 1
+#include <arm_neon.h>
+#endif
+
+void CACBoxBatch::Assign(const std::vector<ANSCENTER::Object> &objects)
+{
+    size_t count = objects.size();
+    x.resize(count);
+    y.resize(count);
+    width.resize(count);
+    height.resize(count);
+    centerX.resize(count);
+    centerY.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const cv::Rect &box = objects[i].box;
+        x[i] = box.x;
+        y[i] = box.y;
+        width[i] = box.width;
+        height[i] = box.height;
+        centerX[i] = box.x + box.width / 2;
+        centerY[i] = box.y + box.height / 2;
+    }
+}
+
+void CACBoxBatch::Add(const cv::Rect &box)
+{
+    x.push_back(box.x);
+    y.push_back(box.y);
+    width.push_back(box.width);
+    height.push_back(box.height);
+    centerX.push_back(box.x + box.width / 2);
+    centerY.push_back(box.y + box.height / 2);
+}
+
+void CACBoxBatch::Clear()
+{
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+    centerX.clear();
+    centerY.clear();
+}
+
+// Crossing number with a ray towards +x. For the edge (x1, y1) -> (x2, y2):
+//   cross = dx * (py - y1) - dy * (px - x1)
+// is zero when the point lies on the edge's line; the point is on the edge when it is also inside
+// the edge's bounding box. When the edge straddles py, the ray crosses it iff cross has the sign of dy.
+
+static inline bool ContainsScalar(const std::vector<cv::Point> &polygon, int px, int py)
+{
+    size_t count = polygon.size();
+    bool parity = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const cv::Point &a = polygon[i];
+        const cv::Point &b = polygon[(i + 1) % count];
+        int dx = b.x - a.x;
+        int dy = b.y - a.y;
+        int cross = dx * (py - a.y) - dy * (px - a.x);
+        if (cross == 0 && px >= (std::min)(a.x, b.x) && px <= (std::max)(a.x, b.x) &&
+            py >= (std::min)(a.y, b.y) && py <= (std::max)(a.y, b.y))
+        {
+            return true;
+        }
+        bool straddle = (a.y > py) != (b.y > py);
+        if (straddle && ((dy > 0) ? (cross > 0) : (cross < 0)))
+        {
+            parity = !parity;
+        }
+    }
+    return parity;
+}
+
+static void ClassifyCentresScalar(const CACBoxBatch &batch, size_t begin, const std::vector<cv::Point> &polygon,
+                                  unsigned int bit, std::vector<unsigned int> &masks)
+{
+    for (size_t i = begin; i < batch.Size(); ++i)
+    {
+        if (ContainsScalar(polygon, batch.centerX[i], batch.centerY[i]))
+        {
+            masks[i] |= bit;
+        }
+    }
+}
+
+static inline bool OverlapsScalar(int x, int y, int width, int height, const cv::Rect &rect)
+{
+    // Non-empty intersection of [x, x + width) and [rect.x, rect.x + rect.width), same for y
+    return width > 0 && height > 0 && rect.width > 0 && rect.height > 0 &&
+           x < rect.x + rect.width && rect.x < x + width &&
+           y < rect.y + rect.height && rect.y < y + height;
+}
+
+static void ClassifyOverlapsScalar(const CACBoxBatch &batch, size_t begin, const cv::Rect &rect,
+                                   unsigned int bit, std::vector<unsigned int> &masks)
+{
+    for (size_t i = begin; i < batch.Size(); ++i)
+    {
+        if (OverlapsScalar(batch.x[i], batch.y[i], batch.width[i], batch.height[i], rect))
+        {
+            masks[i] |= bit;
+        }
+    }
+}
+
+#ifdef CAC_REGION_X86
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    // The OS must save the YMM registers
+    return osxsave && avx && avx2 && ((_xgetbv(0) & 6) == 6);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+CAC_TARGET_AVX2 static size_t ClassifyCentresAVX2(const CACBoxBatch &batch, const std::vector<cv::Point> &polygon,
+                                                  unsigned int bit, std::vector<unsigned int> &masks)
+{
+    size_t count = polygon.size();
+    size_t lanes = batch.Size() / 8 * 8;
+    const __m256i zero = _mm256_setzero_si256();
+    for (size_t i = 0; i < lanes; i += 8)
+    {
+        __m256i px = _mm256_loadu_si256((const __m256i *)&batch.centerX[i]);
+        __m256i py = _mm256_loadu_si256((const __m256i *)&batch.centerY[i]);
+        __m256i parity = zero;
+        __m256i onEdge = zero;
+        for (size_t e = 0; e < count; ++e)
+        {
+            const cv::Point &a = polygon[e];
+            const cv::Point &b = polygon[(e + 1) % count];
+            __m256i ax = _mm256_set1_epi32(a.x);
+            __m256i ay = _mm256_set1_epi32(a.y);
+            __m256i by = _mm256_set1_epi32(b.y);
+            __m256i cross = _mm256_sub_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(b.x - a.x), _mm256_sub_epi32(py, ay)),
+                                             _mm256_mullo_epi32(_mm256_set1_epi32(b.y - a.y), _mm256_sub_epi32(px, ax)));
+
+            // On the edge: cross == 0 and inside the edge's bounding box
+            __m256i outside = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32((std::min)(a.x, b.x)), px),
+                                _mm256_cmpgt_epi32(px, _mm256_set1_epi32((std::max)(a.x, b.x)))),
+                _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32((std::min)(a.y, b.y)), py),
+                                _mm256_cmpgt_epi32(py, _mm256_set1_epi32((std::max)(a.y, b.y)))));
+            onEdge = _mm256_or_si256(onEdge, _mm256_andnot_si256(outside, _mm256_cmpeq_epi32(cross, zero)));
+
+            __m256i straddle = _mm256_xor_si256(_mm256_cmpgt_epi32(ay, py), _mm256_cmpgt_epi32(by, py));
+            __m256i crossing = (b.y > a.y) ? _mm256_cmpgt_epi32(cross, zero) : _mm256_cmpgt_epi32(zero, cross);
+            parity = _mm256_xor_si256(parity, _mm256_and_si256(straddle, crossing));
+        }
+
+        int inside = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(onEdge, parity)));
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            if (inside & (1 << lane))
+            {
+                masks[i + lane] |= bit;
+            }
+        }
+    }
+    return lanes;
+}
+
+CAC_TARGET_AVX2 static size_t ClassifyOverlapsAVX2(const CACBoxBatch &batch, const cv::Rect &rect,
+                                                   unsigned int bit, std::vector<unsigned int> &masks)
+{
+    if (rect.width <= 0 || rect.height <= 0)
+    {
+        return batch.Size();
+    }
+    size_t lanes = batch.Size() / 8 * 8;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i rx = _mm256_set1_epi32(rect.x);
+    __m256i ry = _mm256_set1_epi32(rect.y);
+    __m256i rx2 = _mm256_set1_epi32(rect.x + rect.width);
+    __m256i ry2 = _mm256_set1_epi32(rect.y + rect.height);
+    for (size_t i = 0; i < lanes; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&batch.x[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&batch.y[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&batch.width[i]);
+        __m256i h = _mm256_loadu_si256((const __m256i *)&batch.height[i]);
+        __m256i overlap = _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero));
+        overlap = _mm256_and_si256(overlap, _mm256_cmpgt_epi32(rx2, x));
+        overlap = _mm256_and_si256(overlap, _mm256_cmpgt_epi32(_mm256_add_epi32(x, w), rx));
+        overlap = _mm256_and_si256(overlap, _mm256_cmpgt_epi32(ry2, y));
+        overlap = _mm256_and_si256(overlap, _mm256_cmpgt_epi32(_mm256_add_epi32(y, h), ry));
+
+        int result = _mm256_movemask_ps(_mm256_castsi256_ps(overlap));
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            if (result & (1 << lane))
+            {
+                masks[i + lane] |= bit;
+            }
+        }
+    }
+    return lanes;
+}
+#endif
+
+#ifdef CAC_REGION_NEON
+static size_t ClassifyCentresNEON(const CACBoxBatch &batch, const std::vector<cv::Point> &polygon,
+                                  unsigned int bit, std::vector<unsigned int> &masks)
+{
+    size_t count = polygon.size();
+    size_t lanes = batch.Size() / 4 * 4;
+    const int32x4_t zero = vdupq_n_s32(0);
+    for (size_t i = 0; i < lanes; i += 4)
+    {
+        int32x4_t px = vld1q_s32(&batch.centerX[i]);
+        int32x4_t py = vld1q_s32(&batch.centerY[i]);
+        uint32x4_t parity = vdupq_n_u32(0);
+        uint32x4_t onEdge = vdupq_n_u32(0);
+        for (size_t e = 0; e < count; ++e)
+        {
+            const cv::Point &a = polygon[e];
+            const cv::Point &b = polygon[(e + 1) % count];
+            int32x4_t cross = vsubq_s32(vmulq_s32(vdupq_n_s32(b.x - a.x), vsubq_s32(py, vdupq_n_s32(a.y))),
+                                        vmulq_s32(vdupq_n_s32(b.y - a.y), vsubq_s32(px, vdupq_n_s32(a.x))));
+
+            uint32x4_t within = vandq_u32(
+                vandq_u32(vcgeq_s32(px, vdupq_n_s32((std::min)(a.x, b.x))), vcleq_s32(px, vdupq_n_s32((std::max)(a.x, b.x)))),
+                vandq_u32(vcgeq_s32(py, vdupq_n_s32((std::min)(a.y, b.y))), vcleq_s32(py, vdupq_n_s32((std::max)(a.y, b.y)))));
+            onEdge = vorrq_u32(onEdge, vandq_u32(within, vceqq_s32(cross, zero)));
+
+            uint32x4_t straddle = veorq_u32(vcgtq_s32(vdupq_n_s32(a.y), py), vcgtq_s32(vdupq_n_s32(b.y), py));
+            uint32x4_t crossing = (b.y > a.y) ? vcgtq_s32(cross, zero) : vcltq_s32(cross, zero);
+            parity = veorq_u32(parity, vandq_u32(straddle, crossing));
+        }
+
+        uint32_t inside[4];
+        vst1q_u32(inside, vorrq_u32(onEdge, parity));
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            if (inside[lane])
+            {
+                masks[i + lane] |= bit;
+            }
+        }
+    }
+    return lanes;
+}
+
+static size_t ClassifyOverlapsNEON(const CACBoxBatch &batch, const cv::Rect &rect,
+                                   unsigned int bit, std::vector<unsigned int> &masks)
+{
+    if (rect.width <= 0 || rect.height <= 0)
+    {
+        return batch.Size();
+    }
+    size_t lanes = batch.Size() / 4 * 4;
+    const int32x4_t zero = vdupq_n_s32(0);
+    int32x4_t rx = vdupq_n_s32(rect.x);
+    int32x4_t ry = vdupq_n_s32(rect.y);
+    int32x4_t rx2 = vdupq_n_s32(rect.x + rect.width);
+    int32x4_t ry2 = vdupq_n_s32(rect.y + rect.height);
+    for (size_t i = 0; i < lanes; i += 4)
+    {
+        int32x4_t x = vld1q_s32(&batch.x[i]);
+        int32x4_t y = vld1q_s32(&batch.y[i]);
+        int32x4_t w = vld1q_s32(&batch.width[i]);
+        int32x4_t h = vld1q_s32(&batch.height[i]);
+        uint32x4_t overlap = vandq_u32(vcgtq_s32(w, zero), vcgtq_s32(h, zero));
+        overlap = vandq_u32(overlap, vcgtq_s32(rx2, x));
+        overlap = vandq_u32(overlap, vcgtq_s32(vaddq_s32(x, w), rx));
+        overlap = vandq_u32(overlap, vcgtq_s32(ry2, y));
+        overlap = vandq_u32(overlap, vcgtq_s32(vaddq_s32(y, h), ry));
+
+        uint32_t result[4];
+        vst1q_u32(result, overlap);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            if (result[lane])
+            {
+                masks[i + lane] |= bit;
+            }
+        }
+    }
+    return lanes;
+}
+#endif
+
+CACRegionKernel::Backend CACRegionKernel::GetBestBackend()
+{
+#if defined(CAC_REGION_X86)
+    static const Backend backend = CpuHasAVX2() ? BACKEND_AVX2 : BACKEND_SCALAR;
+    return backend;
+#elif defined(CAC_REGION_NEON)
+    return BACKEND_NEON;
+#else
+    return BACKEND_SCALAR;
+#endif
+}
+
+void CACRegionKernel::ClassifyCentres(const CACBoxBatch &batch, const std::vector<std::vector<cv::Point>> &polygons,
+                                      std::vector<unsigned int> &masks, Backend backend)
+{
+    masks.assign(batch.Size(), 0u);
+    if (backend == BACKEND_AUTO || (backend != BACKEND_SCALAR && backend != GetBestBackend()))
+    {
+        // Unavailable instruction sets fall back to what this CPU supports
+        backend = GetBestBackend();
+    }
+
+    size_t regions = (std::min)(polygons.size(), (size_t)MAX_REGIONS);
+    for (size_t r = 0; r < regions; ++r)
+    {
+        const std::vector<cv::Point> &polygon = polygons[r];
+        if (polygon.empty())
+        {
+            continue;
+        }
+        unsigned int bit = 1u << r;
+        size_t done = 0;
+#ifdef CAC_REGION_X86
+        if (backend == BACKEND_AVX2)
+        {
+            done = ClassifyCentresAVX2(batch, polygon, bit, masks);
+        }
+#endif
+#ifdef CAC_REGION_NEON
+        if (backend == BACKEND_NEON)
+        {
+            done = ClassifyCentresNEON(batch, polygon, bit, masks);
+        }
+#endif
+        // Tail (or everything without SIMD)
+        ClassifyCentresScalar(batch, done, polygon, bit, masks);
+    }
+}
+
+void CACRegionKernel::ClassifyOverlaps(const CACBoxBatch &batch, const std::vector<cv::Rect> &rects,
+                                       std::vector<unsigned int> &masks, Backend backend)
+{
+    masks.assign(batch.Size(), 0u);
+    if (backend == BACKEND_AUTO || (backend != BACKEND_SCALAR && backend != GetBestBackend()))
+    {
+        // Unavailable instruction sets fall back to what this CPU supports
+        backend = GetBestBackend();
+    }
+
+    size_t regions = (std::min)(rects.size(), (size_t)MAX_REGIONS);
+    for (size_t r = 0; r < regions; ++r)
+    {
+        unsigned int bit = 1u << r;
+        size_t done = 0;
+#ifdef CAC_REGION_X86
+        if (backend == BACKEND_AVX2)
+        {
+            done = ClassifyOverlapsAVX2(batch, rects[r], bit, masks);
+        }
+#endif
+#ifdef CAC_REGION_NEON
+        if (backend == BACKEND_NEON)
+        {
+            done = ClassifyOverlapsNEON(batch, rects[r], bit, masks);
+        }
+#endif
+        ClassifyOverlapsScalar(batch, done, rects[r], bit, masks);
+    }
+}
+
+bool CACRegionKernel::ContainsPoint(const std::vector<cv::Point> &polygon, const cv::Point &point)
+{
+    return !polygon.empty() && ContainsScalar(polygon, point.x, point.y);
+}
+
+bool CACRegionKernel::SelfCheck(int rounds, unsigned int seed)
+{
+    std::mt19937 random(seed);
+    auto uniform = [&random](int low, int high)
+    { return std::uniform_int_distribution<int>(low, high)(random); };
+    Backend best = GetBestBackend();
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        // Star-shaped polygons are simple, so OpenCV's test is a valid reference; small coordinates
+        // put many centres exactly on edges and vertices
+        int range = (round % 2 == 0) ? 40 : 2000;
+        std::vector<std::vector<cv::Point>> polygons(uniform(1, 4));
+        std::vector<cv::Rect> rects(uniform(1, 4));
+        for (auto &polygon : polygons)
+        {
+            cv::Point centre(uniform(-range, range), uniform(-range, range));
+            std::vector<double> angles(uniform(3, 12));
+            for (auto &angle : angles)
+            {
+                angle = std::uniform_real_distribution<double>(0.0, 2.0 * CV_PI)(random);
+            }
+            std::sort(angles.begin(), angles.end());
+            for (double angle : angles)
+            {
+                int radius = uniform(1, range);
+                polygon.push_back(centre + cv::Point((int)std::lround(radius * std::cos(angle)), (int)std::lround(radius * std::sin(angle))));
+            }
+        }
+        for (auto &rect : rects)
+        {
+            rect = cv::Rect(uniform(-range, range), uniform(-range, range), uniform(0, range), uniform(0, range));
+        }
+
+        // Batch sizes around the SIMD widths exercise the scalar tails
+        std::vector<ANSCENTER::Object> objects(uniform(0, 37));
+        for (auto &obj : objects)
+        {
+            obj.box = cv::Rect(uniform(-range, range), uniform(-range, range), uniform(0, range), uniform(0, range));
+        }
+        CACBoxBatch batch(objects);
+
+        std::vector<unsigned int> scalarCentres;
+        std::vector<unsigned int> bestCentres;
+        std::vector<unsigned int> scalarOverlaps;
+        std::vector<unsigned int> bestOverlaps;
+        ClassifyCentres(batch, polygons, scalarCentres, BACKEND_SCALAR);
+        ClassifyCentres(batch, polygons, bestCentres, best);
+        ClassifyOverlaps(batch, rects, scalarOverlaps, BACKEND_SCALAR);
+        ClassifyOverlaps(batch, rects, bestOverlaps, best);
+
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            unsigned int centres = 0u;
+            cv::Point centre(batch.centerX[i], batch.centerY[i]);
+            for (size_t r = 0; r < polygons.size(); ++r)
+            {
+                if (cv::pointPolygonTest(polygons[r], centre, false) >= 0)
+                {
+                    centres |= 1u << r;
+                }
+            }
+            unsigned int overlaps = 0u;
+            for (size_t r = 0; r < rects.size(); ++r)
+            {
+                if ((objects[i].box & rects[r]).area() > 0)
+                {
+                    overlaps |= 1u << r;
+                }
+            }
+            if (scalarCentres[i] != centres || bestCentres[i] != centres || scalarOverlaps[i] != overlaps || bestOverlaps[i] != overlaps)
+            {
+                std::cerr << "Region kernel self-check, round " << round << ", box " << objects[i].box << ": centres "
+                          << scalarCentres[i] << "/" << bestCentres[i] << " expected " << centres << ", overlaps "
+                          << scalarOverlaps[i] << "/" << bestOverlaps[i] << " expected " << overlaps
+                          << " (scalar/backend " << best << ")" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
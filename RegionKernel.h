@@ -0,0 +1,62 @@
+#ifndef REGION_KERNEL_H
+#define REGION_KERNEL_H
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Boxes of one frame in structure-of-arrays layout, so a kernel can load 4/8 boxes per instruction.
+// Centres are computed like the rest of the code: x + width / 2, y + height / 2 (integer division).
+struct CACBoxBatch
+{
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> width;
+    std::vector<int> height;
+    std::vector<int> centerX;
+    std::vector<int> centerY;
+
+    CACBoxBatch() {}
+    explicit CACBoxBatch(const std::vector<ANSCENTER::Object> &objects) { Assign(objects); }
+    void Assign(const std::vector<ANSCENTER::Object> &objects);
+    void Add(const cv::Rect &box);
+    void Clear();
+    size_t Size() const { return x.size(); }
+};
+
+// Classifies every box of a batch against every region of a camera in one pass. Bit r of
+// masks[i] is set when box i matches region r (up to 32 regions). The work is dispatched to
+// AVX2 (checked at run time) or NEON when available; the scalar path uses the same integer
+// arithmetic and gives identical masks. Coordinates must stay within +/-16384 pixels.
+class CACRegionKernel
+{
+public:
+    enum Backend
+    {
+        BACKEND_AUTO = 0,
+        BACKEND_SCALAR = 1,
+        BACKEND_AVX2 = 2,
+        BACKEND_NEON = 3
+    };
+
+    static const int MAX_REGIONS = 32;
+
+    // Centre inside the polygon or on its border, same as cv::pointPolygonTest(..., false) >= 0
+    static void ClassifyCentres(const CACBoxBatch &batch, const std::vector<std::vector<cv::Point>> &polygons,
+                                std::vector<unsigned int> &masks, Backend backend = BACKEND_AUTO);
+    // Box overlaps the rectangle with a non-empty intersection, same as (box & rect).area() > 0
+    static void ClassifyOverlaps(const CACBoxBatch &batch, const std::vector<cv::Rect> &rects,
+                                 std::vector<unsigned int> &masks, Backend backend = BACKEND_AUTO);
+
+    // Single point, scalar path
+    static bool ContainsPoint(const std::vector<cv::Point> &polygon, const cv::Point &point);
+
+    static Backend GetBestBackend();
+
+    // Runs both classifications on random star-shaped polygons, rectangles and boxes with the scalar
+    // path, the best SIMD backend and OpenCV, and reports the first disagreement on stderr. Debug
+    // builds run it once when the vehicle detector initialises.
+    static bool SelfCheck(int rounds = 200, unsigned int seed = 1);
+};
+
+#endif // REGION_KERNEL_H
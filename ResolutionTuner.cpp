@@ -0,0 +1,273 @@
+#include "ResolutionTuner.h"
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <tuple>
+
+CACResolutionTuner::CACResolutionTuner()
+{
+    m_bEnabled = false;
+    m_vConfigured = {320, 480, 640, 960, 1280};
+    m_vLadder = {m_vConfigured.back()};
+    m_nMinObjectPx = 16;
+    m_fPercentile = 0.05f;
+    m_nWindow = 500;
+    m_dIntervalMs = 30000.0;
+    m_fMaxCountDrop = 0.2f;
+    m_nHoldDecisions = 5;
+    m_nMaxSide = 0;
+
+    m_nRung = (int)m_vLadder.size() - 1;
+    m_nHold = 0;
+    m_dLastDecisionMs = 0.0;
+    m_nFrames = 0;
+    m_nBoxes = 0;
+    m_dConfidenceSum = 0.0;
+    m_bCheckStepDown = false;
+    m_fBoxesBeforeStep = 0.0f;
+    m_fConfidenceBeforeStep = 0.0f;
+    m_stStats.inputSide = m_vLadder.back();
+}
+
+bool CACResolutionTuner::SetParameters(const CustomParams &params)
+{
+    auto settings = std::make_tuple(m_bEnabled, m_vConfigured, m_nMinObjectPx, m_fPercentile, m_nWindow, m_dIntervalMs, m_fMaxCountDrop,
+                                    m_nHoldDecisions);
+    for (const auto &param : params.handleParametersJson)
+    {
+        try
+        {
+            if (param.name == "resolutionTuning")
+            {
+                m_bEnabled = (std::stoi(param.value) != 0);
+            }
+            else if (param.name == "resolutionLadder")
+            {
+                std::vector<int> ladder;
+                std::stringstream ss(param.value);
+                std::string rung;
+                while (std::getline(ss, rung, ','))
+                {
+                    ladder.push_back((std::max)(32, std::stoi(rung)));
+                }
+                if (!ladder.empty())
+                {
+                    std::sort(ladder.begin(), ladder.end());
+                    ladder.erase(std::unique(ladder.begin(), ladder.end()), ladder.end());
+                    m_vConfigured = ladder;
+                }
+            }
+            else if (param.name == "minObjectPx")
+            {
+                m_nMinObjectPx = (std::max)(1, std::stoi(param.value));
+            }
+            else if (param.name == "tuningPercentile")
+            {
+                m_fPercentile = (std::min)(1.0f, (std::max)(0.0f, std::stof(param.value)));
+            }
+            else if (param.name == "tuningWindow")
+            {
+                m_nWindow = (std::max)(1, std::stoi(param.value));
+            }
+            else if (param.name == "tuningIntervalSec")
+            {
+                m_dIntervalMs = (std::max)(1, std::stoi(param.value)) * 1000.0;
+            }
+            else if (param.name == "tuningMaxCountDrop")
+            {
+                m_fMaxCountDrop = (std::min)(1.0f, (std::max)(0.0f, std::stof(param.value)));
+            }
+            else if (param.name == "tuningHoldDecisions")
+            {
+                m_nHoldDecisions = (std::max)(0, std::stoi(param.value));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+        }
+    }
+
+    // Only a new ladder or new thresholds start again from full resolution; the parameters are
+    // applied again whenever any of the camera's settings change
+    if (settings != std::make_tuple(m_bEnabled, m_vConfigured, m_nMinObjectPx, m_fPercentile, m_nWindow, m_dIntervalMs, m_fMaxCountDrop,
+                                    m_nHoldDecisions))
+    {
+        if (std::get<1>(settings) != m_vConfigured)
+        {
+            // Until the engines of the new rungs are known
+            m_vLadder = {m_vConfigured.back()};
+        }
+        Reset();
+    }
+    return true;
+}
+
+void CACResolutionTuner::SetUsableSides(const std::vector<int> &sides)
+{
+    std::vector<int> ladder;
+    for (int side : m_vConfigured)
+    {
+        if (side == m_vConfigured.back() || std::find(sides.begin(), sides.end(), side) != sides.end())
+        {
+            ladder.push_back(side);
+        }
+    }
+    if (ladder != m_vLadder)
+    {
+        m_vLadder = ladder;
+        Reset();
+    }
+}
+
+void CACResolutionTuner::Reset()
+{
+    m_nRung = (int)m_vLadder.size() - 1;
+    m_nHold = 0;
+    m_qSides.clear();
+    m_dLastDecisionMs = 0.0;
+    m_nFrames = 0;
+    m_nBoxes = 0;
+    m_dConfidenceSum = 0.0;
+    m_bCheckStepDown = false;
+    m_stStats.inputSide = m_vLadder.back();
+}
+
+int CACResolutionTuner::CapSide(const std::vector<int> &ladder, int side, int maxSide)
+{
+    if (maxSide <= 0 || side <= maxSide || ladder.empty())
+    {
+        return side;
+    }
+    int capped = ladder.front();
+    for (int rung : ladder)
+    {
+        if (rung <= maxSide)
+        {
+            capped = rung;
+        }
+    }
+    return (std::min)(capped, side);
+}
+
+int CACResolutionTuner::GetInputSide() const
+{
+    return m_bEnabled ? CapSide(m_vLadder, m_vLadder[m_nRung], m_nMaxSide) : 0;
+}
+
+int CACResolutionTuner::GetTunedSide() const
+{
+    return m_bEnabled ? m_vLadder[m_nRung] : 0;
+}
+
+void CACResolutionTuner::Observe(const std::vector<ANSCENTER::Object> &detections, int regionSide, double nowMs, const std::string &cameraId)
+{
+    if (!m_bEnabled || regionSide <= 0)
+    {
+        return;
+    }
+    if (m_dLastDecisionMs == 0.0)
+    {
+        m_dLastDecisionMs = nowMs;
+    }
+
+    m_nFrames++;
+    for (const auto &obj : detections)
+    {
+        int side = (std::min)(obj.box.width, obj.box.height);
+        if (side > 0)
+        {
+            m_qSides.push_back((float)side);
+            m_nBoxes++;
+            m_dConfidenceSum += obj.confidence;
+        }
+    }
+    while ((int)m_qSides.size() > m_nWindow)
+    {
+        m_qSides.pop_front();
+    }
+
+    if (nowMs - m_dLastDecisionMs >= m_dIntervalMs)
+    {
+        m_dLastDecisionMs = nowMs;
+        Decide(regionSide, cameraId);
+    }
+}
+
+void CACResolutionTuner::Decide(int regionSide, const std::string &cameraId)
+{
+    int top = (int)m_vLadder.size() - 1;
+    int previous = m_nRung;
+    float boxesPerFrame = m_nFrames > 0 ? (float)m_nBoxes / m_nFrames : 0.0f;
+    float meanConfidence = m_nBoxes > 0 ? (float)(m_dConfidenceSum / m_nBoxes) : 0.0f;
+    m_nFrames = 0;
+    m_nBoxes = 0;
+    m_dConfidenceSum = 0.0;
+    m_stStats.decisions++;
+    m_stStats.boxesPerFrame = boxesPerFrame;
+    m_stStats.meanConfidence = meanConfidence;
+
+    const char *reason = "";
+    bool reverted = false;
+    if (m_bCheckStepDown)
+    {
+        m_bCheckStepDown = false;
+        if (boxesPerFrame < m_fBoxesBeforeStep * (1.0f - m_fMaxCountDrop) ||
+            meanConfidence < m_fConfidenceBeforeStep * (1.0f - m_fMaxCountDrop))
+        {
+            // Sides seen at the lower rung miss the objects it lost, start the window again
+            m_nRung = (std::min)(m_nRung + 1, top);
+            m_nHold = m_nHoldDecisions;
+            m_qSides.clear();
+            m_stStats.reverts++;
+            reverted = true;
+            reason = " (reverted, fewer or less confident vehicles)";
+        }
+    }
+
+    if (!reverted && !m_qSides.empty())
+    {
+        std::vector<float> sides(m_qSides.begin(), m_qSides.end());
+        size_t index = (size_t)(m_fPercentile * (sides.size() - 1));
+        std::nth_element(sides.begin(), sides.begin() + index, sides.end());
+        m_stStats.smallSidePx = sides[index];
+
+        int target = top;
+        for (int rung = 0; rung <= top; ++rung)
+        {
+            double scale = (double)(std::min)(m_vLadder[rung], regionSide) / regionSide;
+            if (m_stStats.smallSidePx * scale >= m_nMinObjectPx)
+            {
+                target = rung;
+                break;
+            }
+        }
+
+        if (target > m_nRung)
+        {
+            m_nRung = target;
+        }
+        else if (target < m_nRung && m_nHold == 0)
+        {
+            m_fBoxesBeforeStep = boxesPerFrame;
+            m_fConfidenceBeforeStep = meanConfidence;
+            m_bCheckStepDown = true;
+            m_nRung--;
+        }
+        else if (m_nHold > 0)
+        {
+            m_nHold--;
+        }
+    }
+
+    m_stStats.inputSide = m_vLadder[m_nRung];
+    if (m_nRung != previous)
+    {
+        m_stStats.changes++;
+    }
+    double scale = (double)(std::min)(m_vLadder[m_nRung], regionSide) / regionSide;
+    std::cout << "Resolution tuner " << cameraId << ": " << m_vLadder[previous] << " -> " << m_vLadder[m_nRung] << " px" << reason
+              << " | smallest side p" << (int)(m_fPercentile * 100) << " " << m_stStats.smallSidePx << " px ("
+              << m_stStats.smallSidePx * scale << " px at input), " << boxesPerFrame << " vehicles/frame, confidence "
+              << meanConfidence << std::endl;
+}
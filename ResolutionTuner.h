@@ -0,0 +1,89 @@
+#ifndef RESOLUTION_TUNER_H
+#define RESOLUTION_TUNER_H
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+#include "ANSCustomData.h"
+
+// Per-camera choice of the vehicle detector input resolution. The smallest side of the boxes found
+// inside the DetectArea is collected over a sliding window; at every decision the smallest rung of
+// the ladder at which the low percentile of those sides is still minObjectPx pixels is chosen.
+// Steps up are taken at once, steps down one rung at a time; a step down is reverted when the
+// vehicles per frame or their confidence drop afterwards (objects lost to the lower resolution
+// never show up in the statistics themselves), and the next step down waits a few decisions.
+// The engines take a fixed input size, so a rung below the top is only usable when an engine was
+// built for that side (see CACVehicle); the others are left out of the ladder. Those engines track
+// the camera separately, so on a rung change CACVehicle carries its track ids over by overlap.
+// The budget governor may cap the side; the cap is mapped onto the usable rungs.
+class CACResolutionTuner
+{
+public:
+    struct Stats
+    {
+        int inputSide{0};         // Current rung
+        long long decisions{0};
+        long long changes{0};
+        long long reverts{0};
+        float smallSidePx{0.0f};  // Percentile of the smallest box side at full resolution
+        float boxesPerFrame{0.0f};
+        float meanConfidence{0.0f};
+    };
+
+private:
+    bool m_bEnabled;
+    std::vector<int> m_vConfigured; // resolutionLadder, ascending
+    std::vector<int> m_vLadder;     // The usable rungs of it, the top one always
+    int m_nMinObjectPx;             // Smallest box side the detector must still see
+    float m_fPercentile;            // Fraction of boxes allowed below minObjectPx
+    int m_nWindow;                  // Box sides kept for the percentile
+    double m_dIntervalMs;           // Time between decisions
+    float m_fMaxCountDrop;          // Drop of boxes per frame after a step down that reverts it
+    int m_nHoldDecisions;           // Decisions without step down after a revert
+    int m_nMaxSide;                 // Limit set by the budget governor, 0 for none
+
+    int m_nRung;
+    int m_nHold;
+    std::deque<float> m_qSides;
+    double m_dLastDecisionMs;
+    long long m_nFrames;
+    long long m_nBoxes;
+    double m_dConfidenceSum;
+
+    // Accuracy proxies of the interval before the last step down, compared after it
+    bool m_bCheckStepDown;
+    float m_fBoxesBeforeStep;
+    float m_fConfidenceBeforeStep;
+    Stats m_stStats;
+
+    void Decide(int regionSide, const std::string &cameraId);
+    void Reset();
+
+public:
+    CACResolutionTuner();
+
+    // The statistics and the current rung are kept unless the tuner's own settings change
+    bool SetParameters(const CustomParams &params);
+    bool IsEnabled() const { return m_bEnabled; }
+    const std::vector<int> &GetConfiguredLadder() const { return m_vConfigured; }
+    // Rungs below the top that have an engine
+    void SetUsableSides(const std::vector<int> &sides);
+
+    // Largest side the detector may run at, 0 for no limit
+    void SetMaxSide(int maxSide) { m_nMaxSide = maxSide; }
+    // The largest rung of ladder at or below maxSide, the lowest one when none is; side when within it
+    static int CapSide(const std::vector<int> &ladder, int side, int maxSide);
+
+    // Input side of the current rung within the limit, 0 while disabled
+    int GetInputSide() const;
+    // Input side of the current rung without the limit, 0 while disabled
+    int GetTunedSide() const;
+    const std::vector<int> &GetLadder() const { return m_vLadder; }
+    // Detections of one detector run in frame coordinates, after the DetectArea filter
+    void Observe(const std::vector<ANSCENTER::Object> &detections, int regionSide, double nowMs, const std::string &cameraId);
+    Stats GetStats() const { return m_stStats; }
+};
+
+#endif // RESOLUTION_TUNER_H
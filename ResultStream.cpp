@@ -0,0 +1,279 @@
+#include "ResultStream.h"
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+static_assert(sizeof(CACResultStream::Record) == 64, "Result records are one cache line");
+static_assert(sizeof(CACResultStream::FrameRecord) <= 40 && sizeof(CACResultStream::DetectionRecord) <= 40 &&
+                  sizeof(CACResultStream::LightRecord) <= 40 && sizeof(CACResultStream::ViolationRecord) <= 40,
+              "Record payloads fit the 40 bytes after the common fields");
+
+static const uint16_t NO_CAMERA = 0xFFFF;
+
+// The records start on their own cache line after the header
+static size_t AlignBlock(size_t bytes)
+{
+    return (bytes + 63) & ~(size_t)63;
+}
+
+CACResultStream::CACResultStream()
+{
+    m_pHeader = nullptr;
+    m_pRecords = nullptr;
+    m_nMask = 0;
+    m_nNext = 1;
+}
+
+CACResultStream::~CACResultStream()
+{
+    Close();
+}
+
+bool CACResultStream::Create(const std::string &name, uint32_t capacity)
+{
+    Close();
+    uint32_t records = 64;
+    while (records < capacity && records < (1u << 30))
+    {
+        records <<= 1;
+    }
+    size_t totalBytes = AlignBlock(sizeof(StreamHeader)) + (size_t)records * sizeof(Record);
+    if (!m_cMemory.Create(name, totalBytes))
+    {
+        std::cerr << "Result stream " << name << ": cannot create " << totalBytes << " bytes" << std::endl;
+        return false;
+    }
+
+    // The magic is written last, a consumer opening the block early sees it is not ready
+    m_pHeader = new (m_cMemory.GetData()) StreamHeader();
+    m_pHeader->magic = 0;
+    m_pHeader->version = RESULT_STREAM_VERSION;
+    m_pHeader->recordBytes = (uint32_t)sizeof(Record);
+    m_pHeader->capacity = records;
+    m_pHeader->published.store(0);
+    m_pHeader->notify.store(0);
+    m_pHeader->cameras.store(0);
+    m_pRecords = reinterpret_cast<Record *>(m_cMemory.GetData() + AlignBlock(sizeof(StreamHeader)));
+    for (uint32_t i = 0; i < records; ++i)
+    {
+        new (&m_pRecords[i]) Record();
+        m_pRecords[i].sequence.store(0);
+    }
+    m_nMask = records - 1;
+    m_nNext = 1;
+    m_mCameras.clear();
+    m_mFrameIds.clear();
+    std::atomic_thread_fence(std::memory_order_release);
+    m_pHeader->magic = RESULT_STREAM_MAGIC;
+    return true;
+}
+
+std::shared_ptr<CACResultStream> CACResultStream::GetShared(const std::string &name, uint32_t capacity)
+{
+    static std::mutex s_cMutex;
+    static std::map<std::string, std::weak_ptr<CACResultStream>> s_mStreams;
+    std::lock_guard<std::mutex> lock(s_cMutex);
+    std::shared_ptr<CACResultStream> pStream = s_mStreams[name].lock();
+    if (!pStream)
+    {
+        pStream = std::make_shared<CACResultStream>();
+        if (!pStream->Create(name, capacity))
+        {
+            return nullptr;
+        }
+        s_mStreams[name] = pStream;
+    }
+    return pStream;
+}
+
+bool CACResultStream::Open(const std::string &name)
+{
+    Close();
+    if (!m_cMemory.Open(name))
+    {
+        return false;
+    }
+    m_pHeader = reinterpret_cast<StreamHeader *>(m_cMemory.GetData());
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_cMemory.GetSize() < sizeof(StreamHeader) || m_pHeader->magic != RESULT_STREAM_MAGIC ||
+        m_pHeader->version != RESULT_STREAM_VERSION || m_pHeader->recordBytes != sizeof(Record) ||
+        AlignBlock(sizeof(StreamHeader)) + (size_t)m_pHeader->capacity * sizeof(Record) > m_cMemory.GetSize())
+    {
+        std::cerr << "Result stream " << name << ": not ready or incompatible" << std::endl;
+        Close();
+        return false;
+    }
+    m_pRecords = reinterpret_cast<Record *>(m_cMemory.GetData() + AlignBlock(sizeof(StreamHeader)));
+    m_nMask = m_pHeader->capacity - 1;
+    return true;
+}
+
+void CACResultStream::Close()
+{
+    m_cMemory.Close();
+    m_pHeader = nullptr;
+    m_pRecords = nullptr;
+    m_nMask = 0;
+}
+
+CACResultStream::FrameWriter::FrameWriter(CACResultStream &stream, const std::string &cameraId, double timestampMs,
+                                          int width, int height, int junctionState)
+    : m_cStream(stream), m_cLock(stream.m_cMutex)
+{
+    m_nCamera = NO_CAMERA;
+    if (!m_cStream.m_pHeader)
+    {
+        m_pFrame = &m_cStream.m_stOverflow;
+        m_nFrameSequence = 0;
+        return;
+    }
+
+    // The id is in the table before any record refers to its index
+    auto camera = m_cStream.m_mCameras.find(cameraId);
+    if (camera != m_cStream.m_mCameras.end())
+    {
+        m_nCamera = (uint16_t)camera->second;
+    }
+    else
+    {
+        uint32_t nCameras = m_cStream.m_pHeader->cameras.load(std::memory_order_relaxed);
+        if (nCameras < (uint32_t)MAX_CAMERAS)
+        {
+            std::strncpy(m_cStream.m_pHeader->cameraIds[nCameras], cameraId.c_str(), MAX_CAMERA_ID - 1);
+            m_cStream.m_pHeader->cameraIds[nCameras][MAX_CAMERA_ID - 1] = '\0';
+            m_cStream.m_pHeader->cameras.store(nCameras + 1, std::memory_order_release);
+            m_cStream.m_mCameras[cameraId] = (int)nCameras;
+            m_nCamera = (uint16_t)nCameras;
+        }
+    }
+
+    m_nFrameSequence = m_cStream.m_nNext;
+    m_pFrame = Add(RECORD_FRAME);
+    FrameRecord &frame = m_pFrame->frame;
+    frame.timestampMs = timestampMs;
+    frame.frameId = ++m_cStream.m_mFrameIds[m_nCamera];
+    frame.junctionState = junctionState;
+    frame.width = width;
+    frame.height = height;
+}
+
+CACResultStream::Record *CACResultStream::FrameWriter::Add(RecordType type)
+{
+    // A frame keeps to half the ring, so the records published before it stay readable meanwhile
+    Record *record;
+    if (!m_cStream.m_pHeader || m_cStream.m_nNext - m_nFrameSequence >= (m_cStream.m_nMask + 1) / 2)
+    {
+        record = &m_cStream.m_stOverflow;
+    }
+    else
+    {
+        record = m_cStream.GetRecord(m_cStream.m_nNext++);
+        record->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    record->frameSequence = m_nFrameSequence;
+    record->type = (uint16_t)type;
+    record->camera = m_nCamera;
+    record->reserved = 0;
+    std::memset(record->payload, 0, sizeof(record->payload));
+    if (type != RECORD_FRAME && record != &m_cStream.m_stOverflow)
+    {
+        FrameRecord &frame = m_pFrame->frame;
+        ++(type == RECORD_DETECTION ? frame.detections : type == RECORD_LIGHT ? frame.lights : frame.violations);
+    }
+    return record;
+}
+
+CACResultStream::FrameWriter::~FrameWriter()
+{
+    if (!m_cStream.m_pHeader || m_nFrameSequence == 0)
+    {
+        return;
+    }
+
+    // Every record carries its sequence before the frame is published as a whole
+    uint64_t nLast = m_cStream.m_nNext - 1;
+    for (uint64_t sequence = m_nFrameSequence; sequence <= nLast; ++sequence)
+    {
+        m_cStream.GetRecord(sequence)->sequence.store(sequence, std::memory_order_release);
+    }
+    StreamHeader *header = m_cStream.m_pHeader;
+    header->published.store(nLast, std::memory_order_release);
+    header->notify.fetch_add(1, std::memory_order_release);
+    CACSharedMemory::WakeWord(header->notify);
+}
+
+uint64_t CACResultStream::GetOldest() const
+{
+    // The producer may already be rewriting up to half the ring past the newest frame
+    uint64_t nPublished = GetPublished();
+    uint64_t nKept = m_pHeader ? m_pHeader->capacity / 2 : 0;
+    return nPublished > nKept ? nPublished - nKept + 1 : 1;
+}
+
+bool CACResultStream::Wait(uint64_t cursor, int timeoutMs) const
+{
+    if (!m_pHeader)
+    {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        // The word is read before the check, a frame published in between changes it and the wait returns
+        uint32_t nNotify = m_pHeader->notify.load(std::memory_order_acquire);
+        if (GetPublished() >= cursor)
+        {
+            return true;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+        {
+            return false;
+        }
+        CACSharedMemory::WaitWord(m_pHeader->notify, nNotify, remaining);
+    }
+}
+
+const CACResultStream::Record *CACResultStream::Peek(uint64_t &cursor, uint64_t &lost) const
+{
+    if (!m_pHeader || cursor == 0)
+    {
+        return nullptr;
+    }
+    if (cursor > GetPublished())
+    {
+        return nullptr;
+    }
+    uint64_t nOldest = GetOldest();
+    if (cursor < nOldest)
+    {
+        lost += nOldest - cursor;
+        cursor = nOldest;
+    }
+    const Record *record = GetRecord(cursor);
+    if (record->sequence.load(std::memory_order_acquire) != cursor)
+    {
+        // Rewritten since GetOldest, the next call starts further on
+        uint64_t nNext = GetOldest();
+        lost += nNext > cursor ? nNext - cursor : 1;
+        cursor = nNext > cursor ? nNext : cursor + 1;
+        return nullptr;
+    }
+    return record;
+}
+
+bool CACResultStream::Validate(const Record *record, uint64_t sequence) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return record->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+std::string CACResultStream::GetCameraId(uint16_t camera) const
+{
+    if (!m_pHeader || camera >= m_pHeader->cameras.load(std::memory_order_acquire))
+    {
+        return std::string();
+    }
+    return std::string(m_pHeader->cameraIds[camera], strnlen(m_pHeader->cameraIds[camera], MAX_CAMERA_ID));
+}
@@ -0,0 +1,190 @@
+#ifndef RESULT_STREAM_H
+#define RESULT_STREAM_H
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "SharedMemory.h"
+
+// Inference results for other processes, as fixed-layout 64-byte records in a named shared-memory
+// ring: no strings, masks or per-field parsing, a consumer reads the record where it lies. Each
+// processed frame is one FRAME record followed by its DETECTION, LIGHT and VIOLATION records;
+// camera ids are stored once in the header and records carry the index.
+//
+// One producer process, any number of consumers that never write to the block. Records get
+// sequence numbers from 1 and record n lives in slot (n - 1) % capacity. The producer marks a slot
+// with sequence 0 while it rewrites it and stores the final sequence last, so a consumer checks the
+// slot sequence before and after reading a record (seqlock); a slow consumer that was lapped finds a
+// newer sequence and skips to the oldest record still in the ring. Nothing waits for consumers.
+//
+// All values are little-endian; the layout is versioned by RESULT_STREAM_VERSION.
+class CACResultStream
+{
+public:
+    static const uint32_t RESULT_STREAM_MAGIC = 0x53524341; // "ACRS"
+    static const uint32_t RESULT_STREAM_VERSION = 1;
+    static const int MAX_CAMERAS = 256;
+    static const int MAX_CAMERA_ID = 64;
+
+    enum RecordType : uint16_t
+    {
+        RECORD_FRAME = 1,
+        RECORD_DETECTION = 2,
+        RECORD_LIGHT = 3,
+        RECORD_VIOLATION = 4
+    };
+
+    struct FrameRecord
+    {
+        double timestampMs;     // Producer's steady clock
+        uint64_t frameId;       // Per camera, counts processed frames
+        uint32_t detections;    // Records of each type that follow
+        uint32_t lights;
+        uint32_t violations;
+        int32_t junctionState;  // TrafficLightState, the most restrictive signal
+        int32_t width;          // Frame size, the boxes are in its pixels
+        int32_t height;
+    };
+
+    struct DetectionRecord
+    {
+        int32_t classId;
+        int32_t trackId;
+        float confidence;
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+        int32_t laneId;
+        int32_t lightId;        // Signal head controlling the lane
+        uint32_t crossed;       // 1 when the vehicle crossed its stop line on this frame
+    };
+
+    struct LightRecord
+    {
+        int32_t lightId;        // 0 for TrafficRoi, N for TrafficRoi_N
+        int32_t state;          // TrafficLightState of the head
+        int32_t classId;        // -1 for the head's state without a box
+        float confidence;
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+    };
+
+    struct ViolationRecord
+    {
+        int32_t trackId;
+        int32_t classId;
+        float confidence;
+        int32_t laneId;
+        int32_t lightId;
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+    };
+
+    struct alignas(64) Record
+    {
+        std::atomic<uint64_t> sequence; // 0 while the producer writes the slot
+        uint64_t frameSequence;         // Sequence of the FRAME record this one belongs to
+        uint16_t type;                  // RecordType
+        uint16_t camera;                // Index into the header's camera table
+        uint32_t reserved;
+        union
+        {
+            FrameRecord frame;
+            DetectionRecord detection;
+            LightRecord light;
+            ViolationRecord violation;
+            unsigned char payload[40];
+        };
+    };
+
+private:
+    struct StreamHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordBytes;
+        uint32_t capacity;                // Records, a power of two
+        std::atomic<uint64_t> published;  // Sequence of the last record of the newest complete frame
+        std::atomic<uint32_t> notify;     // Incremented per frame, the word consumers wait on
+        std::atomic<uint32_t> cameras;    // Entries of the camera table in use
+        char cameraIds[MAX_CAMERAS][MAX_CAMERA_ID];
+    };
+
+    CACSharedMemory m_cMemory;
+    StreamHeader *m_pHeader;
+    Record *m_pRecords;
+    uint64_t m_nMask;
+
+    // Producer
+    std::mutex m_cMutex;                  // Cameras of the process take turns writing frames
+    std::map<std::string, int> m_mCameras;
+    std::map<int, uint64_t> m_mFrameIds;
+    uint64_t m_nNext;                     // Sequence of the next record
+    Record m_stOverflow;                  // Takes the records of a frame beyond half the ring
+
+    Record *GetRecord(uint64_t sequence) const { return &m_pRecords[(sequence - 1) & m_nMask]; }
+
+public:
+    CACResultStream();
+    ~CACResultStream();
+
+    // Producer: a new ring of at least the given number of records (rounded up to a power of two)
+    bool Create(const std::string &name, uint32_t capacity);
+    // Producer, shared by the cameras of the process that publish to the same name
+    static std::shared_ptr<CACResultStream> GetShared(const std::string &name, uint32_t capacity);
+    // Consumer
+    bool Open(const std::string &name);
+    void Close();
+    bool IsOpen() const { return m_pHeader != nullptr; }
+
+    // Producer: one frame, written and published when the writer goes out of scope. Holds the
+    // stream for the other cameras of the process until then.
+    class FrameWriter
+    {
+        CACResultStream &m_cStream;
+        std::unique_lock<std::mutex> m_cLock;
+        Record *m_pFrame;
+        uint64_t m_nFrameSequence;
+        uint16_t m_nCamera;
+
+        Record *Add(RecordType type);
+
+    public:
+        FrameWriter(CACResultStream &stream, const std::string &cameraId, double timestampMs, int width, int height, int junctionState);
+        ~FrameWriter();
+        FrameWriter(const FrameWriter &) = delete;
+        FrameWriter &operator=(const FrameWriter &) = delete;
+
+        DetectionRecord &AddDetection() { return Add(RECORD_DETECTION)->detection; }
+        LightRecord &AddLight() { return Add(RECORD_LIGHT)->light; }
+        ViolationRecord &AddViolation() { return Add(RECORD_VIOLATION)->violation; }
+    };
+
+    // Consumer: the newest published sequence and the oldest one still in the ring
+    uint64_t GetPublished() const { return m_pHeader ? m_pHeader->published.load(std::memory_order_acquire) : 0; }
+    uint64_t GetOldest() const;
+    // Consumer: where a new reader starts, on the next frame to be published
+    uint64_t GetCursor() const { return GetPublished() + 1; }
+    // Consumer: waits up to timeoutMs until the record at cursor is published
+    bool Wait(uint64_t cursor, int timeoutMs) const;
+    // Consumer: the record at cursor in the ring, read in place. Null when it is not published yet.
+    // When it was overwritten, cursor moves to the oldest record still there and lost counts the gap.
+    const Record *Peek(uint64_t &cursor, uint64_t &lost) const;
+    // Consumer: true when the record read through Peek was not rewritten meanwhile, its fields are
+    // only valid after this returns true
+    bool Validate(const Record *record, uint64_t sequence) const;
+    // Consumer: the id of a camera index of a record
+    std::string GetCameraId(uint16_t camera) const;
+    uint32_t GetCapacity() const { return m_pHeader ? m_pHeader->capacity : 0; }
+};
+
+#endif // RESULT_STREAM_H
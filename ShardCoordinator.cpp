@@ -0,0 +1,714 @@
+#include "ShardCoordinator.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+CACShardCoordinator::CACShardCoordinator()
+{
+    m_bPlanDirty = false;
+    m_bMovesDeferred = false;
+    m_dStartedMs = 0.0;
+    m_dLastRebalanceMs = 0.0;
+    m_nMoves = 0;
+    m_nRebalances = 0;
+}
+
+CACShardCoordinator::~CACShardCoordinator()
+{
+    Stop();
+}
+
+uint32_t CACShardCoordinator::Hash(const std::string &key)
+{
+    // FNV-1a, then a finaliser so that similar ids land far apart on the ring
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : key)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+double CACShardCoordinator::NowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool HasExited(long long pid, void *&process)
+{
+#ifdef _WIN32
+    (void)pid;
+    if (!process || WaitForSingleObject((HANDLE)process, 0) != WAIT_OBJECT_0)
+    {
+        return false;
+    }
+    CloseHandle((HANDLE)process);
+    process = nullptr;
+    return true;
+#else
+    (void)process;
+    return waitpid((pid_t)pid, nullptr, WNOHANG) == (pid_t)pid;
+#endif
+}
+
+bool CACShardCoordinator::StartWorker(Worker &worker)
+{
+    std::vector<std::string> vArguments = {m_stConfig.workerExecutable, "worker", m_stConfig.socketPath, std::to_string(worker.index)};
+    vArguments.insert(vArguments.end(), m_stConfig.workerArguments.begin(), m_stConfig.workerArguments.end());
+#ifdef _WIN32
+    std::string sCommandLine;
+    for (const auto &argument : vArguments)
+    {
+        sCommandLine += (sCommandLine.empty() ? "\"" : " \"") + argument + "\"";
+    }
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    ZeroMemory(&startup, sizeof(startup));
+    startup.cb = sizeof(startup);
+    if (!CreateProcessA(NULL, &sCommandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info))
+    {
+        std::cerr << "Worker " << worker.index << ": cannot start " << m_stConfig.workerExecutable << std::endl;
+        return false;
+    }
+    CloseHandle(info.hThread);
+    worker.process = info.hProcess;
+    worker.pid = (long long)info.dwProcessId;
+#else
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "Worker " << worker.index << ": cannot start " << m_stConfig.workerExecutable << std::endl;
+        return false;
+    }
+    if (pid == 0)
+    {
+        std::vector<char *> vArgv;
+        for (auto &argument : vArguments)
+        {
+            vArgv.push_back(&argument[0]);
+        }
+        vArgv.push_back(nullptr);
+        execv(m_stConfig.workerExecutable.c_str(), vArgv.data());
+        _exit(127);
+    }
+    worker.pid = (long long)pid;
+#endif
+    // The heartbeat timeout also covers the time it takes the worker to connect
+    worker.running = true;
+    worker.connected = false;
+    worker.startedMs = NowMs();
+    worker.lastSeenMs = worker.startedMs;
+    std::cout << "Worker " << worker.index << ": started, pid " << worker.pid << std::endl;
+    return true;
+}
+
+void CACShardCoordinator::StopWorker(Worker &worker, bool kill)
+{
+    if (!kill && worker.connected)
+    {
+        worker.socket.Send("STOP");
+    }
+    worker.socket.Close();
+    worker.connected = false;
+    if (!worker.running)
+    {
+        return;
+    }
+    if (kill)
+    {
+#ifdef _WIN32
+        if (worker.process)
+        {
+            TerminateProcess((HANDLE)worker.process, 1);
+            WaitForSingleObject((HANDLE)worker.process, INFINITE);
+            CloseHandle((HANDLE)worker.process);
+            worker.process = nullptr;
+        }
+#else
+        ::kill((pid_t)worker.pid, SIGKILL);
+        waitpid((pid_t)worker.pid, nullptr, 0);
+#endif
+        worker.running = false;
+    }
+}
+
+void CACShardCoordinator::OnWorkerLost(Worker &worker, const std::string &reason)
+{
+    // Whatever state it is in, the process is gone before it is started again
+    StopWorker(worker, true);
+    double dNowMs = NowMs();
+    ++worker.crashes;
+    double dDelayMs = m_stConfig.restartDelayMs;
+    for (int i = 1; i < worker.crashes && dDelayMs < m_stConfig.maxRestartDelayMs; ++i)
+    {
+        dDelayMs *= 2.0;
+    }
+    worker.restartAtMs = dNowMs + (std::min)(dDelayMs, m_stConfig.maxRestartDelayMs);
+    std::cerr << "Worker " << worker.index << ": " << reason << ", restarting in " << (std::min)(dDelayMs, m_stConfig.maxRestartDelayMs)
+              << " ms" << std::endl;
+
+    for (auto &camera : m_mCameras)
+    {
+        if (camera.second.worker == worker.index)
+        {
+            camera.second.worker = -1;
+            camera.second.releasing = false;
+        }
+    }
+    m_bPlanDirty = true;
+}
+
+bool CACShardCoordinator::Start(const Config &config)
+{
+    Stop();
+    m_stConfig = config;
+    m_stConfig.workers = (std::max)(1, m_stConfig.workers);
+    m_stConfig.virtualNodes = (std::max)(1, m_stConfig.virtualNodes);
+    if (!m_cListener.Listen(m_stConfig.socketPath))
+    {
+        std::cerr << "Shard coordinator: cannot listen on " << m_stConfig.socketPath << std::endl;
+        return false;
+    }
+    m_vWorkers = std::vector<Worker>(m_stConfig.workers);
+    for (int i = 0; i < m_stConfig.workers; ++i)
+    {
+        m_vWorkers[i].index = i;
+        if (!StartWorker(m_vWorkers[i]))
+        {
+            m_vWorkers[i].restartAtMs = NowMs() + m_stConfig.restartDelayMs;
+        }
+    }
+    m_dStartedMs = NowMs();
+    m_dLastRebalanceMs = m_dStartedMs;
+    m_bPlanDirty = true;
+    m_bMovesDeferred = false;
+    return true;
+}
+
+void CACShardCoordinator::Stop()
+{
+    for (auto &worker : m_vWorkers)
+    {
+        StopWorker(worker, false);
+    }
+
+    // Workers release their cameras and exit on STOP; the ones still running after that are killed
+    double dDeadlineMs = NowMs() + 3000.0;
+    for (auto &worker : m_vWorkers)
+    {
+        while (worker.running && !HasExited(worker.pid, worker.process) && NowMs() < dDeadlineMs)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (worker.running && !HasExited(worker.pid, worker.process))
+        {
+            StopWorker(worker, true);
+        }
+        worker.running = false;
+    }
+    m_vWorkers.clear();
+    m_vPending.clear();
+    m_mRing.clear();
+    m_cListener.Close();
+    for (auto &camera : m_mCameras)
+    {
+        camera.second.worker = -1;
+        camera.second.target = -1;
+        camera.second.releasing = false;
+    }
+}
+
+void CACShardCoordinator::AddCamera(const std::string &cameraId, const std::string &parametersFile)
+{
+    if (cameraId.empty() || cameraId.find(' ') != std::string::npos || m_mCameras.count(cameraId))
+    {
+        return;
+    }
+    Camera &camera = m_mCameras[cameraId];
+    camera.cameraId = cameraId;
+    camera.parametersFile = parametersFile;
+    camera.hash = Hash(cameraId);
+    camera.stats.cameraId = cameraId;
+    m_bPlanDirty = true;
+}
+
+void CACShardCoordinator::RemoveCamera(const std::string &cameraId)
+{
+    auto camera = m_mCameras.find(cameraId);
+    if (camera == m_mCameras.end())
+    {
+        return;
+    }
+    int nWorker = camera->second.worker;
+    if (nWorker >= 0 && nWorker < (int)m_vWorkers.size() && m_vWorkers[nWorker].connected)
+    {
+        m_vWorkers[nWorker].socket.Send("RELEASE " + cameraId);
+    }
+    m_mCameras.erase(camera);
+    m_bPlanDirty = true;
+}
+
+void CACShardCoordinator::HandleMessage(Worker &worker, const std::string &line)
+{
+    std::istringstream ss(line);
+    std::string sCommand;
+    ss >> sCommand;
+    worker.lastSeenMs = NowMs();
+    if (sCommand == "METRICS")
+    {
+        // METRICS <camera> <fps> <load ms per s> <mean ms> <frames> <dropped>, frames and dropped since the last report
+        std::string sCameraId;
+        double dFps = 0.0, dLoadMs = 0.0, dMeanMs = 0.0;
+        long long nFrames = 0, nDropped = 0;
+        ss >> sCameraId >> dFps >> dLoadMs >> dMeanMs >> nFrames >> nDropped;
+        auto camera = m_mCameras.find(sCameraId);
+        if (ss.fail() || camera == m_mCameras.end() || camera->second.worker != worker.index)
+        {
+            return;
+        }
+        CameraStats &stats = camera->second.stats;
+        stats.fps = dFps;
+        stats.loadMs = camera->second.measured ? 0.7 * stats.loadMs + 0.3 * dLoadMs : dLoadMs;
+        stats.meanMs = dMeanMs;
+        stats.frames += nFrames;
+        stats.dropped += nDropped;
+        camera->second.measured = true;
+    }
+    else if (sCommand == "RELEASED")
+    {
+        std::string sCameraId;
+        ss >> sCameraId;
+        auto camera = m_mCameras.find(sCameraId);
+        if (camera != m_mCameras.end() && camera->second.worker == worker.index)
+        {
+            camera->second.worker = -1;
+            camera->second.releasing = false;
+            Dispatch();
+        }
+    }
+    else if (sCommand == "LOADED")
+    {
+        // LOADED <camera> <ms>, time the worker took to load the models and apply the parameters
+        std::string sCameraId;
+        double dLoadMs = 0.0;
+        ss >> sCameraId >> dLoadMs;
+        auto camera = m_mCameras.find(sCameraId);
+        if (!ss.fail() && camera != m_mCameras.end() && camera->second.worker == worker.index)
+        {
+            camera->second.loadCostMs = dLoadMs;
+        }
+    }
+    else if (sCommand == "FAILED")
+    {
+        // The worker gave the camera up, another one gets it
+        std::string sCameraId;
+        ss >> sCameraId;
+        auto camera = m_mCameras.find(sCameraId);
+        if (camera != m_mCameras.end() && camera->second.worker == worker.index)
+        {
+            camera->second.worker = -1;
+            camera->second.target = -1;
+            camera->second.releasing = false;
+            camera->second.failedUntilMs[worker.index] = worker.lastSeenMs + m_stConfig.maxRestartDelayMs;
+            ++camera->second.stats.failures;
+            std::cerr << "Camera " << sCameraId << ": failed on worker " << worker.index << std::endl;
+            m_bPlanDirty = true;
+        }
+    }
+    else if (sCommand == "HEARTBEAT")
+    {
+        // A worker that stays up for the longest restart delay is no longer crash-looping
+        if (worker.crashes > 0 && worker.lastSeenMs - worker.startedMs > m_stConfig.maxRestartDelayMs)
+        {
+            worker.crashes = 0;
+        }
+    }
+}
+
+void CACShardCoordinator::CheckWorkers(double nowMs)
+{
+    for (auto &worker : m_vWorkers)
+    {
+        if (worker.running && HasExited(worker.pid, worker.process))
+        {
+            worker.running = false;
+            OnWorkerLost(worker, "exited");
+        }
+        else if (worker.running && nowMs - worker.lastSeenMs > m_stConfig.heartbeatTimeoutMs)
+        {
+            OnWorkerLost(worker, "no heartbeat");
+        }
+        else if (!worker.running && nowMs >= worker.restartAtMs)
+        {
+            ++worker.restarts;
+            if (!StartWorker(worker))
+            {
+                worker.restartAtMs = nowMs + m_stConfig.maxRestartDelayMs;
+            }
+        }
+    }
+}
+
+void CACShardCoordinator::BuildRing()
+{
+    m_mRing.clear();
+    for (const auto &worker : m_vWorkers)
+    {
+        if (!worker.connected)
+        {
+            continue;
+        }
+        for (int node = 0; node < m_stConfig.virtualNodes; ++node)
+        {
+            m_mRing[Hash("worker-" + std::to_string(worker.index) + "#" + std::to_string(node))] = worker.index;
+        }
+    }
+}
+
+std::map<std::string, int> CACShardCoordinator::Plan() const
+{
+    std::map<std::string, int> plan;
+    for (const auto &camera : m_mCameras)
+    {
+        plan[camera.first] = -1;
+    }
+    std::set<int> connected;
+    for (const auto &point : m_mRing)
+    {
+        connected.insert(point.second);
+    }
+    if (connected.empty())
+    {
+        return plan;
+    }
+
+    // Cameras not measured yet are taken to cost the mean of the measured ones
+    double dMeasuredMs = 0.0;
+    int nMeasured = 0;
+    for (const auto &camera : m_mCameras)
+    {
+        if (camera.second.measured)
+        {
+            dMeasuredMs += camera.second.stats.loadMs;
+            ++nMeasured;
+        }
+    }
+    double dDefaultMs = nMeasured > 0 ? (std::max)(1.0, dMeasuredMs / nMeasured) : 1.0;
+    std::map<std::string, double> costs;
+    double dTotalMs = 0.0;
+    double dLargestMs = 0.0;
+    for (const auto &camera : m_mCameras)
+    {
+        double dCostMs = camera.second.measured ? (std::max)(1.0, camera.second.stats.loadMs) : dDefaultMs;
+        costs[camera.first] = dCostMs;
+        dTotalMs += dCostMs;
+        dLargestMs = (std::max)(dLargestMs, dCostMs);
+    }
+    double dCapacityMs = (std::max)((1.0 + m_stConfig.loadTolerance) * dTotalMs / connected.size(), dLargestMs);
+
+    // In ring order, so the placement only depends on the hashes and the loads
+    std::vector<std::pair<uint32_t, std::string>> vOrder;
+    for (const auto &camera : m_mCameras)
+    {
+        vOrder.push_back(std::make_pair(camera.second.hash, camera.first));
+    }
+    std::sort(vOrder.begin(), vOrder.end());
+
+    std::map<int, double> loads;
+    for (int worker : connected)
+    {
+        loads[worker] = 0.0;
+    }
+    double dNowMs = NowMs();
+    for (const auto &entry : vOrder)
+    {
+        const Camera &camera = m_mCameras.at(entry.second);
+        auto usable = [&camera, dNowMs](int worker)
+        {
+            auto failed = camera.failedUntilMs.find(worker);
+            return failed == camera.failedUntilMs.end() || failed->second <= dNowMs;
+        };
+        double dCostMs = costs[entry.second];
+        int nChosen = -1;
+        auto point = m_mRing.lower_bound(entry.first);
+        for (size_t step = 0; step < m_mRing.size() && nChosen < 0; ++step, ++point)
+        {
+            if (point == m_mRing.end())
+            {
+                point = m_mRing.begin();
+            }
+            if (usable(point->second) && loads[point->second] + dCostMs <= dCapacityMs + 1e-9)
+            {
+                nChosen = point->second;
+            }
+        }
+        if (nChosen < 0)
+        {
+            // Over the bound everywhere: the least loaded worker that has not failed it
+            for (const auto &load : loads)
+            {
+                if (usable(load.first) && (nChosen < 0 || load.second < loads[nChosen]))
+                {
+                    nChosen = load.first;
+                }
+            }
+        }
+        if (nChosen < 0)
+        {
+            // Every worker failed it lately, it waits for the first exclusion to run out
+            continue;
+        }
+        loads[nChosen] += dCostMs;
+        plan[entry.second] = nChosen;
+    }
+    return plan;
+}
+
+bool CACShardCoordinator::IsOverloaded() const
+{
+    std::map<int, double> loads;
+    std::map<int, int> counts;
+    double dTotalMs = 0.0;
+    int nConnected = 0;
+    for (const auto &worker : m_vWorkers)
+    {
+        nConnected += worker.connected ? 1 : 0;
+    }
+    for (const auto &camera : m_mCameras)
+    {
+        if (camera.second.worker < 0 && nConnected > 0)
+        {
+            return true;
+        }
+        if (camera.second.worker >= 0 && camera.second.measured)
+        {
+            loads[camera.second.worker] += camera.second.stats.loadMs;
+            ++counts[camera.second.worker];
+            dTotalMs += camera.second.stats.loadMs;
+        }
+    }
+    if (nConnected == 0)
+    {
+        return false;
+    }
+    double dBoundMs = (1.0 + m_stConfig.loadTolerance + m_stConfig.rebalanceMargin) * dTotalMs / nConnected;
+    for (const auto &load : loads)
+    {
+        // A single camera heavier than the bound cannot be split, moving it would not help
+        if (load.second > dBoundMs && counts[load.first] > 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CACShardCoordinator::Rebalance(bool loadDriven)
+{
+    BuildRing();
+    std::map<std::string, int> plan = Plan();
+
+    // Current loads, against the same bound IsOverloaded uses
+    std::map<int, double> loads;
+    double dTotalMs = 0.0;
+    int nConnected = 0;
+    for (const auto &worker : m_vWorkers)
+    {
+        nConnected += worker.connected ? 1 : 0;
+    }
+    for (const auto &camera : m_mCameras)
+    {
+        if (camera.second.worker >= 0 && camera.second.measured)
+        {
+            loads[camera.second.worker] += camera.second.stats.loadMs;
+            dTotalMs += camera.second.stats.loadMs;
+        }
+    }
+    double dBoundMs = (1.0 + m_stConfig.loadTolerance) * dTotalMs / (std::max)(1, nConnected);
+
+    double dNowMs = NowMs();
+    for (auto &camera : m_mCameras)
+    {
+        Camera &stCamera = camera.second;
+        int nTarget = plan[camera.first];
+        if (stCamera.worker >= 0 && !stCamera.releasing && nTarget != stCamera.worker)
+        {
+            if (dNowMs - stCamera.assignedMs < m_stConfig.minMoveIntervalMs)
+            {
+                // Only just loaded there
+                nTarget = stCamera.worker;
+                m_bMovesDeferred = m_bMovesDeferred || !loadDriven;
+            }
+            else if (loadDriven)
+            {
+                // Relief on the overloaded worker until the camera may move again, against the time
+                // the new worker spends loading it
+                double dExcessMs = loads[stCamera.worker] - dBoundMs;
+                double dReliefMs = (std::min)(stCamera.stats.loadMs, dExcessMs);
+                if (dExcessMs <= 0.0 || dReliefMs * m_stConfig.minMoveIntervalMs / 1000.0 <= stCamera.loadCostMs)
+                {
+                    nTarget = stCamera.worker;
+                }
+                else
+                {
+                    loads[stCamera.worker] -= stCamera.stats.loadMs;
+                }
+            }
+        }
+        stCamera.target = nTarget;
+    }
+    ++m_nRebalances;
+    Dispatch();
+}
+
+void CACShardCoordinator::Dispatch()
+{
+    for (auto &camera : m_mCameras)
+    {
+        Camera &stCamera = camera.second;
+        if (stCamera.releasing || stCamera.worker == stCamera.target)
+        {
+            continue;
+        }
+        if (stCamera.worker >= 0)
+        {
+            // Assigned to the new worker once the old one let go of it
+            if (m_vWorkers[stCamera.worker].socket.Send("RELEASE " + stCamera.cameraId))
+            {
+                stCamera.releasing = true;
+                ++m_nMoves;
+            }
+            continue;
+        }
+        if (stCamera.target >= 0 && m_vWorkers[stCamera.target].connected &&
+            m_vWorkers[stCamera.target].socket.Send("ASSIGN " + stCamera.cameraId +
+                                                    (stCamera.parametersFile.empty() ? "" : " " + stCamera.parametersFile)))
+        {
+            stCamera.worker = stCamera.target;
+            stCamera.assignedMs = NowMs();
+        }
+    }
+}
+
+void CACShardCoordinator::Poll(int timeoutMs)
+{
+    if (!m_cListener.IsOpen())
+    {
+        return;
+    }
+
+    // New connections identify themselves with HELLO <worker index> <pid>
+    for (CACLocalSocket connection = m_cListener.Accept(timeoutMs); connection.IsOpen(); connection = m_cListener.Accept(0))
+    {
+        m_vPending.push_back(std::move(connection));
+    }
+    for (size_t i = 0; i < m_vPending.size();)
+    {
+        std::string sLine;
+        int nResult = m_vPending[i].Receive(sLine, 0);
+        if (nResult == 0)
+        {
+            ++i;
+            continue;
+        }
+        std::istringstream ss(sLine);
+        std::string sCommand;
+        int nIndex = -1;
+        long long nPid = 0;
+        ss >> sCommand >> nIndex >> nPid;
+        if (nResult > 0 && sCommand == "HELLO" && nIndex >= 0 && nIndex < (int)m_vWorkers.size() && m_vWorkers[nIndex].running)
+        {
+            Worker &worker = m_vWorkers[nIndex];
+            worker.socket = std::move(m_vPending[i]);
+            worker.connected = true;
+            worker.lastSeenMs = NowMs();
+            std::cout << "Worker " << nIndex << ": connected, pid " << nPid << std::endl;
+            m_bPlanDirty = true;
+        }
+        m_vPending.erase(m_vPending.begin() + i);
+    }
+
+    for (auto &worker : m_vWorkers)
+    {
+        std::string sLine;
+        int nResult = 0;
+        while (worker.connected && (nResult = worker.socket.Receive(sLine, 0)) > 0)
+        {
+            HandleMessage(worker, sLine);
+        }
+        if (worker.connected && nResult < 0)
+        {
+            OnWorkerLost(worker, "connection closed");
+        }
+    }
+
+    double dNowMs = NowMs();
+    CheckWorkers(dNowMs);
+    bool bOverloaded = false;
+    if (dNowMs - m_dLastRebalanceMs >= m_stConfig.rebalanceIntervalMs)
+    {
+        m_dLastRebalanceMs = dNowMs;
+        m_bPlanDirty = m_bPlanDirty || m_bMovesDeferred;
+        m_bMovesDeferred = false;
+        bOverloaded = !m_bPlanDirty && IsOverloaded();
+    }
+    bool bAllConnected = std::all_of(m_vWorkers.begin(), m_vWorkers.end(), [](const Worker &worker)
+                                     { return worker.connected; });
+    if (!bAllConnected && dNowMs - m_dStartedMs < m_stConfig.heartbeatTimeoutMs)
+    {
+        // Cameras placed on the first worker to connect would all move again a moment later
+        return;
+    }
+    if (m_bPlanDirty || bOverloaded)
+    {
+        m_bPlanDirty = false;
+        Rebalance(bOverloaded);
+    }
+}
+
+CACShardCoordinator::Stats CACShardCoordinator::GetStats() const
+{
+    Stats stats;
+    for (const auto &worker : m_vWorkers)
+    {
+        WorkerStats stWorker;
+        stWorker.index = worker.index;
+        stWorker.pid = worker.pid;
+        stWorker.connected = worker.connected;
+        stWorker.restarts = worker.restarts;
+        stats.workers.push_back(stWorker);
+    }
+    for (const auto &camera : m_mCameras)
+    {
+        CameraStats stCamera = camera.second.stats;
+        stCamera.worker = camera.second.worker;
+        if (stCamera.worker >= 0 && stCamera.worker < (int)stats.workers.size())
+        {
+            ++stats.workers[stCamera.worker].cameras;
+            stats.workers[stCamera.worker].loadMs += stCamera.loadMs;
+            stats.loadMs += stCamera.loadMs;
+            stats.fps += stCamera.fps;
+        }
+        stats.frames += stCamera.frames;
+        stats.dropped += stCamera.dropped;
+        stats.cameras.push_back(stCamera);
+    }
+    stats.moves = m_nMoves;
+    stats.rebalances = m_nRebalances;
+    return stats;
+}
@@ -0,0 +1,158 @@
+#ifndef SHARD_COORDINATOR_H
+#define SHARD_COORDINATOR_H
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+#include "LocalSocket.h"
+
+// Scale-out over worker processes on one node. The coordinator starts the workers, which connect
+// back over a local socket and each host a shard of the cameras (see CACShardWorker).
+//
+// Cameras are placed by consistent hashing with bounded loads: every connected worker has a number
+// of virtual nodes on a hash ring and a camera goes to the first worker clockwise from its hash
+// whose load stays under (1 + loadTolerance) times the mean. The load of a camera is what its
+// worker measured (inference milliseconds per second), so heavy cameras spread out while a worker
+// joining or leaving only moves the cameras next to its points. The plan is applied when workers or
+// cameras change, and on the rebalance interval when a worker is over the bound by more than the
+// margin. Moving a camera costs a model load and its tracking state, so a camera is not moved again
+// within minMoveIntervalMs, and a load rebalance keeps it where it is unless the move pays for the
+// load time the worker reported for it (LOADED).
+//
+// A camera is moved by RELEASE to the old worker and ASSIGN to the new one once the old one
+// answered RELEASED, so a frame ring camera never has two readers. Workers that exit or stop
+// sending heartbeats are killed if needed and started again after a delay that doubles per crash.
+//
+// Messages are text lines: ASSIGN <camera> [<parameters file>], RELEASE and STOP to the workers;
+// HELLO, HEARTBEAT, METRICS, LOADED, RELEASED and FAILED from them. A worker that fails to set a camera up
+// (models or parameter file) is not given that camera again for the longest restart delay.
+// Camera ids must not contain spaces.
+class CACShardCoordinator
+{
+public:
+    struct Config
+    {
+        std::string socketPath;
+        int workers{2};
+        std::string workerExecutable;             // Started as: <executable> worker <socket> <index> <workerArguments...>
+        std::vector<std::string> workerArguments;
+        int virtualNodes{64};                     // Ring points per worker
+        double loadTolerance{0.25};               // Bound on a worker's load above the mean
+        double rebalanceMargin{0.1};              // Further above the bound before the loads trigger a rebalance
+        double rebalanceIntervalMs{10000.0};
+        double minMoveIntervalMs{60000.0};        // A camera stays at least this long on the worker it was given
+        double heartbeatTimeoutMs{5000.0};
+        double restartDelayMs{1000.0};            // Doubles per consecutive crash
+        double maxRestartDelayMs{30000.0};
+    };
+
+    struct CameraStats
+    {
+        std::string cameraId;
+        int worker{-1};
+        double fps{0.0};
+        double loadMs{0.0};   // Inference milliseconds per second
+        double meanMs{0.0};   // Per frame
+        long long frames{0};
+        long long dropped{0}; // Frames the decoder overwrote before the worker took them
+        long long failures{0}; // Times a worker could not set it up
+    };
+
+    struct WorkerStats
+    {
+        int index{0};
+        long long pid{0};
+        bool connected{false};
+        int restarts{0};
+        int cameras{0};
+        double loadMs{0.0};
+    };
+
+    struct Stats
+    {
+        std::vector<WorkerStats> workers;
+        std::vector<CameraStats> cameras;
+        double loadMs{0.0};
+        double fps{0.0};
+        long long frames{0};
+        long long dropped{0};
+        long long moves{0};
+        long long rebalances{0};
+    };
+
+private:
+    struct Worker
+    {
+        int index{0};
+        long long pid{0};
+        void *process{nullptr};   // Windows process handle
+        bool running{false};
+        CACLocalSocket socket;
+        bool connected{false};
+        double lastSeenMs{0.0};
+        double restartAtMs{0.0};
+        int restarts{0};
+        int crashes{0};           // Consecutive, reset once the worker stays up
+        double startedMs{0.0};
+    };
+
+    struct Camera
+    {
+        std::string cameraId;
+        std::string parametersFile; // Sent along with ASSIGN, empty for the defaults
+        uint32_t hash{0};
+        int worker{-1};           // Worker that has it, -1 for none
+        int target{-1};           // Where the plan puts it
+        bool releasing{false};    // RELEASE sent, waiting for RELEASED
+        CameraStats stats;
+        bool measured{false};
+        double assignedMs{0.0};   // When ASSIGN went out
+        double loadCostMs{0.0};   // Model load and setup time the worker reported, 0 until known
+        std::map<int, double> failedUntilMs; // Workers that reported FAILED for it, skipped until then
+    };
+
+    Config m_stConfig;
+    CACLocalSocket m_cListener;
+    std::vector<Worker> m_vWorkers;
+    std::vector<CACLocalSocket> m_vPending; // Connected, no HELLO yet
+    std::map<std::string, Camera> m_mCameras;
+    std::map<uint32_t, int> m_mRing;        // Virtual node hash -> worker
+    bool m_bPlanDirty;
+    bool m_bMovesDeferred;                  // Plan moves held back by minMoveIntervalMs, retried on the interval
+    double m_dStartedMs;                    // First placement waits for all workers, up to the heartbeat timeout
+    double m_dLastRebalanceMs;
+    long long m_nMoves;
+    long long m_nRebalances;
+
+    static uint32_t Hash(const std::string &key);
+    static double NowMs();
+    bool StartWorker(Worker &worker);
+    void StopWorker(Worker &worker, bool kill);
+    void OnWorkerLost(Worker &worker, const std::string &reason);
+    void HandleMessage(Worker &worker, const std::string &line);
+    void CheckWorkers(double nowMs);
+    void BuildRing();
+    std::map<std::string, int> Plan() const;
+    bool IsOverloaded() const;
+    // Load-driven replans only move cameras off workers over the bound and when that saves more
+    // inference time until the next allowed move than reloading the camera's models costs
+    void Rebalance(bool loadDriven);
+    void Dispatch();
+
+public:
+    CACShardCoordinator();
+    ~CACShardCoordinator();
+
+    bool Start(const Config &config);
+    void Stop();
+    // parametersFile is a JSON file in the layout of ANSCustomData.h the worker applies to the camera
+    void AddCamera(const std::string &cameraId, const std::string &parametersFile = "");
+    void RemoveCamera(const std::string &cameraId);
+    // One round of the event loop: connections, messages, crashed workers, placement
+    void Poll(int timeoutMs);
+    Stats GetStats() const;
+};
+
+#endif // SHARD_COORDINATOR_H
@@ -0,0 +1,272 @@
+#include "ShardWorker.h"
+#include "ANSCustomTrafficLight.h"
+#include "SharedFrameRing.h"
+#include "ParamsJson.h"
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#ifdef _WIN32
+#include <process.h>
+#define GET_PID _getpid
+#else
+#include <unistd.h>
+#define GET_PID getpid
+#endif
+
+CACShardWorker::~CACShardWorker()
+{
+    while (!m_mCameras.empty())
+    {
+        Release(m_mCameras.begin()->first);
+    }
+    FinishReleases(true);
+}
+
+void CACShardWorker::RunCamera(CameraTask &task)
+{
+    // The decoder may come up after the worker
+    CACSharedFrameRing ring;
+    int nCamera = -1;
+    while (task.running)
+    {
+        if (ring.IsOpen() || ring.Open(m_stConfig.frameRing))
+        {
+            nCamera = ring.FindCamera(task.cameraId);
+            if (nCamera >= 0)
+            {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    if (!task.running)
+    {
+        return;
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+    ANSCustomTL customTL;
+    std::string labelMap;
+    if (!customTL.Initialize(m_stConfig.modelDirectory, m_stConfig.detectionScoreThreshold, labelMap))
+    {
+        std::cerr << "Camera " << task.cameraId << ": failed to initialise the models" << std::endl;
+        task.failed = true;
+        return;
+    }
+    // The camera's own ROIs and settings over the defaults Initialize set, before its first frame
+    std::vector<CustomParams> vParams;
+    customTL.ConfigureParamaters(vParams);
+    bool bChanged = false;
+    if (!task.parametersFile.empty())
+    {
+        std::vector<CustomParams> vCamera;
+        std::string sError;
+        if (!CACParamsJson::Load(task.parametersFile, vCamera, sError))
+        {
+            std::cerr << "Camera " << task.cameraId << ": cannot read " << task.parametersFile << ": " << sError << std::endl;
+            task.failed = true;
+            return;
+        }
+        CACParamsJson::Merge(vParams, vCamera);
+        bChanged = true;
+    }
+    if (!m_stConfig.resultStream.empty())
+    {
+        // Every camera of the worker shares the stream
+        for (auto &params : vParams)
+        {
+            if (params.handleId == 0)
+            {
+                params.handleParametersJson.push_back({4, "resultStream", m_stConfig.resultStream + "_w" + std::to_string(m_stConfig.workerIndex)});
+            }
+        }
+        bChanged = true;
+    }
+    if (bChanged)
+    {
+        // Initialize already applied the defaults
+        customTL.SetParamaters(vParams);
+    }
+    {
+        // Tells the coordinator what moving this camera costs
+        std::lock_guard<std::mutex> lock(task.mutex);
+        task.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    }
+
+    uint32_t nLastSequence = 0;
+    while (task.running)
+    {
+        CACSharedFrameRing::Frame stFrame;
+        if (!ring.Acquire(nCamera, nLastSequence, 100, stFrame))
+        {
+            continue;
+        }
+        nLastSequence = stFrame.sequence;
+        auto start = std::chrono::steady_clock::now();
+        // The slot goes back to the decoder on Release, nothing is drawn on it
+        customTL.RunFrame(stFrame.image, cv::Mat(), task.cameraId);
+        ring.Release(nCamera);
+        double dBusyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(task.mutex);
+        ++task.frames;
+        task.busyMs += dBusyMs;
+        task.dropped += stFrame.dropped;
+    }
+}
+
+void CACShardWorker::Assign(const std::string &cameraId, const std::string &parametersFile)
+{
+    if (m_mCameras.count(cameraId))
+    {
+        return;
+    }
+    std::unique_ptr<CameraTask> pTask(new CameraTask());
+    pTask->cameraId = cameraId;
+    pTask->parametersFile = parametersFile;
+    CameraTask *task = pTask.get();
+    pTask->thread = std::thread([this, task]()
+                                {
+        RunCamera(*task);
+        task->finished = true; });
+    m_mCameras[cameraId] = std::move(pTask);
+    std::cout << "Worker " << m_stConfig.workerIndex << ": camera " << cameraId << " assigned" << std::endl;
+}
+
+void CACShardWorker::Release(const std::string &cameraId)
+{
+    // A camera may still be loading its models, the loop keeps serving the coordinator meanwhile
+    auto camera = m_mCameras.find(cameraId);
+    if (camera == m_mCameras.end())
+    {
+        m_cSocket.Send("RELEASED " + cameraId);
+        return;
+    }
+    camera->second->running = false;
+    m_mReleasing[cameraId] = std::move(camera->second);
+    m_mCameras.erase(camera);
+}
+
+void CACShardWorker::FinishReleases(bool wait)
+{
+    // The frame ring slot is released before RELEASED goes out, the next worker is its only reader
+    for (auto camera = m_mReleasing.begin(); camera != m_mReleasing.end();)
+    {
+        if (!wait && !camera->second->finished)
+        {
+            ++camera;
+            continue;
+        }
+        camera->second->thread.join();
+        m_cSocket.Send("RELEASED " + camera->first);
+        std::cout << "Worker " << m_stConfig.workerIndex << ": camera " << camera->first << " released" << std::endl;
+        camera = m_mReleasing.erase(camera);
+    }
+}
+
+void CACShardWorker::FinishFailures()
+{
+    for (auto camera = m_mCameras.begin(); camera != m_mCameras.end();)
+    {
+        if (!camera->second->failed || !camera->second->finished)
+        {
+            ++camera;
+            continue;
+        }
+        camera->second->thread.join();
+        m_cSocket.Send("FAILED " + camera->first);
+        std::cerr << "Worker " << m_stConfig.workerIndex << ": camera " << camera->first << " failed" << std::endl;
+        camera = m_mCameras.erase(camera);
+    }
+}
+
+void CACShardWorker::Report(double elapsedMs)
+{
+    double dSeconds = (std::max)(elapsedMs, 1.0) / 1000.0;
+    for (auto &camera : m_mCameras)
+    {
+        CameraTask &task = *camera.second;
+        long long nFrames, nDropped;
+        double dBusyMs, dLoadMs;
+        {
+            std::lock_guard<std::mutex> lock(task.mutex);
+            dLoadMs = task.loadMs;
+            task.loadMs = -1.0;
+            nFrames = task.frames;
+            nDropped = task.dropped;
+            dBusyMs = task.busyMs;
+            task.frames = 0;
+            task.dropped = 0;
+            task.busyMs = 0.0;
+        }
+        if (dLoadMs >= 0.0)
+        {
+            m_cSocket.Send("LOADED " + task.cameraId + " " + std::to_string(dLoadMs));
+        }
+        std::ostringstream ss;
+        ss << "METRICS " << task.cameraId << " " << nFrames / dSeconds << " " << dBusyMs / dSeconds << " "
+           << (nFrames > 0 ? dBusyMs / nFrames : 0.0) << " " << nFrames << " " << nDropped;
+        m_cSocket.Send(ss.str());
+    }
+    m_cSocket.Send("HEARTBEAT");
+}
+
+int CACShardWorker::Run(const Config &config)
+{
+    m_stConfig = config;
+    if (!m_cSocket.Connect(m_stConfig.socketPath))
+    {
+        std::cerr << "Worker " << m_stConfig.workerIndex << ": cannot connect to " << m_stConfig.socketPath << std::endl;
+        return 1;
+    }
+    m_cSocket.Send("HELLO " + std::to_string(m_stConfig.workerIndex) + " " + std::to_string((long long)GET_PID()));
+
+    auto lastReport = std::chrono::steady_clock::now();
+    while (true)
+    {
+        std::string sLine;
+        int nResult = m_cSocket.Receive(sLine, 100);
+        if (nResult < 0)
+        {
+            // Without a coordinator nobody places the cameras, they go back to the restarted one
+            std::cerr << "Worker " << m_stConfig.workerIndex << ": coordinator connection lost" << std::endl;
+            return 1;
+        }
+        if (nResult > 0)
+        {
+            std::istringstream ss(sLine);
+            std::string sCommand, sCameraId;
+            ss >> sCommand >> sCameraId;
+            if (sCommand == "ASSIGN" && !sCameraId.empty())
+            {
+                // The rest of the line is the parameter file, which may contain spaces
+                std::string sParametersFile;
+                std::getline(ss >> std::ws, sParametersFile);
+                Assign(sCameraId, sParametersFile);
+            }
+            else if (sCommand == "RELEASE" && !sCameraId.empty())
+            {
+                Release(sCameraId);
+            }
+            else if (sCommand == "STOP")
+            {
+                while (!m_mCameras.empty())
+                {
+                    Release(m_mCameras.begin()->first);
+                }
+                FinishReleases(true);
+                return 0;
+            }
+        }
+        FinishReleases(false);
+        FinishFailures();
+
+        auto now = std::chrono::steady_clock::now();
+        double dElapsedMs = std::chrono::duration<double, std::milli>(now - lastReport).count();
+        if (dElapsedMs >= m_stConfig.reportIntervalMs)
+        {
+            Report(dElapsedMs);
+            lastReport = now;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SHARD_WORKER_H
+#define SHARD_WORKER_H
+#pragma once
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "LocalSocket.h"
+
+// Worker process of a CACShardCoordinator. Connects back over the coordinator's local socket and
+// hosts the cameras it is given: one ANSCustomTL per camera on its own thread, fed from the shared
+// frame ring of the decoder process and set up with the camera's parameter file before its first
+// frame. Once a second it reports, per camera, the frame rate and the
+// inference milliseconds per second the coordinator places cameras by, which also serve as its
+// heartbeat. With a result stream configured, every worker publishes to its own ring named
+// <resultStream>_w<index>, a result stream has a single producer process.
+class CACShardWorker
+{
+public:
+    struct Config
+    {
+        std::string socketPath;
+        int workerIndex{0};
+        std::string frameRing;      // CACSharedFrameRing the decoder writes
+        std::string modelDirectory;
+        float detectionScoreThreshold{0.5f};
+        std::string resultStream;   // Empty for none
+        int reportIntervalMs{1000};
+    };
+
+private:
+    struct CameraTask
+    {
+        std::string cameraId;
+        std::string parametersFile; // JSON parameters applied over the defaults, empty for none
+        std::thread thread;
+        std::atomic<bool> running{true};
+        std::atomic<bool> finished{false};
+        std::atomic<bool> failed{false}; // Could not be set up, reported as FAILED instead of running
+        std::mutex mutex;           // Guards the counters below
+        long long frames{0};
+        double busyMs{0.0};
+        long long dropped{0};
+        double loadMs{-1.0};        // Model load and setup time, reported once as LOADED
+    };
+
+    Config m_stConfig;
+    CACLocalSocket m_cSocket;
+    std::map<std::string, std::unique_ptr<CameraTask>> m_mCameras;
+    std::map<std::string, std::unique_ptr<CameraTask>> m_mReleasing; // Stopping, RELEASED once their thread ended
+
+    void RunCamera(CameraTask &task);
+    void Assign(const std::string &cameraId, const std::string &parametersFile);
+    void Release(const std::string &cameraId);
+    // Joins the released cameras whose thread ended, all of them when wait is set
+    void FinishReleases(bool wait);
+    // Removes the cameras that could not be set up and tells the coordinator to place them elsewhere
+    void FinishFailures();
+    void Report(double elapsedMs);
+
+public:
+    ~CACShardWorker();
+    // Serves the coordinator until STOP (0) or until the connection is lost (non-zero)
+    int Run(const Config &config);
+};
+
+#endif // SHARD_WORKER_H
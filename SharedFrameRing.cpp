@@ -0,0 +1,316 @@
+#include "SharedFrameRing.h"
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Every header and pixel area starts on its own cache line
+static size_t AlignBlock(size_t bytes)
+{
+    return (bytes + 63) & ~(size_t)63;
+}
+
+CACSharedFrameRing::CACSharedFrameRing()
+{
+    m_pBase = nullptr;
+    m_pHeader = nullptr;
+}
+
+CACSharedFrameRing::~CACSharedFrameRing()
+{
+    Close();
+}
+
+CACSharedFrameRing::CameraHeader *CACSharedFrameRing::GetCamera(int camera) const
+{
+    return reinterpret_cast<CameraHeader *>(m_pBase + AlignBlock(sizeof(RingHeader)) + camera * AlignBlock(sizeof(CameraHeader)));
+}
+
+CACSharedFrameRing::SlotHeader *CACSharedFrameRing::GetSlot(int camera, int slot) const
+{
+    size_t slotsOffset = AlignBlock(sizeof(RingHeader)) + m_pHeader->cameras * AlignBlock(sizeof(CameraHeader));
+    size_t slotStride = AlignBlock(sizeof(SlotHeader)) + AlignBlock((size_t)m_pHeader->slotBytes);
+    return reinterpret_cast<SlotHeader *>(m_pBase + slotsOffset + ((size_t)camera * m_pHeader->slotsPerCamera + slot) * slotStride);
+}
+
+unsigned char *CACSharedFrameRing::GetPixels(int camera, int slot) const
+{
+    return reinterpret_cast<unsigned char *>(GetSlot(camera, slot)) + AlignBlock(sizeof(SlotHeader));
+}
+
+void CACSharedFrameRing::OpenEvents()
+{
+#ifdef _WIN32
+    // Auto-reset: a frame published before the reader waits leaves the event set
+    for (uint32_t camera = 0; camera < m_pHeader->cameras; ++camera)
+    {
+        std::string eventName = "Local\\" + m_cMemory.GetName() + "_frame_" + std::to_string(camera);
+        m_vEvents.push_back(CreateEventA(NULL, FALSE, FALSE, eventName.c_str()));
+    }
+#endif
+}
+
+bool CACSharedFrameRing::Create(const std::string &name, const std::vector<std::string> &cameraIds, int slotsPerCamera, size_t slotBytes)
+{
+    Close();
+    if (cameraIds.empty() || slotBytes == 0)
+    {
+        return false;
+    }
+    slotsPerCamera = (std::max)(slotsPerCamera, (int)MIN_SLOTS);
+    size_t slotStride = AlignBlock(sizeof(SlotHeader)) + AlignBlock(slotBytes);
+    size_t totalBytes = AlignBlock(sizeof(RingHeader)) + cameraIds.size() * AlignBlock(sizeof(CameraHeader)) +
+                        cameraIds.size() * slotsPerCamera * slotStride;
+
+    if (!m_cMemory.Create(name, totalBytes))
+    {
+        std::cerr << "Shared frame ring " << name << ": cannot create " << totalBytes << " bytes" << std::endl;
+        return false;
+    }
+    m_pBase = m_cMemory.GetData();
+
+    // The magic is written last, a reader opening the block early sees it is not ready
+    m_pHeader = reinterpret_cast<RingHeader *>(m_pBase);
+    m_pHeader->magic = 0;
+    m_pHeader->version = RING_VERSION;
+    m_pHeader->cameras = (uint32_t)cameraIds.size();
+    m_pHeader->slotsPerCamera = (uint32_t)slotsPerCamera;
+    m_pHeader->slotBytes = slotBytes;
+    m_pHeader->totalBytes = totalBytes;
+    for (int camera = 0; camera < (int)cameraIds.size(); ++camera)
+    {
+        CameraHeader *header = new (GetCamera(camera)) CameraHeader();
+        std::strncpy(header->cameraId, cameraIds[camera].c_str(), MAX_CAMERA_ID - 1);
+        header->cameraId[MAX_CAMERA_ID - 1] = '\0';
+        header->published.store(0);
+        header->heldSlot.store(NO_SLOT);
+        header->lastSlot = (uint32_t)slotsPerCamera - 1;
+        for (int slot = 0; slot < slotsPerCamera; ++slot)
+        {
+            SlotHeader *slotHeader = new (GetSlot(camera, slot)) SlotHeader();
+            slotHeader->sequence.store(0);
+        }
+    }
+    m_vPendingSlots.assign(cameraIds.size(), -1);
+    OpenEvents();
+    std::atomic_thread_fence(std::memory_order_release);
+    m_pHeader->magic = RING_MAGIC;
+    return true;
+}
+
+bool CACSharedFrameRing::Open(const std::string &name)
+{
+    Close();
+    if (!m_cMemory.Open(name))
+    {
+        return false;
+    }
+    m_pBase = m_cMemory.GetData();
+    m_pHeader = reinterpret_cast<RingHeader *>(m_pBase);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_cMemory.GetSize() < sizeof(RingHeader) || m_pHeader->magic != RING_MAGIC || m_pHeader->version != RING_VERSION ||
+        m_pHeader->totalBytes > m_cMemory.GetSize())
+    {
+        std::cerr << "Shared frame ring " << name << ": not ready or incompatible" << std::endl;
+        Close();
+        return false;
+    }
+    OpenEvents();
+    return true;
+}
+
+void CACSharedFrameRing::Close()
+{
+#ifdef _WIN32
+    for (void *event : m_vEvents)
+    {
+        if (event)
+        {
+            CloseHandle(event);
+        }
+    }
+    m_vEvents.clear();
+#endif
+    m_cMemory.Close();
+    m_pBase = nullptr;
+    m_pHeader = nullptr;
+    m_vPendingSlots.clear();
+}
+
+int CACSharedFrameRing::FindCamera(const std::string &cameraId) const
+{
+    if (!m_pHeader)
+    {
+        return -1;
+    }
+    for (uint32_t camera = 0; camera < m_pHeader->cameras; ++camera)
+    {
+        if (std::strncmp(GetCamera(camera)->cameraId, cameraId.c_str(), MAX_CAMERA_ID) == 0)
+        {
+            return (int)camera;
+        }
+    }
+    return -1;
+}
+
+void CACSharedFrameRing::Notify(int camera)
+{
+#ifdef _WIN32
+    if (camera < (int)m_vEvents.size() && m_vEvents[camera])
+    {
+        SetEvent(m_vEvents[camera]);
+    }
+#else
+    CACSharedMemory::WakeWord(GetCamera(camera)->published);
+#endif
+}
+
+void CACSharedFrameRing::Wait(int camera, uint32_t sequence, int timeoutMs)
+{
+    CameraHeader *header = GetCamera(camera);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (header->published.load(std::memory_order_acquire) == sequence)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+        {
+            return;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(m_vEvents[camera], (DWORD)((remaining + 999) / 1000));
+#else
+        CACSharedMemory::WaitWord(header->published, sequence, remaining);
+#endif
+    }
+}
+
+cv::Mat CACSharedFrameRing::BeginWrite(int camera, const cv::Size &size, int type)
+{
+    if (!m_pHeader || camera < 0 || camera >= (int)m_pHeader->cameras)
+    {
+        return cv::Mat();
+    }
+    size_t step = (size_t)size.width * CV_ELEM_SIZE(type);
+    if (step * size.height > m_pHeader->slotBytes)
+    {
+        return cv::Mat();
+    }
+
+    // The slot after the last written one that the reader does not hold. It is marked empty before
+    // heldSlot is checked, and the reader sets heldSlot before checking the slot's sequence, so one
+    // of the two always sees the other.
+    CameraHeader *header = GetCamera(camera);
+    uint32_t slots = m_pHeader->slotsPerCamera;
+    for (uint32_t i = 1; i <= slots; ++i)
+    {
+        uint32_t slot = (header->lastSlot + i) % slots;
+        SlotHeader *slotHeader = GetSlot(camera, slot);
+        uint32_t previous = slotHeader->sequence.exchange(0);
+        if (header->heldSlot.load() == slot)
+        {
+            slotHeader->sequence.store(previous);
+            continue;
+        }
+        slotHeader->width = size.width;
+        slotHeader->height = size.height;
+        slotHeader->type = type;
+        slotHeader->step = step;
+        m_vPendingSlots[camera] = (int)slot;
+        return cv::Mat(size, type, GetPixels(camera, slot), step);
+    }
+    return cv::Mat();
+}
+
+void CACSharedFrameRing::CommitWrite(int camera, double timestampMs)
+{
+    if (!m_pHeader || camera < 0 || camera >= (int)m_vPendingSlots.size() || m_vPendingSlots[camera] < 0)
+    {
+        return;
+    }
+    CameraHeader *header = GetCamera(camera);
+    int slot = m_vPendingSlots[camera];
+    m_vPendingSlots[camera] = -1;
+
+    // Sequence 0 marks a slot being written, so the counter skips it when it wraps
+    uint32_t sequence = header->published.load(std::memory_order_relaxed) + 1;
+    if (sequence == 0)
+    {
+        sequence = 1;
+    }
+    SlotHeader *slotHeader = GetSlot(camera, slot);
+    slotHeader->timestampMs = timestampMs;
+    slotHeader->sequence.store(sequence, std::memory_order_release);
+    header->lastSlot = (uint32_t)slot;
+    header->published.store(sequence, std::memory_order_release);
+    Notify(camera);
+}
+
+bool CACSharedFrameRing::Write(int camera, const cv::Mat &frame, double timestampMs)
+{
+    cv::Mat view = BeginWrite(camera, frame.size(), frame.type());
+    if (view.empty())
+    {
+        return false;
+    }
+    frame.copyTo(view);
+    CommitWrite(camera, timestampMs);
+    return true;
+}
+
+bool CACSharedFrameRing::Acquire(int camera, uint32_t lastSequence, int timeoutMs, Frame &frame)
+{
+    if (!m_pHeader || camera < 0 || camera >= (int)m_pHeader->cameras)
+    {
+        return false;
+    }
+    CameraHeader *header = GetCamera(camera);
+    Wait(camera, lastSequence, timeoutMs);
+
+    // The writer may reuse the slot of the newest frame while it is looked up; the hold is only
+    // valid once the slot still carries that sequence after heldSlot was set
+    for (int attempt = 0; attempt < 8; ++attempt)
+    {
+        uint32_t sequence = header->published.load(std::memory_order_acquire);
+        if (sequence == lastSequence || sequence == 0)
+        {
+            return false;
+        }
+        int found = -1;
+        for (uint32_t slot = 0; slot < m_pHeader->slotsPerCamera && found < 0; ++slot)
+        {
+            if (GetSlot(camera, slot)->sequence.load(std::memory_order_acquire) == sequence)
+            {
+                found = (int)slot;
+            }
+        }
+        if (found < 0)
+        {
+            continue;
+        }
+        header->heldSlot.store((uint32_t)found);
+        SlotHeader *slotHeader = GetSlot(camera, found);
+        if (slotHeader->sequence.load() != sequence)
+        {
+            header->heldSlot.store(NO_SLOT);
+            continue;
+        }
+
+        frame.image = cv::Mat(slotHeader->height, slotHeader->width, slotHeader->type, GetPixels(camera, found), (size_t)slotHeader->step);
+        frame.sequence = sequence;
+        frame.dropped = lastSequence == 0 ? 0 : sequence - lastSequence - 1;
+        frame.timestampMs = slotHeader->timestampMs;
+        return true;
+    }
+    return false;
+}
+
+void CACSharedFrameRing::Release(int camera)
+{
+    if (m_pHeader && camera >= 0 && camera < (int)m_pHeader->cameras)
+    {
+        GetCamera(camera)->heldSlot.store(NO_SLOT);
+    }
+}
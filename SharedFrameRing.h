@@ -0,0 +1,108 @@
+#ifndef SHARED_FRAME_RING_H
+#define SHARED_FRAME_RING_H
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "SharedMemory.h"
+
+// Frame transport from a decoder process into the process hosting ANSCustomTL, through one named
+// shared-memory block. Every camera has its own group of slots (at least 3). The decoder writes
+// each frame once, straight into a free slot, and publishes its sequence number; the reader maps
+// the newest published slot as a cv::Mat view and holds it until Release, the decoder never writes
+// into a held slot. Frames the reader did not get to are overwritten, the newest one always wins.
+//
+// One writer and one reader per camera. The reader waits on the camera's published sequence:
+// a shared futex on Linux, a named auto-reset event on Windows.
+class CACSharedFrameRing
+{
+public:
+    static const int MAX_CAMERA_ID = 64;
+    static const int MIN_SLOTS = 3;
+
+    struct Frame
+    {
+        cv::Mat image;          // View into the shared slot, valid until Release
+        uint32_t sequence{0};
+        uint32_t dropped{0};    // Frames published since the previous one the reader got
+        double timestampMs{0.0};
+    };
+
+private:
+    struct RingHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t cameras;
+        uint32_t slotsPerCamera;
+        uint64_t slotBytes;
+        uint64_t totalBytes;
+    };
+
+    struct CameraHeader
+    {
+        char cameraId[MAX_CAMERA_ID];
+        std::atomic<uint32_t> published; // Sequence of the newest frame, also the futex word
+        std::atomic<uint32_t> heldSlot;  // Slot the reader holds, NO_SLOT when none
+        uint32_t lastSlot;               // Writer only
+        uint32_t reserved;
+    };
+
+    struct SlotHeader
+    {
+        std::atomic<uint32_t> sequence; // 0 while the writer fills the slot
+        int32_t width;
+        int32_t height;
+        int32_t type;
+        uint64_t step;
+        double timestampMs;
+    };
+
+    static const uint32_t RING_MAGIC = 0x52464341; // "ACFR"
+    static const uint32_t RING_VERSION = 1;
+    static const uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+    CACSharedMemory m_cMemory;
+    unsigned char *m_pBase;
+    RingHeader *m_pHeader;
+    std::vector<int> m_vPendingSlots; // Writer: slot between BeginWrite and CommitWrite, per camera
+
+#ifdef _WIN32
+    std::vector<void *> m_vEvents;
+#endif
+
+    CameraHeader *GetCamera(int camera) const;
+    SlotHeader *GetSlot(int camera, int slot) const;
+    unsigned char *GetPixels(int camera, int slot) const;
+    void OpenEvents();
+    void Notify(int camera);
+    // Waits until published differs from sequence or the timeout passes
+    void Wait(int camera, uint32_t sequence, int timeoutMs);
+
+public:
+    CACSharedFrameRing();
+    ~CACSharedFrameRing();
+
+    // Decoder side: creates the block for the cameras, slotBytes is the largest frame (rows * step)
+    bool Create(const std::string &name, const std::vector<std::string> &cameraIds, int slotsPerCamera, size_t slotBytes);
+    // Inference side: maps an existing block
+    bool Open(const std::string &name);
+    void Close();
+    bool IsOpen() const { return m_pHeader != nullptr; }
+    int FindCamera(const std::string &cameraId) const;
+
+    // Writer: a view over a free slot of the camera for a frame of this size and type, filled in
+    // place (e.g. by cv::VideoCapture::read); CommitWrite publishes it. Empty when it does not fit.
+    cv::Mat BeginWrite(int camera, const cv::Size &size, int type);
+    void CommitWrite(int camera, double timestampMs);
+    // Writer: copies a frame that was decoded elsewhere
+    bool Write(int camera, const cv::Mat &frame, double timestampMs);
+
+    // Reader: the newest frame after lastSequence, waiting up to timeoutMs for one
+    bool Acquire(int camera, uint32_t lastSequence, int timeoutMs, Frame &frame);
+    void Release(int camera);
+};
+
+#endif // SHARED_FRAME_RING_H
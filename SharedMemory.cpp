@@ -0,0 +1,252 @@
+#include "SharedMemory.h"
+#include <chrono>
+#include <thread>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <climits>
+#endif
+#endif
+
+static const uint32_t BLOCK_MAGIC = 0x4B4C4241; // "ABLK"
+
+CACSharedMemory::CACSharedMemory()
+{
+    m_bOwner = false;
+    m_pBase = nullptr;
+    m_nBytes = 0;
+#ifdef _WIN32
+    m_hMapping = nullptr;
+#else
+    m_nFd = -1;
+#endif
+}
+
+CACSharedMemory::~CACSharedMemory()
+{
+    Close();
+}
+
+bool CACSharedMemory::Map(size_t bytes, bool create)
+{
+#ifdef _WIN32
+    std::string mappingName = "Local\\" + m_sName;
+    HANDLE mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32),
+                                                 (DWORD)(bytes & 0xFFFFFFFFu), mappingName.c_str())
+                            : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+    if (!mapping)
+    {
+        return false;
+    }
+    if (create && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        // Someone else's block, not ours to initialise
+        CloseHandle(mapping);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, create ? bytes : 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    if (!create)
+    {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(view, &info, sizeof(info));
+        bytes = info.RegionSize;
+    }
+    m_hMapping = mapping;
+#else
+    std::string shmName = "/" + m_sName;
+    int fd = shm_open(shmName.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (create && ftruncate(fd, (off_t)bytes) != 0)
+    {
+        close(fd);
+        shm_unlink(shmName.c_str());
+        return false;
+    }
+    if (!create)
+    {
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        bytes = (size_t)info.st_size;
+    }
+    void *view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        if (create)
+        {
+            shm_unlink(shmName.c_str());
+        }
+        return false;
+    }
+    m_nFd = fd;
+#endif
+    m_pBase = static_cast<unsigned char *>(view);
+    m_nBytes = bytes;
+    return true;
+}
+
+bool CACSharedMemory::IsProcessAlive(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!process)
+    {
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+bool CACSharedMemory::RemoveStale()
+{
+    if (!Map(0, false))
+    {
+        return false;
+    }
+    const BlockHeader *header = reinterpret_cast<const BlockHeader *>(m_pBase);
+    // A block without the magic is still being set up by its creator
+    bool stale = m_nBytes >= HEADER_BYTES && header->magic == BLOCK_MAGIC && !IsProcessAlive(header->ownerPid);
+    uint32_t ownerPid = m_nBytes >= HEADER_BYTES ? header->ownerPid : 0;
+    Close();
+    if (!stale)
+    {
+        std::cerr << "Shared memory " << m_sName << ": in use by process " << ownerPid << std::endl;
+        return false;
+    }
+#ifdef _WIN32
+    // The name goes away with the last handle, which the readers still hold
+    std::cerr << "Shared memory " << m_sName << ": left by process " << ownerPid << ", still open in readers" << std::endl;
+    return false;
+#else
+    // Readers of the old block keep their view; new ones open the block created next
+    std::cerr << "Shared memory " << m_sName << ": taking over from exited process " << ownerPid << std::endl;
+    return shm_unlink(("/" + m_sName).c_str()) == 0 || errno == ENOENT;
+#endif
+}
+
+bool CACSharedMemory::Create(const std::string &name, size_t bytes)
+{
+    Close();
+    m_sName = name;
+    if (bytes == 0)
+    {
+        return false;
+    }
+    if (!Map(HEADER_BYTES + bytes, true) && !(RemoveStale() && Map(HEADER_BYTES + bytes, true)))
+    {
+        return false;
+    }
+    m_bOwner = true;
+
+    // The magic is written last, a creator that finds the name taken before then leaves it alone
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(m_pBase);
+#ifdef _WIN32
+    header->ownerPid = (uint32_t)GetCurrentProcessId();
+#else
+    header->ownerPid = (uint32_t)getpid();
+#endif
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = BLOCK_MAGIC;
+    return true;
+}
+
+bool CACSharedMemory::Open(const std::string &name)
+{
+    Close();
+    m_sName = name;
+    if (!Map(0, false))
+    {
+        return false;
+    }
+    if (m_nBytes < HEADER_BYTES)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CACSharedMemory::Close()
+{
+#ifdef _WIN32
+    if (m_pBase)
+    {
+        UnmapViewOfFile(m_pBase);
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+#else
+    if (m_pBase)
+    {
+        munmap(m_pBase, m_nBytes);
+    }
+    if (m_nFd >= 0)
+    {
+        close(m_nFd);
+        m_nFd = -1;
+    }
+    if (m_bOwner)
+    {
+        // Readers keep their mapping, the name is gone for new ones
+        shm_unlink(("/" + m_sName).c_str());
+    }
+#endif
+    m_pBase = nullptr;
+    m_nBytes = 0;
+    m_bOwner = false;
+}
+
+void CACSharedMemory::WaitWord(std::atomic<uint32_t> &word, uint32_t value, long long timeoutUs)
+{
+    if (timeoutUs <= 0 || word.load(std::memory_order_acquire) != value)
+    {
+        return;
+    }
+#ifdef __linux__
+    // Not FUTEX_PRIVATE: the waker is in another process. Returns at once when the word already moved on.
+    struct timespec timeout;
+    timeout.tv_sec = (time_t)(timeoutUs / 1000000);
+    timeout.tv_nsec = (long)(timeoutUs % 1000000) * 1000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds((std::min)(timeoutUs, 1000LL)));
+#endif
+}
+
+void CACSharedMemory::WakeWord(std::atomic<uint32_t> &word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// One named block of shared memory: a file mapping under Local\ on Windows, a POSIX shm object
+// elsewhere. The process that created the block removes the name when it closes it; processes that
+// still have it mapped keep their view. Creation is exclusive: a block whose creator is still alive
+// is never re-initialised under its readers. A block left behind by a creator that died is unlinked
+// and created anew (POSIX; on Windows the name lives only as long as a handle to it, so a second
+// creator fails until the readers of the old block let go).
+class CACSharedMemory
+{
+private:
+    // Leads the block, ahead of the caller's data
+    struct BlockHeader
+    {
+        uint32_t magic;
+        uint32_t ownerPid; // Process that created the block
+    };
+    static const size_t HEADER_BYTES = 64; // Keeps the data on its own cache line
+
+    std::string m_sName;
+    bool m_bOwner;
+    unsigned char *m_pBase; // Start of the mapping, the block header
+    size_t m_nBytes;        // Mapped bytes, header included
+
+#ifdef _WIN32
+    void *m_hMapping;
+#else
+    int m_nFd;
+#endif
+
+    bool Map(size_t bytes, bool create);
+    // Unlinks the existing block of this name when its creator is gone
+    bool RemoveStale();
+    static bool IsProcessAlive(uint32_t pid);
+
+public:
+    CACSharedMemory();
+    ~CACSharedMemory();
+    CACSharedMemory(const CACSharedMemory &) = delete;
+    CACSharedMemory &operator=(const CACSharedMemory &) = delete;
+
+    // New zero-filled block of the given size; fails while another live process owns the name
+    bool Create(const std::string &name, size_t bytes);
+    bool Open(const std::string &name);
+    void Close();
+    bool IsOpen() const { return m_pBase != nullptr; }
+    unsigned char *GetData() const { return m_pBase ? m_pBase + HEADER_BYTES : nullptr; }
+    size_t GetSize() const { return m_pBase ? m_nBytes - HEADER_BYTES : 0; }
+    const std::string &GetName() const { return m_sName; }
+
+    // Cross-process wait on a 32-bit word inside a block: returns once it no longer holds value,
+    // on a wake, or after timeoutUs. A futex on Linux; a short sleep elsewhere, callers re-check.
+    static void WaitWord(std::atomic<uint32_t> &word, uint32_t value, long long timeoutUs);
+    static void WakeWord(std::atomic<uint32_t> &word);
+};
+
+#endif // SHARED_MEMORY_H
@@ -0,0 +1,134 @@
+#include "StageGraph.h"
+#include <chrono>
+#include <iostream>
+#include <set>
+
+CACStageGraph::CACStageGraph()
+{
+    m_dCostAlpha = 0.1;
+}
+
+int CACStageGraph::AddStage(const std::string &name, Action run, Condition needed, Action fallback, const std::vector<int> &after)
+{
+    Stage stage;
+    stage.stats.name = name;
+    stage.run = run;
+    stage.needed = needed;
+    stage.fallback = fallback;
+    stage.after = after;
+    m_vStages.push_back(stage);
+    return (int)m_vStages.size() - 1;
+}
+
+void CACStageGraph::Register(const std::string &name, const StageDef &stage)
+{
+    m_mRegistry[name] = stage;
+}
+
+bool CACStageGraph::Configure(const std::vector<std::string> &stages)
+{
+    bool result = true;
+    std::map<std::string, int> ids;
+    Clear();
+    for (const auto &name : stages)
+    {
+        auto stage = m_mRegistry.find(name);
+        if (stage == m_mRegistry.end())
+        {
+            std::cerr << "Unknown stage " << name << std::endl;
+            result = false;
+            continue;
+        }
+        if (ids.count(name) == 0)
+        {
+            ids[name] = AddStage(name, stage->second.run, stage->second.needed, stage->second.fallback);
+        }
+    }
+
+    // Dependencies are resolved once every configured stage has its id, so the list order is free.
+    // A stage left out passes its own dependencies on, so the order of the remaining ones holds.
+    for (auto &stage : m_vStages)
+    {
+        std::vector<std::string> pending = m_mRegistry[stage.stats.name].after;
+        std::set<std::string> visited;
+        while (!pending.empty())
+        {
+            std::string name = pending.back();
+            pending.pop_back();
+            if (!visited.insert(name).second)
+            {
+                continue;
+            }
+            auto dependency = ids.find(name);
+            if (dependency != ids.end())
+            {
+                stage.after.push_back(dependency->second);
+            }
+            else if (m_mRegistry.count(name))
+            {
+                const auto &after = m_mRegistry[name].after;
+                pending.insert(pending.end(), after.begin(), after.end());
+            }
+        }
+    }
+    return result;
+}
+
+void CACStageGraph::Run()
+{
+    std::vector<bool> done(m_vStages.size(), false);
+    for (size_t step = 0; step < m_vStages.size(); ++step)
+    {
+        // Cheapest ready stage first; stages never measured keep their declaration order
+        int next = -1;
+        for (size_t i = 0; i < m_vStages.size(); ++i)
+        {
+            if (done[i])
+            {
+                continue;
+            }
+            bool ready = true;
+            for (int dependency : m_vStages[i].after)
+            {
+                ready = ready && done[dependency];
+            }
+            if (ready && (next < 0 || m_vStages[i].stats.meanMs < m_vStages[next].stats.meanMs))
+            {
+                next = (int)i;
+            }
+        }
+        if (next < 0)
+        {
+            break; // Dependency cycle, the remaining stages cannot run
+        }
+
+        Stage &stage = m_vStages[next];
+        done[next] = true;
+        if (stage.needed && !stage.needed())
+        {
+            stage.stats.skipped++;
+            if (stage.fallback)
+            {
+                stage.fallback();
+            }
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        stage.run();
+        stage.stats.lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stage.stats.meanMs = stage.stats.runs == 0 ? stage.stats.lastMs
+                                                   : stage.stats.meanMs + m_dCostAlpha * (stage.stats.lastMs - stage.stats.meanMs);
+        stage.stats.runs++;
+    }
+}
+
+std::vector<CACStageGraph::StageStats> CACStageGraph::GetStats() const
+{
+    std::vector<StageStats> stats;
+    for (const auto &stage : m_vStages)
+    {
+        stats.push_back(stage.stats);
+    }
+    return stats;
+}
@@ -0,0 +1,72 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <map>
+
+// Small conditional execution graph for the per-frame work of a camera. Every stage declares the
+// stages it must run after and, optionally, a condition telling whether it is needed for this
+// frame. Among the stages that are ready, the one with the lowest measured cost runs first, so a
+// cheap stage can decide that an expensive one cannot change the outcome; a stage that is not
+// needed runs its fallback (e.g. reuse of the last results) instead and is counted as skipped.
+// Stages are registered by name and Configure picks the ones that run, so a node can leave out
+// what it does not use; each run is timed.
+class CACStageGraph
+{
+public:
+    typedef std::function<void()> Action;
+    typedef std::function<bool()> Condition;
+
+    struct StageStats
+    {
+        std::string name;
+        long long runs{0};
+        long long skipped{0};
+        double meanMs{0.0}; // Moving average of the run time, used to order ready stages
+        double lastMs{0.0};
+    };
+
+    struct StageDef
+    {
+        Action run;
+        Condition needed;
+        Action fallback;
+        std::vector<std::string> after; // Stages left out of the configuration stand for their own dependencies
+    };
+
+private:
+    struct Stage
+    {
+        StageStats stats;
+        Action run;
+        Condition needed;
+        Action fallback;
+        std::vector<int> after;
+    };
+
+    std::vector<Stage> m_vStages;
+    std::map<std::string, StageDef> m_mRegistry;
+    double m_dCostAlpha;
+
+public:
+    CACStageGraph();
+
+    // Returns the stage id used in the after lists of later stages
+    int AddStage(const std::string &name, Action run, Condition needed = Condition(), Action fallback = Action(),
+                 const std::vector<int> &after = std::vector<int>());
+    void Clear() { m_vStages.clear(); }
+
+    // Makes a stage available to Configure, replacing one of the same name
+    void Register(const std::string &name, const StageDef &stage);
+    // Rebuilds the graph from the registered stages named in stages; false when a name is unknown
+    bool Configure(const std::vector<std::string> &stages);
+    bool Empty() const { return m_vStages.empty(); }
+
+    // Runs one frame through the graph
+    void Run();
+    std::vector<StageStats> GetStats() const;
+};
+
+#endif // STAGE_GRAPH_H
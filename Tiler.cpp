@@ -0,0 +1,223 @@
+#include "Tiler.h"
+#include <chrono>
+#include <numeric>
+#include <cmath>
+
+CACTiler::CACTiler()
+{
+    m_nTileSize = 640;
+    m_fOverlap = 0.2f;
+    m_nMaxTiles = 6;
+    m_fMergeIoU = 0.5f;
+    m_fSeamIoS = 0.8f;
+    m_bWeightedFusion = false;
+}
+
+void CACTiler::Configure(int tileSize, float overlap, int maxTiles, float mergeIoU, bool weightedFusion)
+{
+    m_nTileSize = (std::max)(32, tileSize);
+    m_fOverlap = (std::min)((std::max)(overlap, 0.0f), 0.9f);
+    m_nMaxTiles = (std::max)(1, maxTiles);
+    m_fMergeIoU = (std::min)((std::max)(mergeIoU, 0.0f), 1.0f);
+    m_bWeightedFusion = weightedFusion;
+}
+
+std::vector<cv::Rect> CACTiler::ComputeTiles(const cv::Rect &area) const
+{
+    std::vector<cv::Rect> tiles;
+    if (area.width <= 0 || area.height <= 0)
+    {
+        return tiles;
+    }
+
+    // Grow the tile until the grid fits into the budget
+    int tileSize = m_nTileSize;
+    int cols = 1;
+    int rows = 1;
+    while (true)
+    {
+        int stride = (std::max)(1, (int)std::lround(tileSize * (1.0f - m_fOverlap)));
+        cols = (area.width <= tileSize) ? 1 : 1 + (int)std::ceil((area.width - tileSize) / (double)stride);
+        rows = (area.height <= tileSize) ? 1 : 1 + (int)std::ceil((area.height - tileSize) / (double)stride);
+        if (cols * rows <= m_nMaxTiles)
+        {
+            break;
+        }
+        tileSize = (int)std::ceil(tileSize * 1.25);
+    }
+
+    // Spread the tiles evenly so every seam gets at least the configured overlap
+    int tileWidth = (std::min)(tileSize, area.width);
+    int tileHeight = (std::min)(tileSize, area.height);
+    for (int r = 0; r < rows; ++r)
+    {
+        int y = area.y + ((rows == 1) ? 0 : (int)std::lround((double)r * (area.height - tileHeight) / (rows - 1)));
+        for (int c = 0; c < cols; ++c)
+        {
+            int x = area.x + ((cols == 1) ? 0 : (int)std::lround((double)c * (area.width - tileWidth) / (cols - 1)));
+            tiles.push_back(cv::Rect(x, y, tileWidth, tileHeight));
+        }
+    }
+    return tiles;
+}
+
+std::vector<ANSCENTER::Object> CACTiler::Detect(const BatchRunner &runBatch, const cv::Mat &input,
+                                                const cv::Rect &area, Stats &stats) const
+{
+    const int EDGE_TOLERANCE = 2;
+    cv::Rect clippedArea = area & cv::Rect(0, 0, input.cols, input.rows);
+    std::vector<cv::Rect> tiles = ComputeTiles(clippedArea);
+
+    std::vector<ANSCENTER::Object> allBoxes;
+    std::vector<unsigned char> clipped;
+
+    // Each tile is a view into the frame; the detector sees it at its native resolution
+    std::vector<cv::Mat> tileViews;
+    for (const auto &tile : tiles)
+    {
+        tileViews.push_back(input(tile));
+    }
+
+    auto inferenceStart = std::chrono::steady_clock::now();
+    std::vector<std::vector<ANSCENTER::Object>> tileResults(tiles.size());
+    runBatch(tileViews, tileResults);
+
+    for (size_t t = 0; t < tiles.size(); ++t)
+    {
+        const cv::Rect &tile = tiles[t];
+        for (auto &obj : tileResults[t])
+        {
+            obj.box.x += tile.x;
+            obj.box.y += tile.y;
+            for (auto &pt : obj.polygon)
+            {
+                pt.x += tile.x;
+                pt.y += tile.y;
+            }
+
+            // A box touching a tile edge that is not the area edge was probably cut by the seam
+            bool touchesSeam =
+                (tile.x > clippedArea.x && obj.box.x - tile.x <= EDGE_TOLERANCE) ||
+                (tile.y > clippedArea.y && obj.box.y - tile.y <= EDGE_TOLERANCE) ||
+                (tile.br().x < clippedArea.br().x && tile.br().x - obj.box.br().x <= EDGE_TOLERANCE) ||
+                (tile.br().y < clippedArea.br().y && tile.br().y - obj.box.br().y <= EDGE_TOLERANCE);
+
+            allBoxes.push_back(obj);
+            clipped.push_back(touchesSeam ? 1 : 0);
+        }
+    }
+    auto mergeStart = std::chrono::steady_clock::now();
+
+    std::vector<ANSCENTER::Object> merged = MergeBoxes(allBoxes, clipped);
+    auto mergeEnd = std::chrono::steady_clock::now();
+
+    stats.tiles = (int)tiles.size();
+    stats.rawBoxes = (int)allBoxes.size();
+    stats.mergedBoxes = (int)merged.size();
+    stats.inferenceMs = std::chrono::duration<double, std::milli>(mergeStart - inferenceStart).count();
+    stats.mergeMs = std::chrono::duration<double, std::milli>(mergeEnd - mergeStart).count();
+    return merged;
+}
+
+std::vector<ANSCENTER::Object> CACTiler::MergeBoxes(const std::vector<ANSCENTER::Object> &boxes,
+                                                    const std::vector<unsigned char> &clipped) const
+{
+    const size_t count = boxes.size();
+    std::vector<ANSCENTER::Object> merged;
+    if (count == 0)
+    {
+        return merged;
+    }
+
+    // Highest score first
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&boxes](size_t a, size_t b)
+              { return boxes[a].confidence > boxes[b].confidence; });
+
+    // Structure of arrays in score order so the overlap loop runs over contiguous floats
+    std::vector<float> x1(count), y1(count), x2(count), y2(count), area(count), score(count);
+    std::vector<int> classId(count);
+    std::vector<unsigned char> seam(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &obj = boxes[order[i]];
+        x1[i] = (float)obj.box.x;
+        y1[i] = (float)obj.box.y;
+        x2[i] = (float)(obj.box.x + obj.box.width);
+        y2[i] = (float)(obj.box.y + obj.box.height);
+        area[i] = (float)obj.box.area();
+        score[i] = obj.confidence;
+        classId[i] = obj.classId;
+        seam[i] = (order[i] < clipped.size()) ? clipped[order[i]] : 0;
+    }
+
+    std::vector<unsigned char> suppressed(count, 0);
+    std::vector<float> iou(count), ios(count);
+    for (size_t a = 0; a < count; ++a)
+    {
+        if (suppressed[a])
+        {
+            continue;
+        }
+
+        // Branch-free overlap of box a against every later box; the compiler vectorises this loop
+        const float ax1 = x1[a], ay1 = y1[a], ax2 = x2[a], ay2 = y2[a], aArea = area[a];
+        for (size_t b = a + 1; b < count; ++b)
+        {
+            float w = (std::max)(0.0f, (std::min)(ax2, x2[b]) - (std::max)(ax1, x1[b]));
+            float h = (std::max)(0.0f, (std::min)(ay2, y2[b]) - (std::max)(ay1, y1[b]));
+            float inter = w * h;
+            iou[b] = inter / (aArea + area[b] - inter + 1e-6f);
+            ios[b] = inter / ((std::min)(aArea, area[b]) + 1e-6f);
+        }
+
+        float weight = score[a];
+        float fx1 = score[a] * ax1, fy1 = score[a] * ay1, fx2 = score[a] * ax2, fy2 = score[a] * ay2;
+        float ux1 = ax1, uy1 = ay1, ux2 = ax2, uy2 = ay2;
+        for (size_t b = a + 1; b < count; ++b)
+        {
+            if (suppressed[b] || classId[b] != classId[a])
+            {
+                continue;
+            }
+            if (iou[b] >= m_fMergeIoU)
+            {
+                suppressed[b] = 1;
+                weight += score[b];
+                fx1 += score[b] * x1[b];
+                fy1 += score[b] * y1[b];
+                fx2 += score[b] * x2[b];
+                fy2 += score[b] * y2[b];
+            }
+            else if ((seam[a] || seam[b]) && ios[b] >= m_fSeamIoS)
+            {
+                // Part of the same vehicle seen by the neighbouring tile
+                suppressed[b] = 1;
+                ux1 = (std::min)(ux1, x1[b]);
+                uy1 = (std::min)(uy1, y1[b]);
+                ux2 = (std::max)(ux2, x2[b]);
+                uy2 = (std::max)(uy2, y2[b]);
+            }
+        }
+
+        float bx1 = ax1, by1 = ay1, bx2 = ax2, by2 = ay2;
+        if (m_bWeightedFusion)
+        {
+            bx1 = fx1 / weight;
+            by1 = fy1 / weight;
+            bx2 = fx2 / weight;
+            by2 = fy2 / weight;
+        }
+        bx1 = (std::min)(bx1, ux1);
+        by1 = (std::min)(by1, uy1);
+        bx2 = (std::max)(bx2, ux2);
+        by2 = (std::max)(by2, uy2);
+
+        ANSCENTER::Object obj = boxes[order[a]];
+        obj.box = cv::Rect((int)std::lround(bx1), (int)std::lround(by1),
+                           (int)std::lround(bx2 - bx1), (int)std::lround(by2 - by1));
+        merged.push_back(obj);
+    }
+    return merged;
+}
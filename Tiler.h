@@ -0,0 +1,58 @@
+#ifndef TILER_H
+#define TILER_H
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "ANSLIB.h"
+
+// Splits a region into overlapping model-size tiles and merges the per-tile detections back
+// into one set of frame-coordinate boxes. The tile count is capped by a budget: when the grid
+// would need more tiles than allowed, the tiles grow (and the detector downscales them).
+class CACTiler
+{
+private:
+    int m_nTileSize;      // Tile side in pixels, normally the detector input size
+    float m_fOverlap;     // Fraction of the tile shared with its neighbour
+    int m_nMaxTiles;      // Tile budget per frame
+    float m_fMergeIoU;    // IoU above which two same-class boxes are the same object
+    float m_fSeamIoS;     // Intersection over smaller box above which a seam-clipped box is merged
+    bool m_bWeightedFusion; // false: NMS (keep best box), true: weighted box fusion
+
+public:
+    // Runs the detector on a batch of images, one result list per image
+    typedef std::function<void(const std::vector<cv::Mat> &, std::vector<std::vector<ANSCENTER::Object>> &)> BatchRunner;
+
+    struct Stats
+    {
+        int tiles{0};
+        int rawBoxes{0};
+        int mergedBoxes{0};
+        double inferenceMs{0.0};
+        double mergeMs{0.0};
+    };
+
+    CACTiler();
+
+    void Configure(int tileSize, float overlap, int maxTiles, float mergeIoU, bool weightedFusion);
+    int GetTileSize() const { return m_nTileSize; }
+    int GetMaxTiles() const { return m_nMaxTiles; }
+    float GetOverlap() const { return m_fOverlap; }
+    float GetMergeIoU() const { return m_fMergeIoU; }
+    bool IsWeightedFusion() const { return m_bWeightedFusion; }
+
+    // Tile rectangles covering the area, at most m_nMaxTiles of them
+    std::vector<cv::Rect> ComputeTiles(const cv::Rect &area) const;
+
+    // Run the detector on every tile view of the frame as one batch and merge across seams
+    std::vector<ANSCENTER::Object> Detect(const BatchRunner &runBatch, const cv::Mat &input,
+                                          const cv::Rect &area, Stats &stats) const;
+
+    // Class-aware NMS/WBF over boxes gathered from several tiles. clipped[i] marks boxes that touch
+    // an inner tile edge; those are also merged by containment so a vehicle cut by a seam is reassembled.
+    std::vector<ANSCENTER::Object> MergeBoxes(const std::vector<ANSCENTER::Object> &boxes,
+                                              const std::vector<unsigned char> &clipped) const;
+};
+
+#endif // TILER_H
@@ -0,0 +1,221 @@
+#include "TrafficAnalytics.h"
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+static const char *g_sClassNames[CACTrafficAnalytics::MAX_CLASSES] = {
+    "car", "motorbike", "bus", "truck", "bike", "container", "tricycle", "other"};
+
+CACTrafficAnalytics::CACTrafficAnalytics() : m_nSequence(0)
+{
+    m_nWindowSeconds = 60;
+    m_dLastFrameMs = -1.0;
+    std::memset(&m_stSnapshot, 0, sizeof(m_stSnapshot));
+}
+
+int CACTrafficAnalytics::ClassIndex(const std::string &className)
+{
+    for (int i = 0; i < MAX_CLASSES - 1; ++i)
+    {
+        if (className == g_sClassNames[i])
+        {
+            return i;
+        }
+    }
+    return MAX_CLASSES - 1;
+}
+
+const char *CACTrafficAnalytics::ClassName(int classIndex)
+{
+    return (classIndex >= 0 && classIndex < MAX_CLASSES) ? g_sClassNames[classIndex] : "";
+}
+
+void CACTrafficAnalytics::Configure(int windowSeconds)
+{
+    windowSeconds = (std::max)(1, (std::min)((int)MAX_BUCKETS, windowSeconds));
+    if (windowSeconds == m_nWindowSeconds)
+    {
+        return;
+    }
+    m_nWindowSeconds = windowSeconds;
+    for (auto &lane : m_vLanes)
+    {
+        lane.buckets.assign(m_nWindowSeconds, Bucket());
+    }
+}
+
+void CACTrafficAnalytics::SetLanes(const std::vector<int> &laneIds)
+{
+    // Lanes that stay keep their history
+    std::vector<LaneState> lanes;
+    for (int laneId : laneIds)
+    {
+        if ((int)lanes.size() == MAX_LANES)
+        {
+            break;
+        }
+        LaneState *existing = FindLane(laneId);
+        if (existing)
+        {
+            lanes.push_back(*existing);
+            continue;
+        }
+        LaneState lane;
+        lane.laneId = laneId;
+        lane.buckets.assign(m_nWindowSeconds, Bucket());
+        lanes.push_back(lane);
+    }
+    m_vLanes.swap(lanes);
+}
+
+CACTrafficAnalytics::LaneState *CACTrafficAnalytics::FindLane(int laneId)
+{
+    for (auto &lane : m_vLanes)
+    {
+        if (lane.laneId == laneId)
+        {
+            return &lane;
+        }
+    }
+    return nullptr;
+}
+
+CACTrafficAnalytics::Bucket &CACTrafficAnalytics::CurrentBucket(LaneState &lane, double nowMs)
+{
+    long long second = (long long)std::floor(nowMs / 1000.0);
+    Bucket &bucket = lane.buckets[(size_t)(second % (long long)lane.buckets.size())];
+    if (bucket.second != second)
+    {
+        bucket = Bucket(); // Expired: this slot held a second that fell out of the window
+        bucket.second = second;
+    }
+    return bucket;
+}
+
+void CACTrafficAnalytics::OnCrossed(int laneId, const std::string &className, double nowMs)
+{
+    LaneState *lane = FindLane(laneId);
+    if (lane)
+    {
+        CurrentBucket(*lane, nowMs).counts[ClassIndex(className)]++;
+    }
+}
+
+void CACTrafficAnalytics::OnLeft(int laneId, double dwellMs, double nowMs)
+{
+    LaneState *lane = FindLane(laneId);
+    if (lane)
+    {
+        Bucket &bucket = CurrentBucket(*lane, nowMs);
+        bucket.dwellMs += dwellMs;
+        bucket.dwellSamples++;
+    }
+}
+
+void CACTrafficAnalytics::OnLaneFrame(int laneId, int vehicles, bool red, int queueLength)
+{
+    LaneState *lane = FindLane(laneId);
+    if (!lane)
+    {
+        return;
+    }
+    lane->vehicles = vehicles;
+    if (red)
+    {
+        if (!lane->red)
+        {
+            lane->maxQueueLength = 0; // A new red phase starts
+        }
+        lane->queueLength = queueLength;
+        lane->maxQueueLength = (std::max)(lane->maxQueueLength, queueLength);
+    }
+    else
+    {
+        lane->queueLength = 0;
+    }
+    lane->red = red;
+}
+
+void CACTrafficAnalytics::OnFrame(double nowMs)
+{
+    // Gaps longer than a second (stalled stream) are not counted as observed time
+    double elapsedMs = m_dLastFrameMs < 0.0 ? 0.0 : (std::max)(0.0, (std::min)(1000.0, nowMs - m_dLastFrameMs));
+    m_dLastFrameMs = nowMs;
+
+    Snapshot snapshot;
+    std::memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.timestampMs = nowMs;
+    snapshot.windowMs = m_nWindowSeconds * 1000.0;
+    snapshot.laneCount = (int)m_vLanes.size();
+
+    long long currentSecond = (long long)std::floor(nowMs / 1000.0);
+    for (size_t i = 0; i < m_vLanes.size(); ++i)
+    {
+        LaneState &lane = m_vLanes[i];
+        Bucket &current = CurrentBucket(lane, nowMs);
+        current.elapsedMs += elapsedMs;
+        if (lane.vehicles > 0)
+        {
+            current.occupiedMs += elapsedMs;
+        }
+
+        LaneStats &stats = snapshot.lanes[i];
+        stats.laneId = lane.laneId;
+        double occupiedMs = 0.0;
+        double observedMs = 0.0;
+        double dwellMs = 0.0;
+        int dwellSamples = 0;
+        for (const auto &bucket : lane.buckets)
+        {
+            if (bucket.second < 0 || bucket.second <= currentSecond - m_nWindowSeconds)
+            {
+                continue;
+            }
+            for (int c = 0; c < MAX_CLASSES; ++c)
+            {
+                stats.counts[c] += bucket.counts[c];
+                stats.totalCount += bucket.counts[c];
+            }
+            occupiedMs += bucket.occupiedMs;
+            observedMs += bucket.elapsedMs;
+            dwellMs += bucket.dwellMs;
+            dwellSamples += bucket.dwellSamples;
+        }
+        stats.flowPerHour = observedMs > 0.0 ? stats.totalCount * 3600000.0 / observedMs : 0.0;
+        stats.occupancy = observedMs > 0.0 ? occupiedMs / observedMs : 0.0;
+        stats.meanDwellMs = dwellSamples > 0 ? dwellMs / dwellSamples : 0.0;
+        stats.vehicles = lane.vehicles;
+        stats.red = lane.red;
+        stats.queueLength = lane.queueLength;
+        stats.maxQueueLength = lane.maxQueueLength;
+    }
+
+    // Publish: odd sequence while copying, readers retry until they see the same even value twice
+    unsigned long long sequence = m_nSequence.load(std::memory_order_relaxed);
+    m_nSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&m_stSnapshot, &snapshot, sizeof(snapshot));
+    std::atomic_thread_fence(std::memory_order_release);
+    m_nSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void CACTrafficAnalytics::GetSnapshot(Snapshot &snapshot) const
+{
+    while (true)
+    {
+        unsigned long long before = m_nSequence.load(std::memory_order_acquire);
+        if (before & 1ull)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(&snapshot, &m_stSnapshot, sizeof(snapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_nSequence.load(std::memory_order_relaxed) == before)
+        {
+            snapshot.sequence = before / 2;
+            return;
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef TRAFFIC_ANALYTICS_H
+#define TRAFFIC_ANALYTICS_H
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+
+// Traffic statistics per lane, updated incrementally from tracker events on the inference thread:
+// sliding-window crossing counts per class, flow rate, DetectArea occupancy and dwell time, and the
+// queue length while the lane's signal is red. The window is kept as one-second buckets.
+// The writer publishes a fixed-size snapshot under a sequence counter (seqlock): readers copy it
+// and retry if the counter moved, so dashboards never block the inference thread.
+class CACTrafficAnalytics
+{
+public:
+    static const int MAX_LANES = 16;
+    static const int MAX_CLASSES = 8; // car, motorbike, bus, truck, bike, container, tricycle, other
+    static const int MAX_BUCKETS = 3600;
+
+    struct LaneStats
+    {
+        int laneId;
+        int counts[MAX_CLASSES]; // Stop line crossings in the window
+        int totalCount;
+        double flowPerHour;
+        double occupancy;   // Fraction of the window with a vehicle in the DetectArea
+        double meanDwellMs; // Time in the DetectArea of the vehicles that left during the window
+        int vehicles;       // In the DetectArea now
+        bool red;
+        int queueLength;    // Vehicles waiting before the stop line now (0 when not red)
+        int maxQueueLength; // Longest queue of the current red phase, or of the last one
+    };
+
+    struct Snapshot
+    {
+        unsigned long long sequence;
+        double timestampMs;
+        double windowMs;
+        int laneCount;
+        LaneStats lanes[MAX_LANES];
+    };
+
+private:
+    struct Bucket
+    {
+        long long second{-1}; // Which second of time this bucket holds, -1 when unused
+        int counts[MAX_CLASSES]{};
+        double occupiedMs{0.0};
+        double elapsedMs{0.0};
+        double dwellMs{0.0};
+        int dwellSamples{0};
+    };
+
+    struct LaneState
+    {
+        int laneId{0};
+        std::vector<Bucket> buckets;
+        int vehicles{0};
+        bool red{false};
+        int queueLength{0};
+        int maxQueueLength{0};
+    };
+
+    int m_nWindowSeconds;
+    std::vector<LaneState> m_vLanes;
+    double m_dLastFrameMs;
+
+    // Seqlock: odd while the writer is copying
+    std::atomic<unsigned long long> m_nSequence;
+    Snapshot m_stSnapshot;
+
+    LaneState *FindLane(int laneId);
+    Bucket &CurrentBucket(LaneState &lane, double nowMs);
+
+public:
+    CACTrafficAnalytics();
+
+    static int ClassIndex(const std::string &className);
+    static const char *ClassName(int classIndex);
+
+    // Writer side, inference thread only
+    void Configure(int windowSeconds);
+    void SetLanes(const std::vector<int> &laneIds);
+    void OnCrossed(int laneId, const std::string &className, double nowMs);
+    void OnLeft(int laneId, double dwellMs, double nowMs);
+    void OnLaneFrame(int laneId, int vehicles, bool red, int queueLength);
+    // Closes the frame: accounts occupancy since the previous frame and publishes the snapshot
+    void OnFrame(double nowMs);
+
+    // Reader side, any thread, never blocks the writer
+    void GetSnapshot(Snapshot &snapshot) const;
+};
+
+#endif // TRAFFIC_ANALYTICS_H
@@ -1,5 +1,6 @@
 #include "TrafficLight.h"
 #include <mutex>
+#include <chrono>
 
 // Global mutex for thread safety
 static std::recursive_mutex g_mutex;
@@ -12,6 +13,17 @@ CACTrafficLight::CACTrafficLight() {
     m_fDetectionScoreThreshold = 0.5;
     m_fConfidenceThreshold = 0.5;
     m_fNMSThreshold = 0.5;
+    m_nDetectorPoolSize = 1;
+    m_bSharedModel = true;
+    m_sPrecision = "fp32";
+    m_bOptimizeOnLoad = false;
+    m_bWarmup = false;
+    m_nWarmupSize = 640;
+    m_bMosaicBatching = false;
+    m_nMosaicWidth = 640;
+    m_nMosaicMaxHeight = 640;
+    m_nMosaicPadding = 8;
+    m_dMosaicMaxWaitMs = 5.0;
 }
 
 CACTrafficLight::~CACTrafficLight() {
@@ -23,9 +35,13 @@ bool CACTrafficLight::Initialize(const std::string& modelDir, float threshold) {
 
     m_sModelDirectory = modelDir;
     m_fDetectionScoreThreshold = threshold;
+    m_stStartupTimings = StartupTimings();
+    auto loadStart = std::chrono::steady_clock::now();
 
     // Check engine type and adjust model type if needed
     int engineType = m_cDetector.GetEngineType();
+    m_sModelHash.clear();
+    m_sBuildFingerprint = CACEngineCache::GetBuildFingerprint(engineType);
     if (engineType == 0) {
         // NVIDIA CPU - use ONNX model
         m_nModelType = 3;
@@ -33,19 +49,53 @@ bool CACTrafficLight::Initialize(const std::string& modelDir, float threshold) {
 
     // Load the traffic light detection model
     std::string licenseKey = "";
-    int result = m_cDetector.LoadModelFromFolder(
-        licenseKey.c_str(),
-        m_sModelName.c_str(),
-        m_sClassName.c_str(),
-        m_fDetectionScoreThreshold,
-        m_fConfidenceThreshold,
-        m_fNMSThreshold,
-        1, // Auto detect engine
-        m_nModelType,
-        m_nDetectionType,
-        m_sModelDirectory.c_str(),
-        m_sLabelMap
-    );
+    int result = 0;
+    if (m_bSharedModel || m_nDetectorPoolSize > 1) {
+        // Each pool handle is loaded on the worker thread that will use it
+        CACDetectorPool::Loader loader = GetModelLoader();
+
+        if (m_bSharedModel) {
+            // Cameras using the same model, precision and thresholds share one set of weights
+            m_pDetectorPool = CACModelRegistry::Instance().Acquire(GetModelKey(), m_nDetectorPoolSize, loader);
+            AttachMosaic();
+        }
+        else {
+            m_pDetectorPool = std::make_shared<CACDetectorPool>();
+            if (!m_pDetectorPool->Initialize(m_nDetectorPoolSize, loader)) {
+                m_pDetectorPool.reset();
+            }
+        }
+
+        if (m_pDetectorPool) {
+            m_sLabelMap = m_pDetectorPool->GetLabelMap();
+            result = 1;
+        }
+    }
+    else {
+        result = m_cDetector.LoadModelFromFolder(
+            licenseKey.c_str(),
+            m_sModelName.c_str(),
+            m_sClassName.c_str(),
+            m_fDetectionScoreThreshold,
+            m_fConfidenceThreshold,
+            m_fNMSThreshold,
+            1, // Auto detect engine
+            m_nModelType,
+            m_nDetectionType,
+            m_sModelDirectory.c_str(),
+            m_sLabelMap
+        );
+    }
+    m_stStartupTimings.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+    if (result == 1 && m_bOptimizeOnLoad) {
+        Optimize(m_sPrecision == "fp16");
+    }
+    if (result == 1 && m_bWarmup) {
+        auto warmupStart = std::chrono::steady_clock::now();
+        WarmUp();
+        m_stStartupTimings.warmupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmupStart).count();
+    }
 
     // Configure default parameters
     // ConfigureParameters();
@@ -53,9 +103,113 @@ bool CACTrafficLight::Initialize(const std::string& modelDir, float threshold) {
     return (result == 1);
 }
 
+CACModelRegistry::Key CACTrafficLight::GetModelKey() const {
+    CACModelRegistry::Key key;
+    key.modelDirectory = m_sModelDirectory;
+    key.modelName = m_sModelName;
+    key.className = m_sClassName;
+    key.modelType = m_nModelType;
+    key.detectionType = m_nDetectionType;
+    key.precision = m_sPrecision;
+    key.scoreThreshold = m_fDetectionScoreThreshold;
+    key.confidenceThreshold = m_fConfidenceThreshold;
+    key.nmsThreshold = m_fNMSThreshold;
+    return key;
+}
+
+CACDetectorPool::Loader CACTrafficLight::GetModelLoader() const {
+    std::string licenseKey = "";
+    std::string modelName = m_sModelName;
+    std::string className = m_sClassName;
+    std::string modelDirectory = m_sModelDirectory;
+    float scoreThreshold = m_fDetectionScoreThreshold;
+    float confidenceThreshold = m_fConfidenceThreshold;
+    float nmsThreshold = m_fNMSThreshold;
+    int modelType = m_nModelType;
+    int detectionType = m_nDetectionType;
+    return [=](ANSCENTER::ANSLIB& detector, std::string& labelMap) {
+        return detector.LoadModelFromFolder(
+            licenseKey.c_str(), modelName.c_str(), className.c_str(),
+            scoreThreshold, confidenceThreshold, nmsThreshold,
+            1, modelType, detectionType, modelDirectory.c_str(), labelMap) == 1;
+    };
+}
+
+void CACTrafficLight::AttachMosaic() {
+    // Cameras sharing the pool also share one light-detector call per tick
+    m_pMosaic.reset();
+    if (m_pDetectorPool && m_bSharedModel && m_bMosaicBatching) {
+        m_pMosaic = CACLightMosaic::Acquire(GetModelKey().ToString());
+        m_pMosaic->Configure(m_nMosaicWidth, m_nMosaicMaxHeight, m_nMosaicPadding, m_dMosaicMaxWaitMs);
+    }
+}
+
 bool CACTrafficLight::Optimize(bool fp16) {
+    auto optimiseStart = std::chrono::steady_clock::now();
+    std::string precision = fp16 ? "fp16" : "fp32";
+    if (m_bSharedModel && m_pDetectorPool && precision != m_sPrecision) {
+        // The shared pool stays at the precision of its key for the other cameras; this camera moves
+        // to the pool of the requested precision
+        m_sPrecision = precision;
+        m_pDetectorPool = CACModelRegistry::Instance().Acquire(GetModelKey(), m_nDetectorPoolSize, GetModelLoader());
+        AttachMosaic();
+        if (!m_pDetectorPool) {
+            return false;
+        }
+    }
+    if (m_sModelHash.empty()) {
+        // Once per load, the model files do not change while loaded
+        m_sModelHash = CACEngineCache::ComputeModelHash(m_sModelDirectory, m_sModelName);
+    }
+    if (CACEngineCache::IsOptimized(m_sModelDirectory, m_sModelName, m_sModelHash, precision, m_sBuildFingerprint)) {
+        // Built on an earlier run from the same model files; the auto-detecting loader already uses it
+        m_stStartupTimings.optimiseCached = true;
+        m_stStartupTimings.optimiseMs = 0.0;
+        return true;
+    }
+
+    CACEngineCache::Snapshot before = CACEngineCache::TakeSnapshot(m_sModelDirectory);
+    bool result = false;
+    if (m_pDetectorPool) {
+        result = m_pDetectorPool->Optimize(fp16);
+    }
+    else {
+        std::lock_guard<std::recursive_mutex> lock(g_mutex);
+        result = (m_cDetector.Optimize(fp16) == 1);
+    }
+    if (result) {
+        CACEngineCache::MarkOptimized(m_sModelDirectory, m_sModelName, m_sModelHash, precision, m_sBuildFingerprint, before);
+    }
+    m_stStartupTimings.optimiseCached = false;
+    m_stStartupTimings.optimiseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimiseStart).count();
+    return result;
+}
+
+void CACTrafficLight::WarmUp() {
+    // Mid-grey frame at the model input size
+    cv::Mat frame(m_nWarmupSize, m_nWarmupSize, CV_8UC3, cv::Scalar(114, 114, 114));
+    if (m_pDetectorPool) {
+        m_pDetectorPool->WarmUp(frame);
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    std::vector<ANSCENTER::Object> results;
+    m_cDetector.RunInference(frame, "warmup", results);
+}
+
+int CACTrafficLight::RunDetector(const cv::Mat& image, const std::string& cameraId, std::vector<ANSCENTER::Object>& results) {
+    if (m_pDetectorPool) {
+        return m_pDetectorPool->RunInference(image, cameraId, results);
+    }
     std::lock_guard<std::recursive_mutex> lock(g_mutex);
-    return (m_cDetector.Optimize(fp16) == 1);
+    return m_cDetector.RunInference(image, cameraId.c_str(), results);
+}
+
+std::vector<CACDetectorPool::WorkerStats> CACTrafficLight::GetDetectorPoolStats() const {
+    if (m_pDetectorPool) {
+        return m_pDetectorPool->GetStats();
+    }
+    return std::vector<CACDetectorPool::WorkerStats>();
 }
 /*
 ***********************************************************************************
@@ -102,7 +256,52 @@ bool CACTrafficLight::SetParameters(const CustomParams& params)
     m_stParameters = params;
 
     if (params.handleId == 1) {
-        // Update ROIs if available
+        for (const auto& param : params.handleParametersJson) {
+            try {
+                if (param.name == "detectorPoolSize") {
+                    m_nDetectorPoolSize = (std::max)(1, std::stoi(param.value));
+                }
+                else if (param.name == "sharedModel") {
+                    m_bSharedModel = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "precision") {
+                    m_sPrecision = param.value;
+                }
+                else if (param.name == "optimizeOnLoad") {
+                    m_bOptimizeOnLoad = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "warmup") {
+                    m_bWarmup = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "warmupSize") {
+                    m_nWarmupSize = (std::max)(32, std::stoi(param.value));
+                }
+                else if (param.name == "mosaicBatching") {
+                    m_bMosaicBatching = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "mosaicWidth") {
+                    m_nMosaicWidth = std::stoi(param.value);
+                }
+                else if (param.name == "mosaicMaxHeight") {
+                    m_nMosaicMaxHeight = std::stoi(param.value);
+                }
+                else if (param.name == "mosaicPadding") {
+                    m_nMosaicPadding = std::stoi(param.value);
+                }
+                else if (param.name == "mosaicMaxWaitMs") {
+                    m_dMosaicMaxWaitMs = std::stod(param.value);
+                }
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+            }
+        }
+        if (m_pMosaic) {
+            m_pMosaic->Configure(m_nMosaicWidth, m_nMosaicMaxHeight, m_nMosaicPadding, m_dMosaicMaxWaitMs);
+        }
+
+        // Update ROIs if available; they replace the previous ones, SetParameters runs again on reconfiguration
+        m_vTrafficROIs.clear();
         for (const auto& roi : params.ROIs) {
             if (roi.regionName == "TrafficRoi") {
                 m_vTrafficROIs.push_back(roi);
@@ -117,13 +316,39 @@ CustomParams CACTrafficLight::GetParameters()
 	return m_stParameters;
 }
 
+void CACTrafficLight::BeginLightTick() {
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    EndLightTick();
+    if (m_pMosaic) {
+        m_pTickMosaic = m_pMosaic;
+        m_pTickMosaic->BeginTick();
+    }
+}
+
+void CACTrafficLight::EndLightTick() {
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    if (m_pTickMosaic) {
+        m_pTickMosaic->EndTick();
+        m_pTickMosaic.reset();
+    }
+}
+
 std::vector<ANSCENTER::Object> CACTrafficLight::DetectTrafficLights(const cv::Mat& input, const std::string& cameraId) {
-    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
 
     std::vector<ANSCENTER::Object> detectedLights;
     try {
-        // Run inference on the input image
-        m_cDetector.RunInference(input, cameraId.c_str(), detectedLights);
+        // Run inference on the input image, packed with the other cameras' crops when batching.
+        // An atlas holds several cameras, so it runs under an id of its own that no camera tracks.
+        if (m_pMosaic) {
+            auto runner = [this](const cv::Mat& image, std::vector<ANSCENTER::Object>& results) {
+                return RunDetector(image, "__light_mosaic__", results);
+            };
+            m_pMosaic->Detect(input, runner, detectedLights);
+        }
+        else {
+            RunDetector(input, cameraId, detectedLights);
+        }
 
         // Filter results to include only objects within the traffic ROI
         if (!m_vTrafficROIs.empty()) {
@@ -137,6 +362,7 @@ std::vector<ANSCENTER::Object> CACTrafficLight::DetectTrafficLights(const cv::Ma
                         // Convert polygon to rectangle for simple containment check
                         cv::Rect roiRect = cv::boundingRect(roi.polygon);
                         filteredResults.push_back(obj);
+                        break; // Once, however many ROIs hold it
                     }
                 }
             }
@@ -184,7 +410,62 @@ bool CACTrafficLight::IsYellow(const std::vector<ANSCENTER::Object>& detectedLig
     return false;
 }
 
+TrafficLightState CACTrafficLight::GetLightState(const std::vector<ANSCENTER::Object>& detectedLights, float minConfidence) {
+    // Red wins over yellow over green so a partially occluded head never hides a red phase
+    TrafficLightState state = LIGHT_UNKNOWN;
+    for (const auto& light : detectedLights) {
+        if (light.confidence <= minConfidence) {
+            continue;
+        }
+        std::vector<ANSCENTER::Object> single = { light };
+        if (IsRed(single)) {
+            return LIGHT_RED;
+        }
+        if (IsYellow(single)) {
+            state = LIGHT_YELLOW;
+        }
+        else if (IsGreen(single) && state == LIGHT_UNKNOWN) {
+            state = LIGHT_GREEN;
+        }
+    }
+    return state;
+}
+
+std::vector<ANSCENTER::Object> CACTrafficLight::MakePredictedLights(const std::vector<ANSCENTER::Object>& lastLights,
+                                                                    TrafficLightState state, float confidence) {
+    std::vector<ANSCENTER::Object> predictedLights;
+    if (state == LIGHT_UNKNOWN) {
+        return predictedLights;
+    }
+
+    // Class ids follow the combined label map: green 8, red 9, yellow 10
+    for (const auto& light : lastLights) {
+        ANSCENTER::Object predicted = light;
+        switch (state) {
+        case LIGHT_GREEN:
+            predicted.className = "green";
+            predicted.classId = 8;
+            break;
+        case LIGHT_RED:
+            predicted.className = "red";
+            predicted.classId = 9;
+            break;
+        default:
+            predicted.className = "yellow";
+            predicted.classId = 10;
+            break;
+        }
+        predicted.confidence = confidence;
+        predicted.extraInfo = "predicted";
+        predictedLights.push_back(predicted);
+    }
+    return predictedLights;
+}
+
 bool CACTrafficLight::Destroy() {
     // Release resources
+    EndLightTick();
+    m_pMosaic.reset();
+    m_pDetectorPool.reset();
     return true;
 }
\ No newline at end of file
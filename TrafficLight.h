@@ -3,9 +3,24 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include "ANSLIB.h"
 #include "ANSCustomData.h"
+#include "DetectorPool.h"
+#include "ModelRegistry.h"
+#include "EngineCache.h"
+#include "LightMosaic.h"
+
+// Light state derived from the detections inside TrafficRoi
+enum TrafficLightState
+{
+    LIGHT_UNKNOWN = 0,
+    LIGHT_GREEN = 1,
+    LIGHT_YELLOW = 2,
+    LIGHT_RED = 3
+};
 
 // TungBT: Modify member variable's name, local variable's name
 // Class XYYZZ (Example class CACVehicle with X: Class, YY: Project, ZZ: Class name)
@@ -24,12 +39,44 @@ private:
     float m_fNMSThreshold;
     std::string m_sLabelMap;
 
+    // Pool of detector handles, shared through CACModelRegistry unless m_bSharedModel is off.
+    // Without a pool m_cDetector is used under the global lock.
+    int m_nDetectorPoolSize;
+    bool m_bSharedModel;
+    std::string m_sPrecision; // Part of the registry key: "fp32" or "fp16"
+    std::shared_ptr<CACDetectorPool> m_pDetectorPool;
+    std::recursive_mutex m_cMutex;
+
+    // Startup: optimise right after loading (skipped when the engine cache has it) and warm up
+    bool m_bOptimizeOnLoad;
+    bool m_bWarmup;
+    int m_nWarmupSize;
+    std::string m_sModelHash;        // Computed on the first Optimize after a load
+    std::string m_sBuildFingerprint; // Engine type, GPU and driver
+    StartupTimings m_stStartupTimings;
+
+    // Pack the TrafficRoi crops of all cameras sharing the model into one atlas per tick
+    bool m_bMosaicBatching;
+    int m_nMosaicWidth;
+    int m_nMosaicMaxHeight;
+    int m_nMosaicPadding;
+    double m_dMosaicMaxWaitMs;
+    std::shared_ptr<CACLightMosaic> m_pMosaic;
+    std::shared_ptr<CACLightMosaic> m_pTickMosaic; // The mosaic BeginLightTick counted this camera in
+
     // Traffic light ROI
     std::vector<CustomRegion> m_vTrafficROIs;
 
     // Parameters
     CustomParams m_stParameters;
 
+    int RunDetector(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results);
+    void WarmUp();
+    CACModelRegistry::Key GetModelKey() const;
+    CACDetectorPool::Loader GetModelLoader() const;
+    // Joins the mosaic of the cameras sharing the current pool, when mosaic batching is on
+    void AttachMosaic();
+
 public:
     CACTrafficLight();
     ~CACTrafficLight();
@@ -40,11 +87,21 @@ public:
     bool SetParameters(const CustomParams &params);
     CustomParams GetParameters();
 
+    // Bracket the light stage of one frame, whether or not any head runs the detector
+    void BeginLightTick();
+    void EndLightTick();
     std::vector<ANSCENTER::Object> DetectTrafficLights(const cv::Mat &input, const std::string &cameraId);
+    std::vector<CACDetectorPool::WorkerStats> GetDetectorPoolStats() const;
+    CACLightMosaic::Stats GetMosaicStats() const { return m_pMosaic ? m_pMosaic->GetStats() : CACLightMosaic::Stats(); }
+    StartupTimings GetStartupTimings() const { return m_stStartupTimings; }
 
     bool IsGreen(const std::vector<ANSCENTER::Object> &detectedLights);
     bool IsRed(const std::vector<ANSCENTER::Object> &detectedLights);
     bool IsYellow(const std::vector<ANSCENTER::Object> &detectedLights);
+    TrafficLightState GetLightState(const std::vector<ANSCENTER::Object> &detectedLights, float minConfidence = 0.5f);
+    // Copy of the last light boxes labelled with a predicted state (extraInfo = "predicted")
+    std::vector<ANSCENTER::Object> MakePredictedLights(const std::vector<ANSCENTER::Object> &lastLights,
+                                                       TrafficLightState state, float confidence);
 
     bool Destroy();
 };
@@ -1,6 +1,7 @@
 #include "Vehicle.h"
 #include <mutex>
 #include <chrono>
+#include <filesystem>
 #include "ANSCustomTrafficLight.h"
 
 // Global mutex for thread safety
@@ -15,6 +16,22 @@ CACVehicle::CACVehicle()
     m_fDetectionScoreThreshold = 0.4;
     m_fConfidenceThreshold = 0.5;
     m_fNMSThreshold = 0.5;
+    m_bCropToDetectArea = false;
+    m_nCropMargin = 32;
+    m_bTiling = false;
+    m_bPyramidInput = false;
+    m_nTunedRegionSide = 0;
+    m_nDetectorSide = -1;
+    m_nLaneGridCell = 64;
+    m_nQueueSpeedPx = 3;
+    m_nCrossedCount = 0;
+    m_nTrackingFrame = 0;
+    m_nDetectorPoolSize = 1;
+    m_bSharedModel = true;
+    m_sPrecision = "fp32";
+    m_bOptimizeOnLoad = false;
+    m_bWarmup = false;
+    m_nWarmupSize = 640;
 }
 
 CACVehicle::~CACVehicle()
@@ -28,9 +45,18 @@ bool CACVehicle::Initialize(const std::string &modelDir, float threshold)
 
     m_sModelDirectory = modelDir;
     m_fDetectionScoreThreshold = threshold;
+    m_stStartupTimings = StartupTimings();
+#ifndef NDEBUG
+    // The DetectArea filter relies on the SIMD region kernel matching the scalar and OpenCV tests
+    static const bool regionKernelChecked = CACRegionKernel::SelfCheck();
+    (void)regionKernelChecked;
+#endif
+    auto loadStart = std::chrono::steady_clock::now();
 
     // Check engine type and adjust model type if needed
     int engineType = m_cDetector.GetEngineType();
+    m_sModelHash.clear();
+    m_sBuildFingerprint = CACEngineCache::GetBuildFingerprint(engineType);
     if (engineType == 0)
     {
         // NVIDIA CPU - use ONNX model
@@ -39,18 +65,64 @@ bool CACVehicle::Initialize(const std::string &modelDir, float threshold)
 
     // Load the CACVehicle detection model
     std::string licenseKey = "";
-    int result = m_cDetector.LoadModelFromFolder(
-        licenseKey.c_str(),
-        m_sModelName.c_str(),
-        m_sClassName.c_str(),
-        m_fDetectionScoreThreshold,
-        m_fConfidenceThreshold,
-        m_fNMSThreshold,
-        1, // Auto detect engine
-        m_nModelType,
-        m_nDetectionType,
-        m_sModelDirectory.c_str(),
-        m_sLabelMap);
+    int result = 0;
+    if (m_bSharedModel || m_nDetectorPoolSize > 1)
+    {
+        // Each pool handle is loaded on the worker thread that will use it
+        CACDetectorPool::Loader loader = GetModelLoader(m_sModelName);
+
+        if (m_bSharedModel)
+        {
+            // Cameras using the same model, precision and thresholds share one set of weights
+            m_pDetectorPool = CACModelRegistry::Instance().Acquire(GetModelKey(m_sModelName), m_nDetectorPoolSize, loader);
+        }
+        else
+        {
+            m_pDetectorPool = std::make_shared<CACDetectorPool>();
+            if (!m_pDetectorPool->Initialize(m_nDetectorPoolSize, loader))
+            {
+                m_pDetectorPool.reset();
+            }
+        }
+
+        if (m_pDetectorPool)
+        {
+            m_sLabelMap = m_pDetectorPool->GetLabelMap();
+            result = 1;
+        }
+    }
+    else
+    {
+        result = m_cDetector.LoadModelFromFolder(
+            licenseKey.c_str(),
+            m_sModelName.c_str(),
+            m_sClassName.c_str(),
+            m_fDetectionScoreThreshold,
+            m_fConfidenceThreshold,
+            m_fNMSThreshold,
+            1, // Auto detect engine
+            m_nModelType,
+            m_nDetectionType,
+            m_sModelDirectory.c_str(),
+            m_sLabelMap);
+    }
+    m_stStartupTimings.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+    if (result == 1 && m_bOptimizeOnLoad)
+    {
+        Optimize(m_sPrecision == "fp16");
+    }
+    if (result == 1 && m_bWarmup)
+    {
+        auto warmupStart = std::chrono::steady_clock::now();
+        WarmUp();
+        m_stStartupTimings.warmupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmupStart).count();
+    }
+
+    if (result == 1)
+    {
+        LoadRungModels();
+    }
 
     // Configure default parameters
     ConfigureParameters();
@@ -58,10 +130,273 @@ bool CACVehicle::Initialize(const std::string &modelDir, float threshold)
     return (result == 1);
 }
 
+CACModelRegistry::Key CACVehicle::GetModelKey(const std::string &modelName) const
+{
+    CACModelRegistry::Key key;
+    key.modelDirectory = m_sModelDirectory;
+    key.modelName = modelName;
+    key.className = m_sClassName;
+    key.modelType = m_nModelType;
+    key.detectionType = m_nDetectionType;
+    key.precision = m_sPrecision;
+    key.scoreThreshold = m_fDetectionScoreThreshold;
+    key.confidenceThreshold = m_fConfidenceThreshold;
+    key.nmsThreshold = m_fNMSThreshold;
+    return key;
+}
+
+CACDetectorPool::Loader CACVehicle::GetModelLoader(const std::string &modelName) const
+{
+    std::string licenseKey = "";
+    std::string className = m_sClassName;
+    std::string modelDirectory = m_sModelDirectory;
+    float scoreThreshold = m_fDetectionScoreThreshold;
+    float confidenceThreshold = m_fConfidenceThreshold;
+    float nmsThreshold = m_fNMSThreshold;
+    int modelType = m_nModelType;
+    int detectionType = m_nDetectionType;
+    return [=](ANSCENTER::ANSLIB &detector, std::string &labelMap)
+    {
+        return detector.LoadModelFromFolder(
+                   licenseKey.c_str(), modelName.c_str(), className.c_str(),
+                   scoreThreshold, confidenceThreshold, nmsThreshold,
+                   1, modelType, detectionType, modelDirectory.c_str(), labelMap) == 1;
+    };
+}
+
 bool CACVehicle::Optimize(bool fp16)
 {
+    auto optimiseStart = std::chrono::steady_clock::now();
+    std::string precision = fp16 ? "fp16" : "fp32";
+    if (m_bSharedModel && m_pDetectorPool && precision != m_sPrecision)
+    {
+        // The shared pool stays at the precision of its key for the other cameras; this camera moves
+        // to the pool of the requested precision
+        m_sPrecision = precision;
+        m_pDetectorPool = CACModelRegistry::Instance().Acquire(GetModelKey(m_sModelName), m_nDetectorPoolSize, GetModelLoader(m_sModelName));
+        if (!m_pDetectorPool)
+        {
+            return false;
+        }
+    }
+    if (m_sModelHash.empty())
+    {
+        // Once per load, the model files do not change while loaded
+        m_sModelHash = CACEngineCache::ComputeModelHash(m_sModelDirectory, m_sModelName);
+    }
+    if (CACEngineCache::IsOptimized(m_sModelDirectory, m_sModelName, m_sModelHash, precision, m_sBuildFingerprint))
+    {
+        // Built on an earlier run from the same model files; the auto-detecting loader already uses it
+        m_stStartupTimings.optimiseCached = true;
+        m_stStartupTimings.optimiseMs = 0.0;
+        return true;
+    }
+
+    CACEngineCache::Snapshot before = CACEngineCache::TakeSnapshot(m_sModelDirectory);
+    bool result = false;
+    if (m_pDetectorPool)
+    {
+        result = m_pDetectorPool->Optimize(fp16);
+    }
+    else
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_mutex);
+        result = (m_cDetector.Optimize(fp16) == 1);
+    }
+    if (result)
+    {
+        CACEngineCache::MarkOptimized(m_sModelDirectory, m_sModelName, m_sModelHash, precision, m_sBuildFingerprint, before);
+    }
+    m_stStartupTimings.optimiseCached = false;
+    m_stStartupTimings.optimiseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimiseStart).count();
+    return result;
+}
+
+void CACVehicle::WarmUp()
+{
+    // Mid-grey frame at the model input size
+    cv::Mat frame(m_nWarmupSize, m_nWarmupSize, CV_8UC3, cv::Scalar(114, 114, 114));
+    if (m_pDetectorPool)
+    {
+        m_pDetectorPool->WarmUp(frame);
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    std::vector<ANSCENTER::Object> results;
+    m_cDetector.RunInference(frame, "warmup", results);
+}
+
+int CACVehicle::RunDetector(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results)
+{
+    if (m_pDetectorPool)
+    {
+        return m_pDetectorPool->RunInference(image, cameraId, results);
+    }
     std::lock_guard<std::recursive_mutex> lock(g_mutex);
-    return (m_cDetector.Optimize(fp16) == 1);
+    return m_cDetector.RunInference(image, cameraId.c_str(), results);
+}
+
+int CACVehicle::RunDetectorOnRegion(const cv::Mat &input, const cv::Rect &region, const std::string &cameraId,
+                                    CACFramePyramid *pyramid, std::vector<ANSCENTER::Object> &results)
+{
+    // The model resizes to its input size anyway; a pyramid level at or above that size saves the
+    // detector from resampling the full-resolution region. With resolution tuning the target is
+    // the side the tuner chose for this camera.
+    int regionSide = (std::max)(region.width, region.height);
+    int targetSide = m_cTiler.GetTileSize();
+    std::shared_ptr<CACDetectorPool> pRungPool;
+    auto rung = m_mRungPools.find(m_cResolutionTuner.GetInputSide());
+    if (rung != m_mRungPools.end())
+    {
+        // The engine of the tuned rung takes exactly that side, scaling down to it loses nothing more
+        pRungPool = rung->second;
+        targetSide = rung->first;
+    }
+    int detectorSide = pRungPool ? targetSide : 0;
+    if (detectorSide != m_nDetectorSide)
+    {
+        // Every rung's handles track the camera on their own and number from scratch; the camera's
+        // tracks are carried over by overlap, so a rung change keeps the track ids
+        m_cBoxTracker.NewSource();
+        m_nDetectorSide = detectorSide;
+    }
+    m_nTunedRegionSide = regionSide;
+    int level = 0;
+    if (m_bPyramidInput && pyramid && !pyramid->Empty())
+    {
+        level = pyramid->ChooseLevel(regionSide, targetSide);
+    }
+
+    // cv::Mat ROI is a view over the frame (or pyramid level) buffer, no pixels are copied
+    cv::Rect levelRegion = (level > 0) ? pyramid->ScaleRect(region, level) : region;
+    cv::Mat view = (level > 0) ? pyramid->GetLevel(level)(levelRegion) : input(region);
+
+    // The tuned side is met exactly, the pyramid level only comes close to it
+    double resize = 1.0;
+    int viewSide = (std::max)(view.cols, view.rows);
+    if (pRungPool && viewSide > targetSide)
+    {
+        resize = (double)targetSide / viewSide;
+        cv::resize(view, m_cTunedInput, cv::Size(), resize, resize, cv::INTER_AREA);
+        view = m_cTunedInput;
+    }
+    int result = pRungPool ? pRungPool->RunInference(view, cameraId, results) : RunDetector(view, cameraId, results);
+
+    // Map boxes back to frame coordinates
+    double factor = (1 << level) / resize;
+    int offsetX = levelRegion.x * (1 << level);
+    int offsetY = levelRegion.y * (1 << level);
+    for (auto &obj : results)
+    {
+        obj.box = cv::Rect(cvRound(obj.box.x * factor) + offsetX, cvRound(obj.box.y * factor) + offsetY,
+                           cvRound(obj.box.width * factor), cvRound(obj.box.height * factor));
+        for (auto &pt : obj.polygon)
+        {
+            pt.x = cvRound(pt.x * factor) + offsetX;
+            pt.y = cvRound(pt.y * factor) + offsetY;
+        }
+    }
+    return result;
+}
+
+void CACVehicle::LoadRungModels()
+{
+    // Rungs below the top need an engine built for their input side; the top rung is the main model
+    m_mRungPools.clear();
+    std::vector<int> vSides;
+    const std::vector<int> &vLadder = m_cResolutionTuner.GetConfiguredLadder();
+    for (size_t i = 0; m_cResolutionTuner.IsEnabled() && !m_sModelDirectory.empty() && i + 1 < vLadder.size(); ++i)
+    {
+        std::string rungModel = m_sModelName + "_" + std::to_string(vLadder[i]);
+        bool bFound = false;
+        std::error_code error;
+        for (std::filesystem::directory_iterator it(m_sModelDirectory, error), end; !error && it != end && !bFound; it.increment(error))
+        {
+            bFound = it->path().stem().string() == rungModel;
+        }
+        if (!bFound)
+        {
+            continue;
+        }
+
+        std::shared_ptr<CACDetectorPool> pool;
+        if (m_bSharedModel)
+        {
+            pool = CACModelRegistry::Instance().Acquire(GetModelKey(rungModel), m_nDetectorPoolSize, GetModelLoader(rungModel));
+        }
+        else
+        {
+            pool = std::make_shared<CACDetectorPool>();
+            if (!pool->Initialize(m_nDetectorPoolSize, GetModelLoader(rungModel)))
+            {
+                pool.reset();
+            }
+        }
+        if (pool)
+        {
+            m_mRungPools[vLadder[i]] = pool;
+            vSides.push_back(vLadder[i]);
+        }
+    }
+    m_cResolutionTuner.SetUsableSides(vSides);
+    if (m_cResolutionTuner.IsEnabled())
+    {
+        std::cout << "Resolution tuner: " << vSides.size() << " of " << vLadder.size() - 1 << " lower rungs have an engine" << std::endl;
+    }
+}
+
+void CACVehicle::RunDetectorBatch(const std::vector<cv::Mat> &images, const std::string &cameraId,
+                                  std::vector<std::vector<ANSCENTER::Object>> &results)
+{
+    results.resize(images.size());
+    if (!m_pDetectorPool)
+    {
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            RunDetector(images[i], cameraId + "#tile" + std::to_string(i), results[i]);
+        }
+        return;
+    }
+
+    // Every tile is tracked under its own id, away from the camera's tracks; the merged boxes get
+    // their ids from the box tracker. Nothing here relies on a handle's tracks, so the items are
+    // spread over the pool and idle workers steal them.
+    std::vector<std::future<void>> done;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const cv::Mat *image = &images[i];
+        std::vector<ANSCENTER::Object> *result = &results[i];
+        std::string tileId = cameraId + "#tile" + std::to_string(i);
+        done.push_back(m_pDetectorPool->Submit(tileId, [image, result, tileId](ANSCENTER::ANSLIB &detector)
+                                               { detector.RunInference(*image, tileId.c_str(), *result); }));
+    }
+    for (auto &future : done)
+    {
+        future.get();
+    }
+}
+
+int CACVehicle::DetectMovement(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results)
+{
+    if (m_pDetectorPool)
+    {
+        // The handle keeps the camera's background model, so the job stays on the camera's worker
+        std::future<void> done = m_pDetectorPool->SubmitPinned(m_pDetectorPool->GetWorkerIndex(cameraId), [&](ANSCENTER::ANSLIB &detector)
+                                                               { detector.DetectMovement(image, cameraId.c_str(), results); });
+        done.get();
+        return 1;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    return m_cDetector.DetectMovement(image, cameraId.c_str(), results);
+}
+
+std::vector<CACDetectorPool::WorkerStats> CACVehicle::GetDetectorPoolStats() const
+{
+    if (m_pDetectorPool)
+    {
+        return m_pDetectorPool->GetStats();
+    }
+    return std::vector<CACDetectorPool::WorkerStats>();
 }
 
 /*
@@ -143,25 +478,181 @@ bool CACVehicle::SetParameters(const CustomParams &params)
 
     if (params.handleId == 0)
     {
+        int tileSize = m_cTiler.GetTileSize();
+        float tileOverlap = m_cTiler.GetOverlap();
+        int maxTiles = m_cTiler.GetMaxTiles();
+        float tileMergeIoU = m_cTiler.GetMergeIoU();
+        bool tileFusion = m_cTiler.IsWeightedFusion();
+        int motionMode = m_cMotionGate.GetMode();
+        int motionWidth = m_cMotionGate.GetDownscaleWidth();
+        int motionPixelThreshold = m_cMotionGate.GetPixelThreshold();
+        float motionMinRatio = m_cMotionGate.GetMinChangedRatio();
+        int motionMaxSkip = m_cMotionGate.GetMaxSkippedFrames();
+        bool flowPropagation = m_cFlowPropagator.IsEnabled();
+        int flowMaxInterval = m_cFlowPropagator.GetMaxInterval();
+        int flowPointsPerBox = m_cFlowPropagator.GetPointsPerBox();
+        float flowMinQuality = m_cFlowPropagator.GetMinQuality();
+
+        for (const auto &param : params.handleParametersJson)
+        {
+            try
+            {
+                if (param.name == "detectorPoolSize")
+                {
+                    m_nDetectorPoolSize = (std::max)(1, std::stoi(param.value));
+                }
+                else if (param.name == "sharedModel")
+                {
+                    m_bSharedModel = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "precision")
+                {
+                    m_sPrecision = param.value;
+                }
+                else if (param.name == "optimizeOnLoad")
+                {
+                    m_bOptimizeOnLoad = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "warmup")
+                {
+                    m_bWarmup = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "warmupSize")
+                {
+                    m_nWarmupSize = (std::max)(32, std::stoi(param.value));
+                }
+                else if (param.name == "cropToDetectArea")
+                {
+                    m_bCropToDetectArea = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "cropMargin")
+                {
+                    m_nCropMargin = (std::max)(0, std::stoi(param.value));
+                }
+                else if (param.name == "laneGridCell")
+                {
+                    m_nLaneGridCell = (std::max)(8, std::stoi(param.value));
+                }
+                else if (param.name == "analyticsWindowSec")
+                {
+                    m_cAnalytics.Configure(std::stoi(param.value));
+                }
+                else if (param.name == "queueSpeedPx")
+                {
+                    m_nQueueSpeedPx = (std::max)(0, std::stoi(param.value));
+                }
+                else if (param.name == "pyramidInput")
+                {
+                    m_bPyramidInput = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "tiling")
+                {
+                    m_bTiling = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "tileSize")
+                {
+                    tileSize = std::stoi(param.value);
+                }
+                else if (param.name == "tileOverlap")
+                {
+                    tileOverlap = std::stof(param.value);
+                }
+                else if (param.name == "maxTiles")
+                {
+                    maxTiles = std::stoi(param.value);
+                }
+                else if (param.name == "tileMergeIoU")
+                {
+                    tileMergeIoU = std::stof(param.value);
+                }
+                else if (param.name == "tileFusion")
+                {
+                    tileFusion = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "motionGate")
+                {
+                    motionMode = std::stoi(param.value);
+                }
+                else if (param.name == "motionDownscaleWidth")
+                {
+                    motionWidth = std::stoi(param.value);
+                }
+                else if (param.name == "motionPixelThreshold")
+                {
+                    motionPixelThreshold = std::stoi(param.value);
+                }
+                else if (param.name == "motionMinRatio")
+                {
+                    motionMinRatio = std::stof(param.value);
+                }
+                else if (param.name == "motionMaxSkip")
+                {
+                    motionMaxSkip = std::stoi(param.value);
+                }
+                else if (param.name == "flowPropagation")
+                {
+                    flowPropagation = (std::stoi(param.value) != 0);
+                }
+                else if (param.name == "flowMaxInterval")
+                {
+                    flowMaxInterval = std::stoi(param.value);
+                }
+                else if (param.name == "flowPointsPerBox")
+                {
+                    flowPointsPerBox = std::stoi(param.value);
+                }
+                else if (param.name == "flowMinQuality")
+                {
+                    flowMinQuality = std::stof(param.value);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Invalid value for parameter " << param.name << ": " << param.value << std::endl;
+            }
+        }
+        m_cTiler.Configure(tileSize, tileOverlap, maxTiles, tileMergeIoU, tileFusion);
+        m_cMotionGate.Configure(motionMode, motionWidth, motionPixelThreshold, motionMinRatio, motionMaxSkip);
+        m_cFlowPropagator.Configure(flowPropagation, flowMaxInterval, flowPointsPerBox, flowMinQuality);
+        bool tuningEnabled = m_cResolutionTuner.IsEnabled();
+        std::vector<int> vLadder = m_cResolutionTuner.GetConfiguredLadder();
+        m_cResolutionTuner.SetParameters(params);
+        if (!m_sModelDirectory.empty() && (tuningEnabled != m_cResolutionTuner.IsEnabled() || vLadder != m_cResolutionTuner.GetConfiguredLadder()))
+        {
+            // Loaded already, the rungs changed
+            LoadRungModels();
+        }
+
         m_vDetectAreaROI.clear();
         m_vCrossingLineROI.clear();
         m_vDirectionLineROI.clear();
 
+        // Lane N uses the "_N" suffixed names, lane 0 the plain ones
         for (const auto &roi : params.ROIs)
         {
-            if (roi.regionName == "DetectArea")
+            std::string baseName;
+            int laneId = 0;
+            CACLaneIndex::ParseRegionName(roi.regionName, baseName, laneId);
+            if (baseName == "DetectArea")
             {
                 m_vDetectAreaROI.push_back(roi);
             }
-            else if (roi.regionName == "CrossingLine")
+            else if (baseName == "CrossingLine")
             {
                 m_vCrossingLineROI.push_back(roi);
             }
-            else if (roi.regionName == "Direction")
+            else if (baseName == "Direction")
             {
                 m_vDirectionLineROI.push_back(roi);
             }
         }
+        m_cLaneIndex.Build(CACLaneIndex::BuildLanes(params.ROIs), m_nLaneGridCell);
+        std::vector<int> laneIds;
+        for (const auto &lane : m_cLaneIndex.GetLanes())
+        {
+            laneIds.push_back(lane.laneId);
+        }
+        m_cAnalytics.SetLanes(laneIds);
     }
     return true;
 }
@@ -171,50 +662,98 @@ CustomParams CACVehicle::GetParameters()
     return m_stParameters;
 }
 
-std::vector<ANSCENTER::Object> CACVehicle::DetectVehicles(const cv::Mat &input, const std::string &cameraId)
+std::vector<ANSCENTER::Object> CACVehicle::DetectVehicles(const cv::Mat &input, const std::string &cameraId, CACFramePyramid *pyramid)
 {
-    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
 
     std::vector<ANSCENTER::Object> detectedVehicles;
     try
     {
-        // Run inference on the input image
-        m_cDetector.RunInference(input, cameraId.c_str(), detectedVehicles);
+        // Nothing moved inside the DetectArea: the previous detections still describe the scene.
+        // The tracker sees the frame as unobserved, so tracks keep their age from the last real observation.
+        std::vector<cv::Point> detectPolygon = m_vDetectAreaROI.empty() ? std::vector<cv::Point>() : m_vDetectAreaROI[0].polygon;
+        auto detectMovement = [this, &cameraId](const cv::Mat &image, std::vector<ANSCENTER::Object> &movements)
+        { return DetectMovement(image, cameraId, movements); };
+        if (!m_cMotionGate.ShouldDetect(input, GetDetectAreaBounds(input.size()), detectPolygon, detectMovement, pyramid))
+        {
+            UpdateVehicleTracking(m_vLastVehicles, false);
+            return m_vLastVehicles;
+        }
+
+        // Between keyframes the last boxes are moved with optical flow instead of running the model
+        cv::Rect flowArea = GetDetectAreaBounds(input.size());
+        std::vector<ANSCENTER::Object> propagatedVehicles;
+        if (m_cFlowPropagator.Propagate(input, flowArea, propagatedVehicles))
+        {
+            UpdateVehicleTracking(propagatedVehicles, true, false);
+            m_vLastVehicles = propagatedVehicles;
+            return propagatedVehicles;
+        }
+
+        // Run inference on tiles or on the DetectArea crop when enabled, otherwise on the whole frame
+        cv::Rect cropRect = GetDetectAreaCropRect(input.size());
+        if (m_bTiling)
+        {
+            auto runBatch = [this, &cameraId](const std::vector<cv::Mat> &images, std::vector<std::vector<ANSCENTER::Object>> &batchResults)
+            { RunDetectorBatch(images, cameraId, batchResults); };
+            // Tile count, time and merged boxes are read through GetTilingStats
+            detectedVehicles = m_cTiler.Detect(runBatch, input, GetDetectAreaBounds(input.size()), m_stTilingStats);
+        }
+        else if (cropRect.area() > 0 && cropRect.area() < input.size().area())
+        {
+            RunDetectorOnRegion(input, cropRect, cameraId, pyramid, detectedVehicles);
+        }
+        else
+        {
+            RunDetectorOnRegion(input, cv::Rect(0, 0, input.cols, input.rows), cameraId, pyramid, detectedVehicles);
+        }
 
         // Filter results to include only vehicles within the detection ROI
         if (!m_vDetectAreaROI.empty())
         {
             std::vector<ANSCENTER::Object> filteredResults;
 
+            // Bounding rectangles of the rectangular ROIs, every box tested against all of them in one pass
+            std::vector<cv::Rect> roiRects;
             for (const auto &roi : m_vDetectAreaROI)
             {
-                // Check if the vehicle is within the detection area
-                for (const auto &obj : detectedVehicles)
+                if ((roi.regionType == 0 || roi.regionType == 1) && (int)roiRects.size() < CACRegionKernel::MAX_REGIONS)
                 {
-                    // For rectangular ROIs
-                    if (roi.regionType == 0 || roi.regionType == 1)
-                    {
-                        // Convert polygon to rectangle for simple containment check
-                        cv::Rect roiRect = cv::boundingRect(roi.polygon);
-                        // Check if the vehicle's bounding box intersects with the ROI
-                        std::cout << "OBJECT: " << obj.box << std::endl;
-                        if ((obj.box & roiRect).area() > 0)
-                        {
-                            filteredResults.push_back(obj);
-                        }
-                    }
+                    roiRects.push_back(cv::boundingRect(roi.polygon));
                 }
             }
+            CACBoxBatch batch(detectedVehicles);
+            std::vector<unsigned int> overlapMasks;
+            CACRegionKernel::ClassifyOverlaps(batch, roiRects, overlapMasks);
 
-            // Update vehicle tracking with the filtered results
-            UpdateVehicleTracking(filteredResults);
+            // Check if the vehicle's bounding box intersects with any ROI; vehicles on a lane
+            // boundary overlap two DetectAreas and are kept once
+            for (size_t i = 0; !roiRects.empty() && i < detectedVehicles.size(); ++i)
+            {
+                if (overlapMasks[i] != 0u)
+                {
+                    filteredResults.push_back(detectedVehicles[i]);
+                }
+            }
 
-            return filteredResults;
+            detectedVehicles = filteredResults;
         }
 
-        // If no ROI filtering is applied, still update tracking
+        // Merged tile boxes carry the ids of several tile trackers, they are matched by overlap
+        m_cBoxTracker.Assign(detectedVehicles, !m_bTiling);
+
+        // Tiles are sized by the tiler, only single-region runs feed the resolution tuner
+        if (!m_bTiling)
+        {
+            double nowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            m_cResolutionTuner.Observe(detectedVehicles, m_nTunedRegionSide, nowMs, cameraId);
+        }
+
+        // Update vehicle tracking with the (filtered) results; they are the next flow keyframe
         UpdateVehicleTracking(detectedVehicles);
+        m_cFlowPropagator.SetKeyframe(input, flowArea, detectedVehicles);
 
+        m_vLastVehicles = detectedVehicles;
         return detectedVehicles;
     }
     catch (std::exception &e)
@@ -223,29 +762,108 @@ std::vector<ANSCENTER::Object> CACVehicle::DetectVehicles(const cv::Mat &input,
     }
 }
 
-bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle)
+cv::Rect CACVehicle::GetDetectAreaCropRect(const cv::Size &frameSize) const
 {
-    try
+    if (!m_bCropToDetectArea)
+    {
+        return cv::Rect(0, 0, frameSize.width, frameSize.height);
+    }
+    return GetDetectAreaBounds(frameSize);
+}
+
+cv::Rect CACVehicle::GetDetectorInputRect(const cv::Size &frameSize) const
+{
+    return m_bTiling ? GetDetectAreaBounds(frameSize) : GetDetectAreaCropRect(frameSize);
+}
+
+cv::Rect CACVehicle::GetDetectAreaBounds(const cv::Size &frameSize) const
+{
+    cv::Rect frameRect(0, 0, frameSize.width, frameSize.height);
+    if (m_vDetectAreaROI.empty())
+    {
+        return frameRect;
+    }
+
+    // Union of all detect areas, grown by the margin so vehicles on the border keep their context
+    cv::Rect cropRect;
+    for (const auto &roi : m_vDetectAreaROI)
     {
-        if (m_vDetectAreaROI.empty())
+        if (roi.polygon.empty())
         {
-            return false;
+            continue;
         }
+        cv::Rect roiRect = cv::boundingRect(roi.polygon);
+        cropRect = cropRect.empty() ? roiRect : (cropRect | roiRect);
+    }
+    if (cropRect.empty())
+    {
+        return frameRect;
+    }
+
+    cropRect.x -= m_nCropMargin;
+    cropRect.y -= m_nCropMargin;
+    cropRect.width += 2 * m_nCropMargin;
+    cropRect.height += 2 * m_nCropMargin;
+    return cropRect & frameRect;
+}
+
+bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle)
+{
+    if (m_cLaneIndex.Empty())
+    {
+        return false;
+    }
 
-        // Get the detection area
-        const auto &detectArea = m_vDetectAreaROI[0];
-        std::vector<cv::Point> polygon = detectArea.polygon;
+    // Get vehicle center point
+    cv::Point vehicleCenter(
+        vehicle.box.x + vehicle.box.width / 2,
+        vehicle.box.y + vehicle.box.height / 2);
 
-        // Get vehicle center point
-        cv::Point vehicleCenter(
-            vehicle.box.x + vehicle.box.width / 2,
-            vehicle.box.y + vehicle.box.height / 2);
+    // Inside the lane it drives in and past that lane's stop line
+    int laneIndex = m_cLaneIndex.Locate(vehicleCenter);
+    return IsVehicleCrossedLine(vehicle, laneIndex, m_cLaneIndex.IsPastStopLine(laneIndex, vehicleCenter));
+}
+
+int CACVehicle::GetVehicleLane(const ANSCENTER::Object &vehicle) const
+{
+    int laneIndex = m_cLaneIndex.Locate(cv::Point(vehicle.box.x + vehicle.box.width / 2, vehicle.box.y + vehicle.box.height / 2));
+    return laneIndex < 0 ? -1 : m_cLaneIndex.GetLanes()[laneIndex].laneId;
+}
+
+void CACVehicle::AssignLanes(const std::vector<ANSCENTER::Object> &vehicles, std::vector<int> &laneIds) const
+{
+    m_cLaneIndex.Assign(vehicles, laneIds);
+    for (auto &laneId : laneIds)
+    {
+        laneId = laneId < 0 ? -1 : m_cLaneIndex.GetLanes()[laneId].laneId;
+    }
+}
+
+static double ToMilliseconds(const std::chrono::system_clock::time_point &time)
+{
+    return std::chrono::duration<double, std::milli>(time.time_since_epoch()).count();
+}
 
-        // Check if point is inside polygon using OpenCV
-        double result = cv::pointPolygonTest(polygon, vehicleCenter, true);
+void CACVehicle::MarkCrossed(TrackedVehicle &tracked)
+{
+    tracked.crossedLine = true;
+    tracked.crossedLaneId = tracked.laneId;
+    tracked.crossedFrame = m_nTrackingFrame;
+    m_nCrossedCount++;
+    m_mCrossedPerLane[tracked.crossedLaneId]++;
+    m_cAnalytics.OnCrossed(tracked.crossedLaneId, tracked.vehicleType, ToMilliseconds(tracked.lastSeen));
+}
 
-        // If point is inside or on the polygon (result >= 0)
-        if (result >= 0)
+bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle, int laneIndex, bool pastStopLine)
+{
+    try
+    {
+        if (laneIndex < 0)
+        {
+            return false;
+        }
+
+        if (pastStopLine)
         {
             // Check if vehicle is already tracked
             for (auto &tracked : trackedVehicles)
@@ -254,7 +872,7 @@ bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle)
                 {
                     if (!tracked.crossedLine)
                     {
-                        tracked.crossedLine = true;
+                        MarkCrossed(tracked);
                         return true;
                     }
                     return false;
@@ -265,9 +883,17 @@ bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle)
             TrackedVehicle newVehicle;
             newVehicle.trackId = vehicle.trackId;
             newVehicle.lastPosition = vehicle.box;
-            newVehicle.crossedLine = true;
+            newVehicle.crossedLine = false;
+            newVehicle.laneId = m_cLaneIndex.GetLanes()[laneIndex].laneId;
+            newVehicle.crossedLaneId = -1;
+            newVehicle.crossedFrame = -1;
             newVehicle.vehicleType = vehicle.className;
+            newVehicle.interpolated = (vehicle.extraInfo == "interpolated");
+            newVehicle.detectedPosition = vehicle.box;
+            newVehicle.framesSinceDetected = 0;
             newVehicle.lastSeen = std::chrono::system_clock::now();
+            newVehicle.enteredLane = newVehicle.lastSeen;
+            MarkCrossed(newVehicle);
             trackedVehicles.push_back(newVehicle);
             return true;
         }
@@ -280,28 +906,118 @@ bool CACVehicle::IsVehicleCrossedLine(const ANSCENTER::Object &vehicle)
     }
 }
 
-void CACVehicle::UpdateVehicleTracking(const std::vector<ANSCENTER::Object> &vehicles)
+long long CACVehicle::GetTrackingFrame()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    return m_nTrackingFrame;
+}
+
+bool CACVehicle::HasCrossedOnFrame(int trackId, long long trackingFrame)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    for (const auto &tracked : trackedVehicles)
+    {
+        if (tracked.trackId == trackId)
+        {
+            return tracked.crossedLine && tracked.crossedFrame == trackingFrame;
+        }
+    }
+    return false;
+}
+
+void CACVehicle::SetLaneRed(int laneId, bool red)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    m_mLaneRed[laneId] = red;
+}
+
+void CACVehicle::SetMaxInputSide(int maxSide)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    m_cResolutionTuner.SetMaxSide(maxSide);
+}
+
+void CACVehicle::GetInputSides(int &tunedSide, std::vector<int> &sides)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_cMutex);
+    tunedSide = m_cResolutionTuner.GetTunedSide();
+    sides.clear();
+    if (tunedSide > 0)
+    {
+        sides = m_cResolutionTuner.GetLadder();
+    }
+}
+
+void CACVehicle::UpdateVehicleTracking(const std::vector<ANSCENTER::Object> &vehicles, bool observed, bool detected)
 {
     auto currentTime = std::chrono::system_clock::now();
+    double nowMs = ToMilliseconds(currentTime);
+    m_nTrackingFrame++;
+
+    // Lane of every vehicle centre from the grid index
+    std::vector<int> laneIndices;
+    m_cLaneIndex.Assign(vehicles, laneIndices);
+    std::map<int, int> laneVehicles;
+    std::map<int, int> laneQueues;
 
     // Update existing tracked vehicles
-    for (auto &vehicle : vehicles)
+    for (size_t i = 0; i < vehicles.size(); ++i)
     {
+        const auto &vehicle = vehicles[i];
+        int laneIndex = laneIndices[i];
+        cv::Point center(vehicle.box.x + vehicle.box.width / 2, vehicle.box.y + vehicle.box.height / 2);
+        bool pastStopLine = m_cLaneIndex.IsPastStopLine(laneIndex, center);
+        int laneId = laneIndex < 0 ? -1 : m_cLaneIndex.GetLanes()[laneIndex].laneId;
+        if (laneId >= 0)
+        {
+            laneVehicles[laneId]++;
+        }
+        if (!observed)
+        {
+            continue;
+        }
         bool found = false;
 
         for (auto &trackedVehicle : trackedVehicles)
         {
             if (trackedVehicle.trackId == vehicle.trackId)
             {
+                // Waiting vehicles barely move between frames. Reused and propagated boxes say nothing
+                // about that, so the detector's boxes are compared over the frames between them.
+                trackedVehicle.framesSinceDetected++;
+                bool stationary = false;
+                if (detected)
+                {
+                    cv::Point previous(trackedVehicle.detectedPosition.x + trackedVehicle.detectedPosition.width / 2,
+                                       trackedVehicle.detectedPosition.y + trackedVehicle.detectedPosition.height / 2);
+                    stationary = cv::norm(center - previous) <= m_nQueueSpeedPx * trackedVehicle.framesSinceDetected;
+                    trackedVehicle.detectedPosition = vehicle.box;
+                    trackedVehicle.framesSinceDetected = 0;
+                }
+
                 // Update the vehicle
                 trackedVehicle.lastPosition = vehicle.box;
                 trackedVehicle.lastSeen = currentTime;
                 trackedVehicle.vehicleType = vehicle.className;
+                trackedVehicle.interpolated = (vehicle.extraInfo == "interpolated");
+                if (laneId >= 0)
+                {
+                    if (trackedVehicle.laneId < 0)
+                    {
+                        trackedVehicle.enteredLane = currentTime;
+                    }
+                    trackedVehicle.laneId = laneId;
+                }
 
                 // Check if vehicle has crossed the line
-                if (!trackedVehicle.crossedLine && IsVehicleCrossedLine(vehicle))
+                if (!trackedVehicle.crossedLine)
                 {
-                    trackedVehicle.crossedLine = true;
+                    IsVehicleCrossedLine(vehicle, laneIndex, pastStopLine);
+                }
+
+                if (laneId >= 0 && !pastStopLine && stationary)
+                {
+                    laneQueues[laneId]++;
                 }
 
                 found = true;
@@ -309,43 +1025,70 @@ void CACVehicle::UpdateVehicleTracking(const std::vector<ANSCENTER::Object> &veh
             }
         }
 
-        // Add new vehicle to tracking list
-        if (!found)
+        // Add new vehicle to tracking list; a vehicle already past the line was added by the crossing check
+        if (!found && !IsVehicleCrossedLine(vehicle, laneIndex, pastStopLine))
         {
             TrackedVehicle newVehicle;
             newVehicle.trackId = vehicle.trackId;
             newVehicle.lastPosition = vehicle.box;
-            newVehicle.crossedLine = IsVehicleCrossedLine(vehicle);
+            newVehicle.crossedLine = false;
+            newVehicle.laneId = laneId;
+            newVehicle.crossedLaneId = -1;
+            newVehicle.crossedFrame = -1;
             newVehicle.vehicleType = vehicle.className;
+            newVehicle.interpolated = (vehicle.extraInfo == "interpolated");
+            newVehicle.detectedPosition = vehicle.box;
+            newVehicle.framesSinceDetected = 0;
             newVehicle.lastSeen = currentTime;
+            newVehicle.enteredLane = currentTime;
             trackedVehicles.push_back(newVehicle);
         }
     }
 
     // Remove vehicles that haven't been seen for a while
     const auto MAX_AGE = std::chrono::seconds(5);
-    trackedVehicles.erase(
-        std::remove_if(
-            trackedVehicles.begin(),
-            trackedVehicles.end(),
-            [currentTime, MAX_AGE](const TrackedVehicle &tv)
-            {
-                return currentTime - tv.lastSeen > MAX_AGE;
-            }),
-        trackedVehicles.end());
-}
-
-int CACVehicle::CountVehiclesCrossedLine()
-{
-    int count = 0;
-    for (const auto &vehicle : trackedVehicles)
+    auto expired = std::remove_if(
+        trackedVehicles.begin(),
+        trackedVehicles.end(),
+        [currentTime, MAX_AGE](const TrackedVehicle &tv)
+        {
+            return currentTime - tv.lastSeen > MAX_AGE;
+        });
+    for (auto it = expired; it != trackedVehicles.end(); ++it)
     {
-        if (vehicle.crossedLine)
+        if (it->crossedLine)
         {
-            count++;
+            m_nCrossedCount--;
+            m_mCrossedPerLane[it->crossedLaneId]--;
         }
+        if (it->laneId >= 0)
+        {
+            m_cAnalytics.OnLeft(it->laneId, ToMilliseconds(it->lastSeen) - ToMilliseconds(it->enteredLane), nowMs);
+        }
+    }
+    trackedVehicles.erase(expired, trackedVehicles.end());
+
+    if (observed && detected)
+    {
+        m_mLaneQueues = laneQueues;
     }
-    return count;
+    for (const auto &lane : m_cLaneIndex.GetLanes())
+    {
+        m_cAnalytics.OnLaneFrame(lane.laneId, laneVehicles[lane.laneId], m_mLaneRed[lane.laneId], m_mLaneQueues[lane.laneId]);
+    }
+    m_cAnalytics.OnFrame(nowMs);
+}
+
+int CACVehicle::CountVehiclesCrossedLine()
+{
+    // Kept up to date by the tracker
+    return m_nCrossedCount;
+}
+
+int CACVehicle::CountVehiclesCrossedLine(int laneId)
+{
+    auto it = m_mCrossedPerLane.find(laneId);
+    return it == m_mCrossedPerLane.end() ? 0 : it->second;
 }
 
 bool CACVehicle::IsCar(const ANSCENTER::Object &vehicle)
@@ -372,5 +1115,12 @@ bool CACVehicle::Destroy()
 {
     // Release resources
     trackedVehicles.clear();
+    m_nCrossedCount = 0;
+    m_nTrackingFrame = 0;
+    m_mCrossedPerLane.clear();
+    m_mLaneQueues.clear();
+    m_cBoxTracker.Reset();
+    m_pDetectorPool.reset();
+    m_mRungPools.clear();
     return true;
 }
\ No newline at end of file
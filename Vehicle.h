@@ -3,9 +3,24 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <mutex>
+#include <memory>
+#include <map>
 #include <opencv2/opencv.hpp>
 #include "ANSLIB.h"
 #include "ANSCustomData.h"
+#include "Tiler.h"
+#include "MotionGate.h"
+#include "FlowPropagator.h"
+#include "FramePyramid.h"
+#include "RegionKernel.h"
+#include "LaneIndex.h"
+#include "TrafficAnalytics.h"
+#include "DetectorPool.h"
+#include "ModelRegistry.h"
+#include "EngineCache.h"
+#include "ResolutionTuner.h"
+#include "BoxTracker.h"
 
 // TungBT: Modify member variable's name, local variable's name
 // Class XYYZZ (Example class CACVehicle with X: Class, YY: Project, ZZ: Class name)
@@ -24,24 +39,106 @@ private:
     float m_fNMSThreshold;
     std::string m_sLabelMap;
 
+    // Pool of detector handles, shared through CACModelRegistry unless m_bSharedModel is off.
+    // Without a pool m_cDetector is used under the global lock.
+    int m_nDetectorPoolSize;
+    bool m_bSharedModel;
+    std::string m_sPrecision; // Part of the registry key: "fp32" or "fp16"
+    std::shared_ptr<CACDetectorPool> m_pDetectorPool;
+    std::recursive_mutex m_cMutex; // Per-instance state (ROIs, tracks)
+
+    // Startup: optimise right after loading (skipped when the engine cache has it) and warm up
+    bool m_bOptimizeOnLoad;
+    bool m_bWarmup;
+    int m_nWarmupSize;
+    std::string m_sModelHash;        // Computed on the first Optimize after a load
+    std::string m_sBuildFingerprint; // Engine type, GPU and driver
+    StartupTimings m_stStartupTimings;
+
     // Vehicle-related ROIs
     std::vector<CustomRegion> m_vDetectAreaROI;
     std::vector<CustomRegion> m_vCrossingLineROI;
     std::vector<CustomRegion> m_vDirectionLineROI;
 
+    // Lanes built from the plain and "_N" suffixed ROIs, vehicles assigned through a grid index
+    CACLaneIndex m_cLaneIndex;
+    int m_nLaneGridCell;
+
+    // Per-lane statistics fed by the tracker; crossing counts kept incrementally
+    CACTrafficAnalytics m_cAnalytics;
+    std::map<int, bool> m_mLaneRed; // Set by the caller from the lane's signal head
+    std::map<int, int> m_mLaneQueues; // Queue per lane of the last frame the detector ran on
+    int m_nQueueSpeedPx;            // Centre movement per frame below which a vehicle is waiting
+    int m_nCrossedCount;            // Tracked vehicles with crossedLine set
+    long long m_nTrackingFrame;     // UpdateVehicleTracking calls so far
+    std::map<int, int> m_mCrossedPerLane;
+
+    // Run inference on the DetectArea bounding rectangle (plus margin) instead of the full frame
+    bool m_bCropToDetectArea;
+    int m_nCropMargin;
+
+    // Tiled inference over the DetectArea for high-resolution cameras
+    bool m_bTiling;
+    CACTiler m_cTiler;
+    CACTiler::Stats m_stTilingStats;
+
+    // Track ids of the camera: ANSLIB's own ids, or matched by overlap after a tile merge
+    CACBoxTracker m_cBoxTracker;
+
+    // Feed the detector from the shared pyramid level closest to the model input size
+    bool m_bPyramidInput;
+
+    // Detector input resolution chosen per camera from the vehicle sizes it sees. A rung below the
+    // top runs on the engine built for that input side, model <modelName>_<side>.
+    CACResolutionTuner m_cResolutionTuner;
+    std::map<int, std::shared_ptr<CACDetectorPool>> m_mRungPools; // By input side
+    cv::Mat m_cTunedInput; // Region scaled to the tuned side, buffer reused every frame
+    int m_nTunedRegionSide; // Long side of the last region given to the detector
+    int m_nDetectorSide;    // Rung of the last detector run, 0 for the main model; -1 before the first
+
+    // Skip the vehicle model while nothing moves inside the DetectArea
+    CACMotionGate m_cMotionGate;
+    std::vector<ANSCENTER::Object> m_vLastVehicles;
+
+    // Run the vehicle model on keyframes only and move the boxes with optical flow in between
+    CACFlowPropagator m_cFlowPropagator;
+
     // Parameters
     CustomParams m_stParameters;
 
+    int RunDetector(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results);
+    int RunDetectorOnRegion(const cv::Mat &input, const cv::Rect &region, const std::string &cameraId,
+                            CACFramePyramid *pyramid, std::vector<ANSCENTER::Object> &results);
+    void RunDetectorBatch(const std::vector<cv::Mat> &images, const std::string &cameraId,
+                          std::vector<std::vector<ANSCENTER::Object>> &results);
+    int DetectMovement(const cv::Mat &image, const std::string &cameraId, std::vector<ANSCENTER::Object> &results);
+    // Crossing bookkeeping once the lane of the centre and its side of the stop line are known
+    bool IsVehicleCrossedLine(const ANSCENTER::Object &vehicle, int laneIndex, bool pastStopLine);
+    void WarmUp();
+    CACModelRegistry::Key GetModelKey(const std::string &modelName) const;
+    CACDetectorPool::Loader GetModelLoader(const std::string &modelName) const;
+    // Engines for the resolution ladder rungs found in the model directory
+    void LoadRungModels();
+
     // Tracking data
     struct TrackedVehicle
     {
         int trackId;
         cv::Rect lastPosition;
         bool crossedLine;
+        int laneId;        // -1 until the vehicle is seen inside a lane
+        int crossedLaneId; // Lane whose stop line it crossed
+        long long crossedFrame; // Tracking frame of the crossing, -1 before
         std::string vehicleType;
+        bool interpolated; // Last position came from flow propagation, not from the detector
+        cv::Rect detectedPosition; // Last position from the detector, for the waiting test
+        int framesSinceDetected;   // Observed frames since then
         std::chrono::system_clock::time_point lastSeen;
+        std::chrono::system_clock::time_point enteredLane;
     };
 
+    void MarkCrossed(TrackedVehicle &tracked);
+
     std::vector<TrackedVehicle> trackedVehicles;
 
 public:
@@ -56,13 +153,44 @@ public:
     std::vector<CustomRegion> GetDetectAreaROI() const { return m_vDetectAreaROI; }
     std::vector<CustomRegion> GetCrossingLineROI() const { return m_vCrossingLineROI; }
     std::vector<CustomRegion> GetDirectionLineROI() const { return m_vDirectionLineROI; }
+    std::vector<CACLane> GetLanes() const { return m_cLaneIndex.GetLanes(); }
+    // Lane id of the vehicle centre, -1 outside every lane
+    int GetVehicleLane(const ANSCENTER::Object &vehicle) const;
+    void AssignLanes(const std::vector<ANSCENTER::Object> &vehicles, std::vector<int> &laneIds) const;
 
-    std::vector<ANSCENTER::Object> DetectVehicles(const cv::Mat &input, const std::string &cameraId);
+    // The pyramid, when given, must have been set to this input
+    std::vector<ANSCENTER::Object> DetectVehicles(const cv::Mat &input, const std::string &cameraId, CACFramePyramid *pyramid = nullptr);
+    cv::Rect GetDetectAreaCropRect(const cv::Size &frameSize) const;
+    // Union of the DetectAreas plus the crop margin, clipped to the frame
+    cv::Rect GetDetectAreaBounds(const cv::Size &frameSize) const;
+    // Part of the frame the detector reads: the DetectArea bounds when tiling or cropping, else all of it
+    cv::Rect GetDetectorInputRect(const cv::Size &frameSize) const;
+    CACTiler::Stats GetTilingStats() const { return m_stTilingStats; }
+    CACMotionGate::Stats GetMotionGateStats() const { return m_cMotionGate.GetStats(); }
+    CACFlowPropagator::Stats GetFlowStats() const { return m_cFlowPropagator.GetStats(); }
+    CACResolutionTuner::Stats GetResolutionStats() const { return m_cResolutionTuner.GetStats(); }
+    std::vector<CACDetectorPool::WorkerStats> GetDetectorPoolStats() const;
+    StartupTimings GetStartupTimings() const { return m_stStartupTimings; }
 
     // Methods for line crossing detection
     bool IsVehicleCrossedLine(const ANSCENTER::Object &vehicle);
+    // The tracker marks crossings as it updates; a frame's crossings are the tracks it marked on
+    // the tracking frame of that update
+    long long GetTrackingFrame();
+    bool HasCrossedOnFrame(int trackId, long long trackingFrame);
     int CountVehiclesCrossedLine();
-    void UpdateVehicleTracking(const std::vector<ANSCENTER::Object> &vehicles);
+    int CountVehiclesCrossedLine(int laneId);
+    void SetLaneRed(int laneId, bool red);
+    // Budget governor limit on the detector input side, applied through the resolution rungs
+    void SetMaxInputSide(int maxSide);
+    // Side the resolution tuner chose and the usable rungs, both empty (0) without tuning
+    void GetInputSides(int &tunedSide, std::vector<int> &sides);
+    // Lock-free, may be called from any thread while inference runs
+    void GetAnalyticsSnapshot(CACTrafficAnalytics::Snapshot &snapshot) const { m_cAnalytics.GetSnapshot(snapshot); }
+    // Unobserved frames (nothing moved, the last boxes stand in) let the tracks age: they are
+    // neither moved nor refreshed. Waiting vehicles are only judged on detector output, so on
+    // unobserved and flow-propagated (not detected) frames the lane queues repeat the last ones.
+    void UpdateVehicleTracking(const std::vector<ANSCENTER::Object> &vehicles, bool observed = true, bool detected = true);
 
     // Vehicle classification methods
     bool IsCar(const ANSCENTER::Object &vehicle);